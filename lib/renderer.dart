@@ -12,16 +12,344 @@ class Renderer {
     return RendererPlatform.instance.init(width, height, parameterSets);
   }
 
-  Future<void> dispose() {
-    return RendererPlatform.instance.dispose();
+  /// Starts another decoding session next to the one from [init] and
+  /// returns its texture id. Calls that take a `textureId` address it;
+  /// without one they go to the session from [init].
+  Future<int?> createSession(int width, int height) {
+    return RendererPlatform.instance.createSession(width, height);
   }
 
-  Future<void> addH265Nal(Uint8List nal) {
-    return RendererPlatform.instance.addH265Nal(nal);
+  /// Disposes the session of [textureId], or all of them.
+  Future<void> dispose({int? textureId}) {
+    return RendererPlatform.instance.dispose(textureId: textureId);
   }
 
-  Future<bool?> needsTransformation() {
-    return RendererPlatform.instance.needsTransformation();
+  /// Queues [nal] for decoding. [pts] is the presentation time in
+  /// microseconds; when given, frames are paced to it instead of being shown
+  /// as soon as they are decoded.
+  Future<void> addH265Nal(Uint8List nal, {int? pts, int? textureId}) {
+    return RendererPlatform.instance
+        .addH265Nal(nal, pts: pts, textureId: textureId);
+  }
+
+  /// Pacing counters of the current stream, or null where unsupported.
+  Future<Map<String, int>?> getStats({int? textureId}) {
+    return RendererPlatform.instance.getStats(textureId: textureId);
+  }
+
+  /// Decodes to the smallest size that still covers [width] x [height]
+  /// physical pixels, so conversion and upload follow what is shown rather
+  /// than the stream resolution. 0 x 0 restores the full size. A new size
+  /// takes effect at the next keyframe. See [TextureDisplay.adaptOutputSize].
+  Future<void> setOutputSize(int width, int height, {int? textureId}) {
+    return RendererPlatform.instance
+        .setOutputSize(width, height, textureId: textureId);
+  }
+
+  /// Adds a texture that shows the session's frames scaled to fit within
+  /// [width] x [height], e.g. a thumbnail next to the main view. It is drawn
+  /// on the GPU from the session's frames, so nothing is decoded or uploaded
+  /// twice. Returns its texture id.
+  Future<int?> addOutput(int width, int height,
+      {OutputFormat format = OutputFormat.rgba, int? textureId}) {
+    return RendererPlatform.instance
+        .addOutput(width, height, format: format, textureId: textureId);
+  }
+
+  Future<void> removeOutput(int outputId, {int? textureId}) {
+    return RendererPlatform.instance
+        .removeOutput(outputId, textureId: textureId);
+  }
+
+  /// Creates an atlas texture of [width] x [height] that many sessions can
+  /// be drawn into, for video walls. Returns its texture id.
+  Future<int?> createMosaic(int width, int height) {
+    return RendererPlatform.instance.createMosaic(width, height);
+  }
+
+  /// Places sessions in the mosaic; sessions left out show on their own
+  /// textures again. While in a mosaic, a session's own texture is not
+  /// updated. The whole atlas is refreshed at most once per display frame.
+  Future<void> setMosaicLayout(int mosaicId, List<MosaicTile> tiles) {
+    return RendererPlatform.instance.setMosaicLayout(mosaicId, tiles);
+  }
+
+  Future<void> disposeMosaic(int mosaicId) {
+    return RendererPlatform.instance.disposeMosaic(mosaicId);
+  }
+
+  /// Turns the session's frames clockwise by [quarterTurns] and then mirrors
+  /// them if [mirror] is set, natively while they are uploaded, so the
+  /// texture arrives upright and no [RotateTexture] is needed;
+  /// [needsTransformation] then reports false.
+  Future<void> setOrientation(int quarterTurns,
+      {bool mirror = false, int? textureId}) {
+    return RendererPlatform.instance
+        .setOrientation(quarterTurns, mirror: mirror, textureId: textureId);
+  }
+
+  /// Zooms into [region] of the picture, given in fractions of its width and
+  /// height as displayed, e.g. `Rect.fromLTWH(0.25, 0.25, 0.5, 0.5)` for 2x.
+  /// Only that region is uploaded, so the texture becomes the size of the
+  /// region, or with [upscale] keeps the size of the whole picture and is
+  /// scaled on the GPU. A null [region] shows the whole picture again.
+  Future<void> setRegionOfInterest(Rect? region,
+      {bool upscale = false, int? textureId}) {
+    return RendererPlatform.instance
+        .setRegionOfInterest(region, upscale: upscale, textureId: textureId);
+  }
+
+  /// Draws detection boxes and labels over the session's video natively, in
+  /// the same GPU pass that uploads its frames, instead of with widgets. The
+  /// batch shows from the frame with timestamp [pts], as given to
+  /// [addH265Nal] and reported by the frame tap, until the next batch is
+  /// due; without [pts] it shows from the next frame. Batches must be set in
+  /// [pts] order. An empty batch clears the overlay.
+  Future<void> setOverlay({
+    List<OverlayRect> rects = const [],
+    List<OverlayLabel> labels = const [],
+    int? pts,
+    int? textureId,
+  }) {
+    return RendererPlatform.instance.setOverlay(
+        rects: rects, labels: labels, pts: pts, textureId: textureId);
+  }
+
+  /// A hidden session keeps decoding, so it can be shown again without
+  /// waiting for the source, but its frames are no longer uploaded or shown.
+  /// From the next keyframe it decodes at 2x2 pixels unless a frame tap is
+  /// set. After showing it again, the texture keeps its last frame until
+  /// the full size is back at the keyframe after that.
+  Future<void> setVisibility(bool visible, {int? textureId}) {
+    return RendererPlatform.instance
+        .setVisibility(visible, textureId: textureId);
+  }
+
+  /// Stops decoding and frees the session's textures and frame buffers
+  /// until [resume]. The texture and any extra outputs stay registered and
+  /// show blank. NALs given in the meantime are dropped, apart from
+  /// parameter sets.
+  Future<void> suspend({int? textureId}) {
+    return RendererPlatform.instance.suspend(textureId: textureId);
+  }
+
+  /// Decodes again from the next keyframe; the texture stays blank until
+  /// then.
+  Future<void> resume({int? textureId}) {
+    return RendererPlatform.instance.resume(textureId: textureId);
+  }
+
+  /// Keeps the stream within [budget] of real time: when a picture has
+  /// waited that long in the decoder, or a frame for display, everything
+  /// queued is flushed and decoding resumes at the next keyframe. With
+  /// [requestKeyframe], a `keyframeRequested` event follows so the sender
+  /// can be asked for one. Null disables the watchdog.
+  Future<void> setLatencyBudget(Duration? budget,
+      {bool requestKeyframe = false}) {
+    return RendererPlatform.instance
+        .setLatencyBudget(budget, requestKeyframe: requestKeyframe);
+  }
+
+  /// Sheds pictures that nothing references, highest temporal sub-layer
+  /// first, while more than [maxQueuedPictures] wait in the decoder or
+  /// pictures take longer than [maxDecodeTime] to decode. Shed pictures
+  /// come back at a keyframe once the decoder has kept up for a while. Each
+  /// change is reported in a `degradationChanged` event carrying `level`
+  /// (0 when nothing is shed), `maxTemporalId` and `dropNonReference`.
+  /// Enabled by default.
+  Future<void> setOverloadPolicy(
+      {bool enabled = true,
+      int maxQueuedPictures = 6,
+      Duration maxDecodeTime = const Duration(milliseconds: 150)}) {
+    return RendererPlatform.instance.setOverloadPolicy(
+        enabled: enabled,
+        maxQueuedPictures: maxQueuedPictures,
+        maxDecodeTime: maxDecodeTime);
+  }
+
+  /// Receives RTP/H.265 (RFC 7798) on a UDP [port] natively and decodes it
+  /// without passing NALs through Dart. Port 0 picks a free port. Returns the
+  /// bound port. Only packets with [payloadType] from the first source heard
+  /// are decoded; the rest are counted as `rtpPacketsIgnored` in the stats.
+  Future<int?> startRtpReceiver(
+      {required int port, String? address, int payloadType = 96}) {
+    return RendererPlatform.instance.startRtpReceiver(
+        port: port, address: address, payloadType: payloadType);
+  }
+
+  Future<void> stopRtpReceiver() {
+    return RendererPlatform.instance.stopRtpReceiver();
+  }
+
+  /// Lets a producer process on the same host feed NAL units through a
+  /// shared-memory ring of [capacity] bytes, handed out on the Unix socket
+  /// at [path]. [capacity] defaults to 16 MiB and must lie between 4 KiB
+  /// and 1 GiB. A stale socket at [path] is replaced, but any other file
+  /// there makes the call fail. See `linux/include/renderer/shm_ring.h` for
+  /// the protocol.
+  Future<void> startShmIngest({required String path, int? capacity}) {
+    return RendererPlatform.instance
+        .startShmIngest(path: path, capacity: capacity);
+  }
+
+  Future<void> stopShmIngest() {
+    return RendererPlatform.instance.stopShmIngest();
+  }
+
+  /// Plays a local H.265 Annex-B file at [fps] from the beginning. Returns
+  /// its `frames`, `keyframes` and `durationUs`. The keyframe index is cached,
+  /// so reopening a file does not scan it again. A `fileEnded` event follows
+  /// when the last frame has been fed.
+  Future<Map<String, int>?> openFile({required String path, double? fps}) {
+    return RendererPlatform.instance.openFile(path: path, fps: fps);
+  }
+
+  /// Continues playback from the keyframe at or before [position] and
+  /// returns that keyframe's position.
+  Future<Duration?> seekFile(Duration position, {int? textureId}) {
+    return RendererPlatform.instance.seekFile(position, textureId: textureId);
+  }
+
+  /// Sets the file playback rate: 1 is normal speed, negative plays
+  /// backwards and 0 pauses. Away from normal speed only the pictures that
+  /// can be shown are decoded, down to keyframes only at high rates, so the
+  /// decoder load stays about the same.
+  Future<void> setFileRate(double rate, {int? textureId}) {
+    return RendererPlatform.instance.setFileRate(rate, textureId: textureId);
+  }
+
+  Future<void> closeFile({int? textureId}) {
+    return RendererPlatform.instance.closeFile(textureId: textureId);
+  }
+
+  /// Keeps the last [duration] of the session's compressed input in memory
+  /// for instant replay, in [capacityBytes] reserved up front; whichever
+  /// runs out first limits it. [Duration.zero] frees it.
+  Future<void> setTimeshift(Duration duration,
+      {required int capacityBytes, int? textureId}) {
+    return RendererPlatform.instance.setTimeshift(duration,
+        capacityBytes: capacityBytes, textureId: textureId);
+  }
+
+  /// Writes the timeshift to an H.265 Annex-B file at [path], from the
+  /// keyframe at or before [back] before live, or all of it. Returns its
+  /// `pictures`, `bytes`, `durationUs` and `fps`.
+  Future<Map<String, num>?> exportTimeshift(
+      {required String path, Duration? back, int? textureId}) {
+    return RendererPlatform.instance
+        .exportTimeshift(path: path, back: back, textureId: textureId);
+  }
+
+  /// Plays the timeshift of [sourceTextureId] in the session [textureId]
+  /// from the keyframe at or before [back] before live, or from its start.
+  /// It plays like a file opened with [openFile], so [seekFile],
+  /// [setFileRate] and [closeFile] with the same [textureId] control it.
+  Future<Map<String, int>?> replayTimeshift(
+      {required int sourceTextureId, Duration? back, int? textureId}) {
+    return RendererPlatform.instance.replayTimeshift(
+        sourceTextureId: sourceTextureId, back: back, textureId: textureId);
+  }
+
+  /// Extracts thumbnails of the keyframes at or before [positions] in a local
+  /// H.265 Annex-B file, in the background and at low priority. Each one
+  /// arrives as a `thumbnail` event with `requestId`, `position`,
+  /// `keyframePosition`, `width`, `height`, `format` and `data`; a
+  /// `thumbnailsDone` event ends the request. [height] defaults to the
+  /// stream's aspect ratio. Thumbnails are cached on disk, so asking again
+  /// for the same file is fast. Returns the request id.
+  Future<int?> requestThumbnails({
+    required String path,
+    required List<Duration> positions,
+    double? fps,
+    int width = 160,
+    int? height,
+    ThumbnailFormat format = ThumbnailFormat.rgba,
+  }) {
+    return RendererPlatform.instance.requestThumbnails(
+      path: path,
+      positions: positions,
+      fps: fps,
+      width: width,
+      height: height,
+      format: format,
+    );
+  }
+
+  Future<void> cancelThumbnails(int requestId) {
+    return RendererPlatform.instance.cancelThumbnails(requestId);
+  }
+
+  /// Taps decoded frames for analytics, at most one per [interval], scaled
+  /// down to fit within [width] x [height] if given, as RGBA or one byte of
+  /// luma per pixel with [OutputFormat.grey]. They come straight from the
+  /// decoder, before any orientation or region of interest, also while the
+  /// session is hidden. Each arrives as a `tapFrame` event with
+  /// `textureId`, `width`, `height`, `format`, `pts`, `sequence` and `data`.
+  Future<void> setFrameTap({
+    bool enabled = true,
+    Duration interval = Duration.zero,
+    int? width,
+    int? height,
+    OutputFormat format = OutputFormat.rgba,
+    int? textureId,
+  }) {
+    return RendererPlatform.instance.setFrameTap(
+      enabled: enabled,
+      interval: interval,
+      width: width,
+      height: height,
+      format: format,
+      textureId: textureId,
+    );
+  }
+
+  /// Takes a still of the frame the session shows, in display orientation.
+  /// It is read back from the GPU and encoded in the background, so playback
+  /// does not stutter. With [path] the image is written to that file and
+  /// [Snapshot.path] is set, otherwise [Snapshot.data] holds it. Returns
+  /// null if no frame has been shown yet.
+  Future<Snapshot?> snapshot({
+    SnapshotFormat format = SnapshotFormat.png,
+    String? path,
+    int? textureId,
+  }) {
+    return RendererPlatform.instance
+        .snapshot(format: format, path: path, textureId: textureId);
+  }
+
+  /// Records every NAL passed to [addH265Nal], or received natively, with
+  /// its arrival time to a trace file at [path]. The file is written in the
+  /// background.
+  Future<void> startTraceRecording({required String path}) {
+    return RendererPlatform.instance.startTraceRecording(path: path);
+  }
+
+  /// Stops recording and returns the `records`, `bytes` and `dropped` counts.
+  Future<Map<String, int>?> stopTraceRecording() {
+    return RendererPlatform.instance.stopTraceRecording();
+  }
+
+  /// Feeds a recorded trace into the decoder with its original timing scaled
+  /// by [speed]; a [speed] of 0 feeds it as fast as possible. A
+  /// `traceReplayFinished` event follows with `records`, `bytes` and
+  /// `elapsedUs`.
+  Future<void> startTraceReplay({required String path, double speed = 1.0}) {
+    return RendererPlatform.instance
+        .startTraceReplay(path: path, speed: speed);
+  }
+
+  Future<void> stopTraceReplay() {
+    return RendererPlatform.instance.stopTraceReplay();
+  }
+
+  /// Events from the native pipeline as maps with an `event` key, e.g.
+  /// `resolutionChanged` with `textureId`, `width` and `height` when the
+  /// stream changes size. The texture id stays the same.
+  Stream<Map<String, Object?>> get events => RendererPlatform.instance.events;
+
+  Future<bool?> needsTransformation({int? textureId}) {
+    return RendererPlatform.instance
+        .needsTransformation(textureId: textureId);
   }
 
   Future<int?> sensorOrientation() {
@@ -32,23 +360,78 @@ class Renderer {
       ((await sensorOrientation() ?? 0) + 360) % 360 ~/ 90;
 }
 
-class TextureDisplay extends StatelessWidget {
+class TextureDisplay extends StatefulWidget {
   final int textureId;
   final int textureWidth;
   final int textureHeight;
 
+  /// Asks the decoder for frames at the size they are shown at, through
+  /// [Renderer.setOutputSize], once the layout has settled after a change.
+  /// Sizes are rounded up to half-octave steps, so only a real change of
+  /// scale restarts the decoder. Linux only.
+  final bool adaptOutputSize;
+
   const TextureDisplay({
     super.key,
     required this.textureId,
     required this.textureWidth,
     required this.textureHeight,
+    this.adaptOutputSize = false,
   });
 
+  @override
+  State<TextureDisplay> createState() => _TextureDisplayState();
+}
+
+class _TextureDisplayState extends State<TextureDisplay> {
+  static const _settleDelay = Duration(milliseconds: 300);
+
+  final _renderer = Renderer();
+  Size? _outputSize;
+  Timer? _settleTimer;
+
+  // Each new size restarts the decoder at the next keyframe, so a window
+  // being resized must not send one per layout.
+  void _updateOutputSize(Size viewportSize) {
+    if (!viewportSize.isFinite) {
+      return;
+    }
+    final pixels = viewportSize * MediaQuery.devicePixelRatioOf(context);
+    final size = Size(_quantize(pixels.width), _quantize(pixels.height));
+    _settleTimer?.cancel();
+    if (size == _outputSize) {
+      return;
+    }
+    _settleTimer = Timer(_settleDelay, () {
+      _outputSize = size;
+      _renderer.setOutputSize(size.width.toInt(), size.height.toInt(),
+          textureId: widget.textureId);
+    });
+  }
+
+  static double _quantize(double extent) {
+    if (extent <= 1) {
+      return 1;
+    }
+    return pow(2, (log(extent) / ln2 * 2).ceil() / 2).ceilToDouble();
+  }
+
+  @override
+  void dispose() {
+    _settleTimer?.cancel();
+    super.dispose();
+  }
+
   @override
   Widget build(BuildContext context) {
+    final textureWidth = widget.textureWidth;
+    final textureHeight = widget.textureHeight;
     return LayoutBuilder(
       builder: (context, constraints) {
         final viewportSize = constraints.biggest;
+        if (widget.adaptOutputSize) {
+          _updateOutputSize(viewportSize);
+        }
         final scaleX = viewportSize.width / textureWidth;
         final scaleY = viewportSize.height / textureHeight;
         final scale = max(scaleX, scaleY);
@@ -59,7 +442,7 @@ class TextureDisplay extends StatelessWidget {
               maxWidth: textureWidth.toDouble(),
               maxHeight: textureHeight.toDouble(),
               child: Texture(
-                textureId: textureId,
+                textureId: widget.textureId,
               ),
             ),
           ),
@@ -1,5 +1,6 @@
 import 'dart:io';
 import 'dart:typed_data';
+import 'dart:ui' show Rect;
 
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
@@ -12,6 +13,11 @@ class MethodChannelRenderer extends RendererPlatform {
   @visibleForTesting
   final methodChannel = const MethodChannel('com.openup.streamline/renderer');
 
+  /// The event channel the native platform reports pipeline events on.
+  @visibleForTesting
+  final eventChannel =
+      const EventChannel('com.openup.streamline/renderer/events');
+
   @override
   Future<int?> init(int width, int height, ParameterSets parameterSets) async {
     if (Platform.isIOS) {
@@ -59,21 +65,587 @@ class MethodChannelRenderer extends RendererPlatform {
   }
 
   @override
-  Future<void> dispose() async {
+  Future<int?> createSession(int width, int height) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMethod<int>(
+      'createSession',
+      {
+        'width': width,
+        'height': height,
+      },
+    );
+  }
+
+  @override
+  Future<void> dispose({int? textureId}) async {
+    if (textureId != null && Platform.isLinux) {
+      await methodChannel
+          .invokeMethod<void>('dispose', {'textureId': textureId});
+      return;
+    }
     await methodChannel.invokeMethod<void>('dispose');
   }
 
   @override
-  Future<void> addH265Nal(Uint8List nal) async {
+  Future<void> addH265Nal(Uint8List nal, {int? pts, int? textureId}) async {
+    if ((pts != null || textureId != null) && Platform.isLinux) {
+      await methodChannel.invokeMethod<void>(
+        'addH265Nal',
+        {
+          'nal': nal,
+          if (pts != null) 'pts': pts,
+          if (textureId != null) 'textureId': textureId,
+        },
+      );
+      return;
+    }
     await methodChannel.invokeMethod<void>('addH265Nal', nal);
   }
 
   @override
-  Future<bool?> needsTransformation() async {
+  Future<Map<String, int>?> getStats({int? textureId}) async {
+    if (Platform.isLinux) {
+      return methodChannel.invokeMapMethod<String, int>(
+        'getStats',
+        {if (textureId != null) 'textureId': textureId},
+      );
+    }
+    return Future.value(null);
+  }
+
+  @override
+  Future<void> setOutputSize(int width, int height, {int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setOutputSize',
+      {
+        'width': width,
+        'height': height,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<int?> addOutput(int width, int height,
+      {OutputFormat format = OutputFormat.rgba, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMethod<int>(
+      'addOutput',
+      {
+        'width': width,
+        'height': height,
+        'format': format.name,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> removeOutput(int outputId, {int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'removeOutput',
+      {
+        'outputId': outputId,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<int?> createMosaic(int width, int height) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMethod<int>(
+      'createMosaic',
+      {
+        'width': width,
+        'height': height,
+      },
+    );
+  }
+
+  @override
+  Future<void> setMosaicLayout(int mosaicId, List<MosaicTile> tiles) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setMosaicLayout',
+      {
+        'mosaicId': mosaicId,
+        'tiles': [
+          for (final tile in tiles)
+            [tile.textureId, tile.x, tile.y, tile.width, tile.height],
+        ],
+      },
+    );
+  }
+
+  @override
+  Future<void> disposeMosaic(int mosaicId) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel
+        .invokeMethod<void>('disposeMosaic', {'mosaicId': mosaicId});
+  }
+
+  @override
+  Future<void> setOrientation(int quarterTurns,
+      {bool mirror = false, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setOrientation',
+      {
+        'quarterTurns': quarterTurns,
+        'mirror': mirror,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> setRegionOfInterest(Rect? region,
+      {bool upscale = false, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setRegionOfInterest',
+      {
+        if (region != null) 'x': region.left,
+        if (region != null) 'y': region.top,
+        if (region != null) 'width': region.width,
+        if (region != null) 'height': region.height,
+        'upscale': upscale,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> setOverlay({
+    List<OverlayRect> rects = const [],
+    List<OverlayLabel> labels = const [],
+    int? pts,
+    int? textureId,
+  }) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setOverlay',
+      {
+        'rects': [
+          for (final r in rects)
+            [
+              r.rect.left,
+              r.rect.top,
+              r.rect.width,
+              r.rect.height,
+              r.color.value,
+              r.strokeWidth,
+            ],
+        ],
+        'labels': [
+          for (final l in labels)
+            [
+              l.position.dx,
+              l.position.dy,
+              l.text,
+              l.color.value,
+              l.background.value,
+              l.fontSize,
+            ],
+        ],
+        if (pts != null) 'pts': pts,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> setVisibility(bool visible, {int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setVisibility',
+      {
+        'visible': visible,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> suspend({int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'suspend',
+      {if (textureId != null) 'textureId': textureId},
+    );
+  }
+
+  @override
+  Future<void> resume({int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'resume',
+      {if (textureId != null) 'textureId': textureId},
+    );
+  }
+
+  @override
+  Future<void> setLatencyBudget(Duration? budget,
+      {bool requestKeyframe = false}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setLatencyBudget',
+      {
+        'budgetUs': budget?.inMicroseconds ?? 0,
+        'requestKeyframe': requestKeyframe,
+      },
+    );
+  }
+
+  @override
+  Future<void> setOverloadPolicy(
+      {required bool enabled,
+      required int maxQueuedPictures,
+      required Duration maxDecodeTime}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setOverloadPolicy',
+      {
+        'enabled': enabled,
+        'maxQueuedPictures': maxQueuedPictures,
+        'maxDecodeTimeUs': maxDecodeTime.inMicroseconds,
+      },
+    );
+  }
+
+  @override
+  Future<int?> startRtpReceiver(
+      {required int port, String? address, required int payloadType}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMethod<int>(
+      'startRtpReceiver',
+      {
+        'port': port,
+        if (address != null) 'address': address,
+        'payloadType': payloadType,
+      },
+    );
+  }
+
+  @override
+  Future<void> stopRtpReceiver() async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>('stopRtpReceiver');
+  }
+
+  @override
+  Future<void> startShmIngest({required String path, int? capacity}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'startShmIngest',
+      {
+        'path': path,
+        if (capacity != null) 'capacity': capacity,
+      },
+    );
+  }
+
+  @override
+  Future<void> stopShmIngest() async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>('stopShmIngest');
+  }
+
+  @override
+  Future<Map<String, int>?> openFile(
+      {required String path, double? fps}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMapMethod<String, int>(
+      'openFile',
+      {
+        'path': path,
+        if (fps != null) 'fps': fps,
+      },
+    );
+  }
+
+  @override
+  Future<Duration?> seekFile(Duration position, {int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    final result = await methodChannel.invokeMethod<int>(
+      'seekFile',
+      {
+        'position': position.inMicroseconds,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+    return result == null ? null : Duration(microseconds: result);
+  }
+
+  @override
+  Future<void> setFileRate(double rate, {int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setFileRate',
+      {
+        'rate': rate,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<void> closeFile({int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'closeFile',
+      {if (textureId != null) 'textureId': textureId},
+    );
+  }
+
+  @override
+  Future<void> setTimeshift(Duration duration,
+      {required int capacityBytes, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setTimeshift',
+      {
+        'durationUs': duration.inMicroseconds,
+        'capacityBytes': capacityBytes,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<Map<String, num>?> exportTimeshift(
+      {required String path, Duration? back, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMapMethod<String, num>(
+      'exportTimeshift',
+      {
+        'path': path,
+        if (back != null) 'backUs': back.inMicroseconds,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<Map<String, int>?> replayTimeshift(
+      {required int sourceTextureId, Duration? back, int? textureId}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMapMethod<String, int>(
+      'replayTimeshift',
+      {
+        'sourceTextureId': sourceTextureId,
+        if (back != null) 'backUs': back.inMicroseconds,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<int?> requestThumbnails({
+    required String path,
+    required List<Duration> positions,
+    double? fps,
+    int width = 160,
+    int? height,
+    ThumbnailFormat format = ThumbnailFormat.rgba,
+  }) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMethod<int>(
+      'requestThumbnails',
+      {
+        'path': path,
+        'positions': [for (final p in positions) p.inMicroseconds],
+        if (fps != null) 'fps': fps,
+        'width': width,
+        if (height != null) 'height': height,
+        'format': format.name,
+      },
+    );
+  }
+
+  @override
+  Future<void> cancelThumbnails(int requestId) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel
+        .invokeMethod<void>('cancelThumbnails', {'requestId': requestId});
+  }
+
+  @override
+  Future<void> setFrameTap({
+    bool enabled = true,
+    Duration interval = Duration.zero,
+    int? width,
+    int? height,
+    OutputFormat format = OutputFormat.rgba,
+    int? textureId,
+  }) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'setFrameTap',
+      {
+        'enabled': enabled,
+        'intervalUs': interval.inMicroseconds,
+        if (width != null) 'width': width,
+        if (height != null) 'height': height,
+        'format': format.name,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+  }
+
+  @override
+  Future<Snapshot?> snapshot({
+    SnapshotFormat format = SnapshotFormat.png,
+    String? path,
+    int? textureId,
+  }) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    final result = await methodChannel.invokeMapMethod<String, Object?>(
+      'snapshot',
+      {
+        'format': format.name,
+        if (path != null) 'path': path,
+        if (textureId != null) 'textureId': textureId,
+      },
+    );
+    if (result == null) {
+      return null;
+    }
+    return Snapshot(
+      width: result['width'] as int,
+      height: result['height'] as int,
+      format: format,
+      data: result['data'] as Uint8List?,
+      path: result['path'] as String?,
+    );
+  }
+
+  @override
+  Future<void> startTraceRecording({required String path}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'startTraceRecording',
+      {'path': path},
+    );
+  }
+
+  @override
+  Future<Map<String, int>?> stopTraceRecording() async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    return methodChannel.invokeMapMethod<String, int>('stopTraceRecording');
+  }
+
+  @override
+  Future<void> startTraceReplay(
+      {required String path, double speed = 1.0}) async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>(
+      'startTraceReplay',
+      {
+        'path': path,
+        'speed': speed,
+      },
+    );
+  }
+
+  @override
+  Future<void> stopTraceReplay() async {
+    if (!Platform.isLinux) {
+      throw 'Unsupported platform';
+    }
+    await methodChannel.invokeMethod<void>('stopTraceReplay');
+  }
+
+  @override
+  Stream<Map<String, Object?>> get events {
+    if (Platform.isLinux) {
+      return eventChannel
+          .receiveBroadcastStream()
+          .map((event) => Map<String, Object?>.from(event as Map));
+    }
+    return const Stream.empty();
+  }
+
+  @override
+  Future<bool?> needsTransformation({int? textureId}) async {
     if (Platform.isAndroid) {
       final result =
           await methodChannel.invokeMethod<bool>('needsTransformation');
       return result;
+    } else if (Platform.isLinux) {
+      return methodChannel.invokeMethod<bool>(
+        'needsTransformation',
+        {if (textureId != null) 'textureId': textureId},
+      );
     }
     return Future.value(true);
   }
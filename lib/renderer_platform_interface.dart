@@ -1,4 +1,5 @@
 import 'dart:typed_data';
+import 'dart:ui' show Color, Offset, Rect;
 
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
@@ -29,15 +30,193 @@ abstract class RendererPlatform extends PlatformInterface {
     throw UnimplementedError('init() has not been implemented.');
   }
 
-  Future<void> dispose() {
+  Future<int?> createSession(int width, int height) {
+    throw UnimplementedError('createSession() has not been implemented.');
+  }
+
+  Future<void> dispose({int? textureId}) {
     throw UnimplementedError('dispose() has not been implemented.');
   }
 
-  Future<void> addH265Nal(Uint8List nal) {
+  Future<void> addH265Nal(Uint8List nal, {int? pts, int? textureId}) {
     throw UnimplementedError('addH265Nal() has not been implemented.');
   }
 
-  Future<bool?> needsTransformation() {
+  Future<Map<String, int>?> getStats({int? textureId}) {
+    throw UnimplementedError('getStats() has not been implemented.');
+  }
+
+  Future<void> setOutputSize(int width, int height, {int? textureId}) {
+    throw UnimplementedError('setOutputSize() has not been implemented.');
+  }
+
+  Future<int?> addOutput(int width, int height,
+      {OutputFormat format = OutputFormat.rgba, int? textureId}) {
+    throw UnimplementedError('addOutput() has not been implemented.');
+  }
+
+  Future<void> removeOutput(int outputId, {int? textureId}) {
+    throw UnimplementedError('removeOutput() has not been implemented.');
+  }
+
+  Future<int?> createMosaic(int width, int height) {
+    throw UnimplementedError('createMosaic() has not been implemented.');
+  }
+
+  Future<void> setMosaicLayout(int mosaicId, List<MosaicTile> tiles) {
+    throw UnimplementedError('setMosaicLayout() has not been implemented.');
+  }
+
+  Future<void> disposeMosaic(int mosaicId) {
+    throw UnimplementedError('disposeMosaic() has not been implemented.');
+  }
+
+  Future<void> setOrientation(int quarterTurns,
+      {bool mirror = false, int? textureId}) {
+    throw UnimplementedError('setOrientation() has not been implemented.');
+  }
+
+  Future<void> setRegionOfInterest(Rect? region,
+      {bool upscale = false, int? textureId}) {
+    throw UnimplementedError('setRegionOfInterest() has not been implemented.');
+  }
+
+  Future<void> setOverlay({
+    List<OverlayRect> rects = const [],
+    List<OverlayLabel> labels = const [],
+    int? pts,
+    int? textureId,
+  }) {
+    throw UnimplementedError('setOverlay() has not been implemented.');
+  }
+
+  Future<void> setVisibility(bool visible, {int? textureId}) {
+    throw UnimplementedError('setVisibility() has not been implemented.');
+  }
+
+  Future<void> suspend({int? textureId}) {
+    throw UnimplementedError('suspend() has not been implemented.');
+  }
+
+  Future<void> resume({int? textureId}) {
+    throw UnimplementedError('resume() has not been implemented.');
+  }
+
+  Future<void> setLatencyBudget(Duration? budget,
+      {bool requestKeyframe = false}) {
+    throw UnimplementedError('setLatencyBudget() has not been implemented.');
+  }
+
+  Future<void> setOverloadPolicy(
+      {required bool enabled,
+      required int maxQueuedPictures,
+      required Duration maxDecodeTime}) {
+    throw UnimplementedError('setOverloadPolicy() has not been implemented.');
+  }
+
+  Future<int?> startRtpReceiver(
+      {required int port, String? address, required int payloadType}) {
+    throw UnimplementedError('startRtpReceiver() has not been implemented.');
+  }
+
+  Future<void> stopRtpReceiver() {
+    throw UnimplementedError('stopRtpReceiver() has not been implemented.');
+  }
+
+  Future<void> startShmIngest({required String path, int? capacity}) {
+    throw UnimplementedError('startShmIngest() has not been implemented.');
+  }
+
+  Future<void> stopShmIngest() {
+    throw UnimplementedError('stopShmIngest() has not been implemented.');
+  }
+
+  Future<Map<String, int>?> openFile({required String path, double? fps}) {
+    throw UnimplementedError('openFile() has not been implemented.');
+  }
+
+  Future<Duration?> seekFile(Duration position, {int? textureId}) {
+    throw UnimplementedError('seekFile() has not been implemented.');
+  }
+
+  Future<void> setFileRate(double rate, {int? textureId}) {
+    throw UnimplementedError('setFileRate() has not been implemented.');
+  }
+
+  Future<void> closeFile({int? textureId}) {
+    throw UnimplementedError('closeFile() has not been implemented.');
+  }
+
+  Future<void> setTimeshift(Duration duration,
+      {required int capacityBytes, int? textureId}) {
+    throw UnimplementedError('setTimeshift() has not been implemented.');
+  }
+
+  Future<Map<String, num>?> exportTimeshift(
+      {required String path, Duration? back, int? textureId}) {
+    throw UnimplementedError('exportTimeshift() has not been implemented.');
+  }
+
+  Future<Map<String, int>?> replayTimeshift(
+      {required int sourceTextureId, Duration? back, int? textureId}) {
+    throw UnimplementedError('replayTimeshift() has not been implemented.');
+  }
+
+  Future<int?> requestThumbnails({
+    required String path,
+    required List<Duration> positions,
+    double? fps,
+    int width = 160,
+    int? height,
+    ThumbnailFormat format = ThumbnailFormat.rgba,
+  }) {
+    throw UnimplementedError('requestThumbnails() has not been implemented.');
+  }
+
+  Future<void> cancelThumbnails(int requestId) {
+    throw UnimplementedError('cancelThumbnails() has not been implemented.');
+  }
+
+  Future<void> setFrameTap({
+    bool enabled = true,
+    Duration interval = Duration.zero,
+    int? width,
+    int? height,
+    OutputFormat format = OutputFormat.rgba,
+    int? textureId,
+  }) {
+    throw UnimplementedError('setFrameTap() has not been implemented.');
+  }
+
+  Future<Snapshot?> snapshot({
+    SnapshotFormat format = SnapshotFormat.png,
+    String? path,
+    int? textureId,
+  }) {
+    throw UnimplementedError('snapshot() has not been implemented.');
+  }
+
+  Future<void> startTraceRecording({required String path}) {
+    throw UnimplementedError('startTraceRecording() has not been implemented.');
+  }
+
+  Future<Map<String, int>?> stopTraceRecording() {
+    throw UnimplementedError('stopTraceRecording() has not been implemented.');
+  }
+
+  Future<void> startTraceReplay({required String path, double speed = 1.0}) {
+    throw UnimplementedError('startTraceReplay() has not been implemented.');
+  }
+
+  Future<void> stopTraceReplay() {
+    throw UnimplementedError('stopTraceReplay() has not been implemented.');
+  }
+
+  Stream<Map<String, Object?>> get events {
+    throw UnimplementedError('events has not been implemented.');
+  }
+
+  Future<bool?> needsTransformation({int? textureId}) {
     throw UnimplementedError('needsTransformation() has not been implemented.');
   }
 
@@ -46,6 +225,31 @@ abstract class RendererPlatform extends PlatformInterface {
   }
 }
 
+enum ThumbnailFormat { rgba, jpeg }
+
+enum OutputFormat { rgba, grey }
+
+enum SnapshotFormat { png, jpeg, rgba }
+
+/// A still taken by [RendererPlatform.snapshot]. Exactly one of [data] and
+/// [path] is set; [SnapshotFormat.rgba] data is [width] x [height] pixels,
+/// top row first.
+class Snapshot {
+  final int width;
+  final int height;
+  final SnapshotFormat format;
+  final Uint8List? data;
+  final String? path;
+
+  Snapshot({
+    required this.width,
+    required this.height,
+    required this.format,
+    this.data,
+    this.path,
+  });
+}
+
 class ParameterSets {
   final Uint8List vps;
   final Uint8List sps;
@@ -57,3 +261,55 @@ class ParameterSets {
     required this.pps,
   });
 }
+
+/// Where a session's frames go in a mosaic, in pixels from the top left
+/// corner of the atlas. Frames are stretched over the rectangle.
+class MosaicTile {
+  final int textureId;
+  final int x;
+  final int y;
+  final int width;
+  final int height;
+
+  MosaicTile({
+    required this.textureId,
+    required this.x,
+    required this.y,
+    required this.width,
+    required this.height,
+  });
+}
+
+/// A box drawn over a session's frames by [RendererPlatform.setOverlay].
+/// [rect] is in fractions of the texture's width and height, from its top
+/// left corner. A [strokeWidth] of 0 fills it.
+class OverlayRect {
+  final Rect rect;
+  final Color color;
+  final double strokeWidth;
+
+  OverlayRect({
+    required this.rect,
+    this.color = const Color(0xFFFF0000),
+    this.strokeWidth = 2,
+  });
+}
+
+/// Text on a [background] box whose top left corner is at [position], in
+/// fractions of the texture's width and height. [fontSize] is in texture
+/// pixels.
+class OverlayLabel {
+  final Offset position;
+  final String text;
+  final Color color;
+  final Color background;
+  final double fontSize;
+
+  OverlayLabel({
+    required this.position,
+    required this.text,
+    this.color = const Color(0xFFFFFFFF),
+    this.background = const Color(0x80000000),
+    this.fontSize = 16,
+  });
+}
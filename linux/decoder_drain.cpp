@@ -0,0 +1,37 @@
+#include "include/renderer/decoder_drain.h"
+
+void DecoderDrain::begin(uint64_t decoder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    draining = decoder;
+}
+
+void DecoderDrain::finish(uint64_t decoder)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // A drain cancelled meanwhile may have been followed by another.
+        if (draining != decoder)
+        {
+            return;
+        }
+        draining = 0;
+    }
+    condition.notify_all();
+}
+
+void DecoderDrain::wait(uint64_t decoder)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this, decoder]()
+                   { return draining == 0 || decoder <= draining; });
+}
+
+void DecoderDrain::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        draining = 0;
+    }
+    condition.notify_all();
+}
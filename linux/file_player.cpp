@@ -0,0 +1,440 @@
+#include "include/renderer/file_player.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    // Reverse groups are fed this long before their first frame is due, so
+    // the whole group can be decoded in time.
+    const int64_t kReverseLead = 500000;
+    // Decoded frames a reverse group may hold at once; each is a full RGBA image.
+    const size_t kMaxReverseFrames = 16;
+    // An end of sequence NAL unit, so the IRAP after a jump starts afresh.
+    const uint8_t kEndOfSequence[] = {0, 0, 0, 1, HEVC_NAL_EOS << 1, 1};
+
+    int64_t monotonicTime()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    std::chrono::steady_clock::time_point timePoint(int64_t time)
+    {
+        return std::chrono::steady_clock::time_point(std::chrono::microseconds(time));
+    }
+
+    bool isRasl(int type)
+    {
+        return type == HEVC_NAL_RASL_N || type == HEVC_NAL_RASL_R;
+    }
+}
+
+FilePlayer::FilePlayer(FilePlayerCallbacks callbacks)
+    : callbacks(std::move(callbacks))
+{
+}
+
+FilePlayer::~FilePlayer()
+{
+    stop();
+}
+
+bool FilePlayer::open(const char *path, double fps, const std::string &cache_dir)
+{
+    stop();
+    if (fps <= 0 || !file.open(path, cache_dir))
+    {
+        return false;
+    }
+    frame_duration = int64_t(1000000 / fps);
+    buildTiers();
+    rate = 1.0;
+    paused = false;
+    tier = pending_tier = 0;
+    next = 0;
+    skip_rasl = false;
+    decoder_started = false;
+    restart_pending = false;
+    ended_reported = false;
+    last_keyframe = HevcFile::kNoIrap;
+    wall_base = monotonicTime();
+    stream_base = stream_time = 0;
+    media_anchor = stream_anchor = 0;
+    running = true;
+    thread = std::thread([this]()
+                         { run(); });
+    return true;
+}
+
+FilePlaybackInfo FilePlayer::info()
+{
+    FilePlaybackInfo info;
+    info.frames = file.accessUnits().size();
+    info.keyframes = file.keyframeCount();
+    info.duration = info.frames * frame_duration;
+    return info;
+}
+
+int64_t FilePlayer::seek(int64_t position)
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    if (units.empty())
+    {
+        return -1;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    jumpTo(position);
+    condition.notify_one();
+    return media_anchor;
+}
+
+void FilePlayer::setRate(double rate)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (rate == this->rate && !paused)
+    {
+        return;
+    }
+    const int64_t position = mediaPosition();
+    media_anchor = position;
+    stream_anchor = std::max(stream_time, clockNow());
+    if (rate == 0)
+    {
+        paused = true;
+        return;
+    }
+    paused = false;
+
+    const size_t new_tier = tierForRate(rate);
+    const bool keyframes_only = tiers[tier].max_temporal_id < 0;
+    const bool same_mode = (rate > 0) == (this->rate > 0) && keyframes_only == (tiers[new_tier].max_temporal_id < 0);
+    this->rate = rate;
+    if (!same_mode)
+    {
+        tier = pending_tier = new_tier;
+        jumpTo(position);
+    }
+    else if (rate > 0 && !keyframes_only)
+    {
+        // Keep feeding where we are. Fewer pictures can be fed at once;
+        // more only from the next IRAP, since their references are missing.
+        pending_tier = new_tier;
+        tier = std::max(tier, new_tier);
+    }
+    else
+    {
+        // Reverse groups and keyframes decode on their own.
+        tier = pending_tier = new_tier;
+    }
+    condition.notify_one();
+}
+
+void FilePlayer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    condition.notify_one();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    file.close();
+}
+
+void FilePlayer::buildTiers()
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    int max_temporal_id = 0;
+    for (const HevcAccessUnit &unit : units)
+    {
+        max_temporal_id = std::max<int>(max_temporal_id, unit.temporal_id);
+    }
+
+    tiers.clear();
+    for (int temporal_id = max_temporal_id; temporal_id >= -1; temporal_id--)
+    {
+        for (int drop = 0; drop < (temporal_id >= 0 ? 2 : 1); drop++)
+        {
+            Tier tier{temporal_id, drop == 1, 0};
+            size_t kept = 0;
+            for (const HevcAccessUnit &unit : units)
+            {
+                kept += keep(unit, tier);
+            }
+            tier.fraction = double(kept) / units.size();
+            // Only keep tiers that actually shed pictures.
+            if (tiers.empty() || tier.fraction < tiers.back().fraction || temporal_id < 0)
+            {
+                tiers.push_back(tier);
+            }
+        }
+    }
+}
+
+size_t FilePlayer::tierForRate(double rate) const
+{
+    // The first tier that keeps the decoder at no more than its normal rate.
+    const double speed = std::fabs(rate);
+    for (size_t i = 0; i + 1 < tiers.size(); i++)
+    {
+        if (tiers[i].fraction * speed <= 1.0 + 1e-6)
+        {
+            return i;
+        }
+    }
+    return tiers.size() - 1;
+}
+
+bool FilePlayer::keep(const HevcAccessUnit &unit, const Tier &tier) const
+{
+    return hevcInSubLayerSubset(unit.type, unit.temporal_id, tier.max_temporal_id, tier.drop_non_reference);
+}
+
+void FilePlayer::jumpTo(int64_t position)
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    const int64_t duration = units.size() * frame_duration;
+    position = std::min(std::max<int64_t>(position, 0), duration - 1);
+    const size_t target = position / frame_duration;
+    const bool keyframes_only = tiers[tier].max_temporal_id < 0;
+
+    if (rate < 0 && !keyframes_only)
+    {
+        next = target + 1;
+        media_anchor = next * frame_duration;
+    }
+    else
+    {
+        // Before the first IRAP nothing decodes, so start at the top and let
+        // the decoder skip ahead.
+        next = units[target].irap == HevcFile::kNoIrap ? 0 : units[target].irap;
+        media_anchor = keyframes_only ? position : next * frame_duration;
+    }
+    // After a pause at the end of the file, pick the clock up at now.
+    stream_anchor = std::max(stream_time, clockNow());
+    skip_rasl = true;
+    restart_pending = true;
+    ended_reported = false;
+    last_keyframe = HevcFile::kNoIrap;
+}
+
+int64_t FilePlayer::clockNow() const
+{
+    return stream_base + monotonicTime() - wall_base;
+}
+
+int64_t FilePlayer::dueTime(int64_t pts) const
+{
+    return wall_base + pts - stream_base;
+}
+
+int64_t FilePlayer::mediaPosition() const
+{
+    if (paused)
+    {
+        return media_anchor;
+    }
+    const int64_t duration = file.accessUnits().size() * frame_duration;
+    const int64_t elapsed = std::max<int64_t>(clockNow() - stream_anchor, 0);
+    const int64_t position = media_anchor + int64_t(elapsed * rate);
+    return std::min(std::max<int64_t>(position, 0), duration);
+}
+
+int64_t FilePlayer::ptsFor(int64_t media) const
+{
+    return stream_anchor + int64_t((media - media_anchor) / rate);
+}
+
+void FilePlayer::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running)
+    {
+        if (paused)
+        {
+            condition.wait(lock);
+            continue;
+        }
+        if (restart_pending)
+        {
+            restart_pending = false;
+            decoder_started = false;
+            lock.unlock();
+            callbacks.discontinuity();
+            lock.lock();
+            continue;
+        }
+
+        bool fed = false;
+        if (tiers[tier].max_temporal_id < 0)
+        {
+            fed = stepKeyframes(lock);
+        }
+        else if (rate > 0)
+        {
+            fed = stepForward(lock);
+        }
+        else
+        {
+            fed = stepReverse(lock);
+        }
+        if (fed)
+        {
+            decoder_started = true;
+        }
+    }
+}
+
+bool FilePlayer::stepForward(std::unique_lock<std::mutex> &lock)
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    if (next >= units.size())
+    {
+        reportEnd(lock);
+        return false;
+    }
+
+    const HevcAccessUnit &unit = units[next];
+    if (hevcIsIrap(unit.type))
+    {
+        tier = pending_tier;
+        if (decoder_started)
+        {
+            skip_rasl = false;
+        }
+    }
+    if (!keep(unit, tiers[tier]) || (skip_rasl && isRasl(unit.type)))
+    {
+        next++;
+        return false;
+    }
+
+    const int64_t pts = std::max(ptsFor(next * frame_duration), stream_time);
+    if (monotonicTime() < dueTime(pts))
+    {
+        condition.wait_until(lock, timePoint(dueTime(pts)));
+        return false;
+    }
+
+    next++;
+    stream_time = pts + 1;
+    const HevcAccessUnit fed = unit;
+    lock.unlock();
+    callbacks.nal(file.data() + fed.offset, fed.size, pts);
+    lock.lock();
+    return true;
+}
+
+bool FilePlayer::stepReverse(std::unique_lock<std::mutex> &lock)
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    if (next == 0 || units[next - 1].irap == HevcFile::kNoIrap)
+    {
+        reportEnd(lock);
+        return false;
+    }
+
+    const size_t end = next;
+    const size_t begin = units[end - 1].irap;
+    const int64_t first_pts = std::max(ptsFor(end * frame_duration), stream_time);
+    const int64_t span = int64_t((end - begin) * frame_duration / -rate);
+    const int64_t feed_time = dueTime(first_pts) - kReverseLead;
+    if (monotonicTime() < feed_time)
+    {
+        condition.wait_until(lock, timePoint(feed_time));
+        return false;
+    }
+
+    // The RASL pictures of the group's IRAP reference the group before it,
+    // which is not decoded yet.
+    std::vector<HevcAccessUnit> group;
+    for (size_t i = begin; i < end; i++)
+    {
+        if (keep(units[i], tiers[tier]) && !isRasl(units[i].type))
+        {
+            group.push_back(units[i]);
+        }
+    }
+    const size_t stride = (group.size() + kMaxReverseFrames - 1) / kMaxReverseFrames;
+    const int64_t arrival = dueTime(first_pts);
+    next = begin;
+    stream_time = first_pts + span;
+
+    lock.unlock();
+    sendEndOfSequence();
+    callbacks.reverse_group(group.size(), stride, first_pts, span, arrival);
+    for (const HevcAccessUnit &unit : group)
+    {
+        callbacks.nal(file.data() + unit.offset, unit.size, -1);
+    }
+    callbacks.reverse_group_fed();
+    lock.lock();
+    return true;
+}
+
+bool FilePlayer::stepKeyframes(std::unique_lock<std::mutex> &lock)
+{
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+    const int64_t duration = units.size() * frame_duration;
+    const int64_t position = mediaPosition();
+    if ((rate > 0 && position >= duration) || (rate < 0 && position <= 0))
+    {
+        reportEnd(lock);
+        return false;
+    }
+
+    const size_t index = std::min<size_t>(position / frame_duration, units.size() - 1);
+    const uint32_t keyframe = units[index].irap;
+    if (keyframe == HevcFile::kNoIrap && rate < 0)
+    {
+        reportEnd(lock);
+        return false;
+    }
+    if (keyframe == HevcFile::kNoIrap || keyframe == last_keyframe)
+    {
+        // Check again after one frame interval.
+        condition.wait_for(lock, std::chrono::microseconds(frame_duration));
+        return false;
+    }
+
+    last_keyframe = keyframe;
+    const int64_t pts = std::max(clockNow(), stream_time);
+    stream_time = pts + 1;
+    const HevcAccessUnit unit = units[keyframe];
+    lock.unlock();
+    sendEndOfSequence();
+    callbacks.nal(file.data() + unit.offset, unit.size, pts);
+    lock.lock();
+    return true;
+}
+
+void FilePlayer::sendEndOfSequence()
+{
+    // Called unlocked; decoder_started only changes on this thread.
+    if (decoder_started)
+    {
+        callbacks.nal(kEndOfSequence, sizeof(kEndOfSequence), -1);
+    }
+}
+
+void FilePlayer::reportEnd(std::unique_lock<std::mutex> &lock)
+{
+    if (!ended_reported)
+    {
+        ended_reported = true;
+        lock.unlock();
+        callbacks.ended();
+        lock.lock();
+    }
+    if (!restart_pending && running)
+    {
+        condition.wait(lock);
+    }
+}
@@ -1,5 +1,6 @@
 #include "include/renderer/fl_my_texture_gl.h"
 #include "include/renderer/opengl_renderer.h"
+#include "include/renderer/texture_swap_chain.h"
 
 G_DEFINE_TYPE(FlMyTextureGL,
               fl_my_texture_gl,
@@ -14,32 +15,39 @@ static gboolean fl_my_texture_gl_populate(FlTextureGL *texture,
 {
     FlMyTextureGL *f = (FlMyTextureGL *)texture;
     *target = f->target;
-    *name = f->name;
-    *width = f->width;
-    *height = f->height;
-    return true;
+    if (!f->swap_chain->latest(name, width, height))
+    {
+        g_set_error_literal(error, g_quark_from_static_string("fl-my-texture-gl"), 0,
+                            "No buffer has been published yet");
+        return FALSE;
+    }
+    return TRUE;
 }
 
 FlMyTextureGL *fl_my_texture_gl_new(uint32_t target,
-                                    uint32_t name,
-                                    uint32_t width,
-                                    uint32_t height)
+                                    TextureSwapChain *swap_chain)
 {
     auto r = FL_MY_TEXTURE_GL(g_object_new(fl_my_texture_gl_get_type(), nullptr));
     r->target = target;
-    r->name = name;
-    r->width = width;
-    r->height = height;
+    r->swap_chain = swap_chain;
     return r;
 }
 
+static void fl_my_texture_gl_finalize(GObject *object)
+{
+    FlMyTextureGL *self = FL_MY_TEXTURE_GL(object);
+    delete self->swap_chain;
+    G_OBJECT_CLASS(fl_my_texture_gl_parent_class)->finalize(object);
+}
+
 static void fl_my_texture_gl_class_init(
     FlMyTextureGLClass *klass)
 {
+    G_OBJECT_CLASS(klass)->finalize = fl_my_texture_gl_finalize;
     FL_TEXTURE_GL_CLASS(klass)->populate =
         fl_my_texture_gl_populate;
 }
 
 static void fl_my_texture_gl_init(FlMyTextureGL *self)
 {
-}
\ No newline at end of file
+}
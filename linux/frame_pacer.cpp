@@ -0,0 +1,179 @@
+#include "include/renderer/frame_pacer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    const int64_t kMinPlayoutDelay = 5000;
+    const int64_t kMaxPlayoutDelay = 500000;
+    // Number of arrivals over which the fastest transit is tracked.
+    const int kOffsetWindow = 128;
+    // Frames beyond this are discarded oldest-first; each one is a full RGBA image.
+    const size_t kMaxQueuedFrames = 8;
+}
+
+void FramePacer::onArrival(int64_t pts, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const int64_t transit = now - pts;
+    if (!clock_valid)
+    {
+        clock_valid = true;
+        offset = window_min = previous_window_min = transit;
+        window_count = 0;
+        jitter = 0;
+        playout_delay = kMinPlayoutDelay;
+    }
+    else
+    {
+        // Interarrival jitter estimate as in RFC 3550, section 6.4.1.
+        const int64_t d = (now - last_arrival_time) - (pts - last_arrival_pts);
+        jitter += (std::llabs(d) - jitter) / 16;
+
+        // Keep the minimum transit of the current and the previous window,
+        // so the offset can follow slow drift between sender and local clocks.
+        window_min = std::min(window_min, transit);
+        if (++window_count == kOffsetWindow)
+        {
+            previous_window_min = window_min;
+            window_min = transit;
+            window_count = 0;
+        }
+        offset = std::min(window_min, previous_window_min);
+    }
+    last_arrival_pts = pts;
+    last_arrival_time = now;
+    adaptDelay();
+}
+
+void FramePacer::push(DecodedFrame frame, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (frame.pts >= 0 && clock_valid)
+    {
+        if (frame.pts <= last_presented_pts)
+        {
+            counters.frames_dropped++;
+            return;
+        }
+
+        // How long after its nominal arrival the frame left the decoder.
+        const int64_t margin = now - (frame.pts + offset);
+        decode_margin = std::max(decode_margin - decode_margin / 256, margin);
+        adaptDelay();
+    }
+
+    auto it = frames.end();
+    if (frame.pts >= 0)
+    {
+        it = std::upper_bound(frames.begin(), frames.end(), frame.pts,
+                              [](int64_t pts, const DecodedFrame &f)
+                              { return pts < f.pts; });
+    }
+    frames.insert(it, std::move(frame));
+
+    while (frames.size() > kMaxQueuedFrames)
+    {
+        frames.pop_front();
+        counters.frames_dropped++;
+    }
+}
+
+bool FramePacer::pop(int64_t now, DecodedFrame &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Find the newest frame whose time has come; everything before it is late.
+    size_t due = 0;
+    bool found = false;
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const DecodedFrame &f = frames[i];
+        if (f.pts >= 0 && clock_valid && dueTime(f.pts) > now)
+        {
+            break;
+        }
+        due = i;
+        found = true;
+    }
+    if (!found)
+    {
+        return false;
+    }
+
+    counters.frames_dropped += due;
+    frames.erase(frames.begin(), frames.begin() + due);
+    frame = std::move(frames.front());
+    frames.pop_front();
+
+    counters.frames_presented++;
+    if (frame.pts >= 0 && clock_valid)
+    {
+        const int64_t latency = now - (frame.pts + offset);
+        counters.latency += (latency - counters.latency) / 16;
+        if (last_presented_pts >= 0)
+        {
+            const int64_t error = (now - last_presented_time) - (frame.pts - last_presented_pts);
+            counters.pacing_error += (std::llabs(error) - counters.pacing_error) / 16;
+        }
+        last_presented_pts = frame.pts;
+    }
+    last_presented_time = now;
+    return true;
+}
+
+int64_t FramePacer::oldestFrameTime()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t oldest = -1;
+    for (const DecodedFrame &frame : frames)
+    {
+        if (oldest < 0 || frame.decoded_time < oldest)
+        {
+            oldest = frame.decoded_time;
+        }
+    }
+    return oldest;
+}
+
+void FramePacer::reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    frames.clear();
+    clock_valid = false;
+    decode_margin = 0;
+    last_presented_pts = -1;
+}
+
+PacingStats FramePacer::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    PacingStats result = counters;
+    result.queued_frames = frames.size();
+    result.playout_delay = playout_delay;
+    result.jitter = jitter;
+    return result;
+}
+
+int64_t FramePacer::dueTime(int64_t pts) const
+{
+    return pts + offset + playout_delay;
+}
+
+void FramePacer::adaptDelay()
+{
+    const int64_t target = std::min(std::max(kMinPlayoutDelay + decode_margin + 3 * jitter,
+                                             kMinPlayoutDelay),
+                                    kMaxPlayoutDelay);
+    if (target > playout_delay)
+    {
+        // Grow at once so the queue does not run dry...
+        playout_delay = target;
+    }
+    else
+    {
+        // ...and shrink slowly so a single quiet period does not cause stutter.
+        playout_delay -= (playout_delay - target) / 64;
+    }
+}
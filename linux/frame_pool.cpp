@@ -0,0 +1,39 @@
+#include "include/renderer/frame_pool.h"
+
+std::vector<uint8_t> FramePool::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (buffers.empty())
+    {
+        return std::vector<uint8_t>(frame_size);
+    }
+    std::vector<uint8_t> buffer = std::move(buffers.back());
+    buffers.pop_back();
+    return buffer;
+}
+
+void FramePool::release(std::vector<uint8_t> buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // Frames still in flight from before a resize are simply freed.
+    if (buffer.size() == frame_size && buffers.size() < kMaxPooledFrames)
+    {
+        buffers.push_back(std::move(buffer));
+    }
+}
+
+void FramePool::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers.clear();
+}
+
+void FramePool::resize(size_t frame_size)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (this->frame_size != frame_size)
+    {
+        this->frame_size = frame_size;
+        buffers.clear();
+    }
+}
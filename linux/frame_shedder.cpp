@@ -0,0 +1,143 @@
+#include "include/renderer/frame_shedder.h"
+
+#include <algorithm>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    // Time between two steps up, so each one can take effect first.
+    const int64_t kEscalateInterval = 250000;
+    // Time without overload before stepping down.
+    const int64_t kRecoverInterval = 2000000;
+    // More pictures than this queued in the decoder means some were
+    // discarded there without output; the oldest records are stale.
+    const size_t kMaxInFlight = 64;
+}
+
+void FrameShedder::configure(bool enabled, size_t max_queued_pictures, int64_t max_decode_time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->enabled = enabled;
+    this->max_queued_pictures = max_queued_pictures;
+    this->max_decode_time = max_decode_time;
+    // Pictures shed so far come back at the next IRAP.
+    target_level = 0;
+}
+
+void FrameShedder::setLevelCallback(LevelCallback callback)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->callback = std::move(callback);
+}
+
+bool FrameShedder::admit(int type, int temporal_id, int64_t now)
+{
+    bool admitted;
+    bool changed = false;
+    SheddingStats current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        max_temporal_id_seen = std::max(max_temporal_id_seen, temporal_id);
+        if (hevcIsIrap(type) && level > target_level)
+        {
+            level = target_level;
+            changed = true;
+        }
+        changed = evaluate(now) || changed;
+
+        const SheddingStats state = snapshot();
+        admitted = level == 0 ||
+                   hevcInSubLayerSubset(type, temporal_id, state.max_temporal_id, state.drop_non_reference);
+        if (!admitted)
+        {
+            pictures_shed++;
+        }
+        current = snapshot();
+    }
+    if (changed && callback)
+    {
+        callback(current);
+    }
+    return admitted;
+}
+
+void FrameShedder::onPicturesQueued(int count, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (int i = 0; i < count; i++)
+    {
+        in_flight.push_back(now);
+    }
+    while (in_flight.size() > kMaxInFlight)
+    {
+        in_flight.pop_front();
+    }
+}
+
+void FrameShedder::onFrameDecoded(int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!in_flight.empty())
+    {
+        decode_time += (now - in_flight.front() - decode_time) / 8;
+        in_flight.pop_front();
+    }
+}
+
+void FrameShedder::onDecoderReset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    in_flight.clear();
+    decode_time = 0;
+}
+
+SheddingStats FrameShedder::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return snapshot();
+}
+
+bool FrameShedder::evaluate(int64_t now)
+{
+    if (!enabled)
+    {
+        return false;
+    }
+    // Two levels per sub-layer: its non-reference pictures, then the rest.
+    // The last sub-layer is never dropped entirely.
+    const int max_level = 2 * max_temporal_id_seen + 1;
+    const bool overloaded = in_flight.size() > max_queued_pictures || decode_time > max_decode_time;
+    const bool idle = in_flight.size() <= max_queued_pictures / 2 && decode_time < max_decode_time / 2;
+
+    if (overloaded)
+    {
+        last_overload = now;
+        if (level < max_level && now - last_change >= kEscalateInterval)
+        {
+            // Dropping more never breaks references, so it applies at once.
+            level = target_level = level + 1;
+            last_change = now;
+            return true;
+        }
+    }
+    else if (idle && target_level > 0 && now - last_overload >= kRecoverInterval &&
+             now - last_change >= kRecoverInterval)
+    {
+        target_level--;
+        last_change = now;
+    }
+    return false;
+}
+
+SheddingStats FrameShedder::snapshot() const
+{
+    SheddingStats result;
+    result.level = level;
+    result.max_temporal_id = max_temporal_id_seen - level / 2;
+    result.drop_non_reference = level % 2 == 1;
+    result.pictures_shed = pictures_shed;
+    result.queued_pictures = in_flight.size();
+    result.decode_time = decode_time;
+    return result;
+}
@@ -0,0 +1,164 @@
+#include "include/renderer/frame_tap.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // The largest size of the frame's aspect ratio within the bounds, never
+    // larger than the frame; a bound of 0 leaves that side free.
+    void tapSize(const TapConfig &config, int width, int height, int &tap_width, int &tap_height)
+    {
+        double scale = 1.0;
+        if (config.width > 0)
+        {
+            scale = std::min(scale, double(config.width) / width);
+        }
+        if (config.height > 0)
+        {
+            scale = std::min(scale, double(config.height) / height);
+        }
+        tap_width = std::max(1, int(width * scale));
+        tap_height = std::max(1, int(height * scale));
+    }
+
+    // BT.709 luma in 8.8 fixed point, as used for grey outputs on the GPU.
+    inline uint8_t luma(uint32_t r, uint32_t g, uint32_t b)
+    {
+        return uint8_t((54 * r + 183 * g + 19 * b) >> 8);
+    }
+}
+
+FrameTap::FrameTap() : pool(std::make_shared<FramePool>())
+{
+}
+
+void FrameTap::configure(const TapConfig &config)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    tap_config = config;
+    last_tap_time = -1;
+    if (!config.enabled)
+    {
+        pool->clear();
+    }
+}
+
+TapConfig FrameTap::config()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return tap_config;
+}
+
+int FrameTap::addListener(Listener listener)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const int id = next_listener_id++;
+    listeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void FrameTap::removeListener(int id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(),
+                                   [id](const std::pair<int, Listener> &entry)
+                                   { return entry.first == id; }),
+                    listeners.end());
+}
+
+void FrameTap::onFrameDecoded(const uint8_t *rgba, int width, int height, int64_t pts, int64_t decoded_time)
+{
+    TapConfig config;
+    std::vector<std::pair<int, Listener>> targets;
+    uint64_t frame_sequence;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!tap_config.enabled || listeners.empty())
+        {
+            return;
+        }
+        if (last_tap_time >= 0 && decoded_time - last_tap_time < tap_config.interval)
+        {
+            return;
+        }
+        last_tap_time = decoded_time;
+        config = tap_config;
+        targets = listeners;
+        frame_sequence = sequence++;
+    }
+
+    TapFrame *frame = new TapFrame();
+    tapSize(config, width, height, frame->width, frame->height);
+    frame->format = config.format;
+    frame->pts = pts;
+    frame->decoded_time = decoded_time;
+    frame->sequence = frame_sequence;
+    const size_t pixel_size = config.format == TAP_FORMAT_GREY ? 1 : 4;
+    pool->resize(size_t(frame->width) * frame->height * pixel_size);
+    frame->data = pool->acquire();
+    convert(rgba, width, height, *frame);
+
+    // The buffer goes back to the pool with the last reference, on whatever
+    // thread drops it.
+    std::weak_ptr<FramePool> weak_pool = pool;
+    std::shared_ptr<const TapFrame> shared(frame, [weak_pool](TapFrame *frame)
+                                           {
+        if (std::shared_ptr<FramePool> pool = weak_pool.lock())
+        {
+            pool->release(std::move(frame->data));
+        }
+        delete frame; });
+    for (const auto &entry : targets)
+    {
+        entry.second(shared);
+    }
+}
+
+void FrameTap::convert(const uint8_t *rgba, int width, int height, TapFrame &frame)
+{
+    const bool grey = frame.format == TAP_FORMAT_GREY;
+    if (frame.width == width && frame.height == height && !grey)
+    {
+        memcpy(frame.data.data(), rgba, frame.data.size());
+        return;
+    }
+
+    // Box filter: each tapped pixel averages the block of source pixels it
+    // covers, which is a single pixel at the decoded size.
+    uint8_t *out = frame.data.data();
+    for (int y = 0; y < frame.height; y++)
+    {
+        const int y0 = int(int64_t(y) * height / frame.height);
+        const int y1 = std::max(y0 + 1, int(int64_t(y + 1) * height / frame.height));
+        for (int x = 0; x < frame.width; x++)
+        {
+            const int x0 = int(int64_t(x) * width / frame.width);
+            const int x1 = std::max(x0 + 1, int(int64_t(x + 1) * width / frame.width));
+            uint32_t sum[4] = {0, 0, 0, 0};
+            for (int sy = y0; sy < y1; sy++)
+            {
+                const uint8_t *pixel = rgba + (size_t(sy) * width + x0) * 4;
+                for (int sx = x0; sx < x1; sx++, pixel += 4)
+                {
+                    sum[0] += pixel[0];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[2];
+                    sum[3] += pixel[3];
+                }
+            }
+            const uint32_t count = uint32_t(y1 - y0) * (x1 - x0);
+            if (grey)
+            {
+                *out++ = luma(sum[0] / count, sum[1] / count, sum[2] / count);
+            }
+            else
+            {
+                for (int c = 0; c < 4; c++)
+                {
+                    *out++ = uint8_t(sum[c] / count);
+                }
+            }
+        }
+    }
+}
@@ -4,6 +4,9 @@
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstring>
 #include <iostream>
 #include <memory>
@@ -12,13 +15,108 @@
 #include <vector>
 #include <functional>
 
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "include/renderer/fl_my_texture_gl.h"
+#include "include/renderer/hevc_nal.h"
 #include "include/renderer/opengl_renderer.h"
+#include "include/renderer/texture_swap_chain.h"
+#include "include/renderer/upload_thread.h"
+
+namespace
+{
+    // Frames of a reverse group held by the pacer at once.
+    const size_t kReverseQueuedFrames = 4;
+
+    // Overlay batches waiting for their frame beyond this are dropped,
+    // oldest first.
+    const size_t kMaxPendingOverlays = 16;
+
+    // How long the upload thread waits for a readback each time it looks.
+    const GLuint64 kReadbackPoll = 1000000;
+
+    // Width and height a hidden session decodes at, the smallest ffmpeg
+    // scales to.
+    const int kHiddenDecodeSize = 2;
+
+    void finishSnapshot(UploadThread *upload_thread, std::shared_ptr<OpenGLRenderer> renderer,
+                        Readback readback, H265Decoder::SnapshotCallback done)
+    {
+        std::vector<uint8_t> pixels;
+        if (!renderer->finishReadback(readback, pixels, kReadbackPoll))
+        {
+            // Still copying: let queued uploads run before looking again.
+            upload_thread->post([upload_thread, renderer, readback, done]()
+                                { finishSnapshot(upload_thread, renderer, readback, done); });
+            return;
+        }
+        done(pixels, pixels.empty() ? 0 : readback.width, pixels.empty() ? 0 : readback.height);
+    }
+
+    // Maps a region of the picture as displayed, after turning clockwise by
+    // quarter_turns and mirroring, back to the region of the decoded frame
+    // it comes from. Both are x, y, width, height in fractions of the size.
+    void sourceRegion(int quarter_turns, bool mirror, const float display[4], float source[4])
+    {
+        const float x = mirror ? 1 - display[0] - display[2] : display[0];
+        const float y = display[1];
+        const float w = display[2];
+        const float h = display[3];
+        switch (quarter_turns)
+        {
+        case 1:
+            source[0] = y, source[1] = 1 - x - w, source[2] = h, source[3] = w;
+            break;
+        case 2:
+            source[0] = 1 - x - w, source[1] = 1 - y - h, source[2] = w, source[3] = h;
+            break;
+        case 3:
+            source[0] = 1 - y - h, source[1] = x, source[2] = h, source[3] = w;
+            break;
+        default:
+            source[0] = x, source[1] = y, source[2] = w, source[3] = h;
+            break;
+        }
+    }
+
+    // The largest even size of the frame's aspect ratio within the bounds.
+    void fitSize(int frame_width, int frame_height, int max_width, int max_height,
+                 int &width, int &height)
+    {
+        const double scale = std::min(static_cast<double>(max_width) / frame_width,
+                                      static_cast<double>(max_height) / frame_height);
+        width = std::max(2, static_cast<int>(frame_width * scale / 2) * 2);
+        height = std::max(2, static_cast<int>(frame_height * scale / 2) * 2);
+    }
+
+    // The smallest even size of the stream's aspect ratio that covers the
+    // target, as TextureDisplay fills its box; frames are never scaled up.
+    void coverSize(int stream_width, int stream_height, int target_width, int target_height,
+                   int &width, int &height)
+    {
+        width = stream_width;
+        height = stream_height;
+        if (target_width <= 0 || target_height <= 0)
+        {
+            return;
+        }
+        const double scale = std::max(static_cast<double>(target_width) / stream_width,
+                                      static_cast<double>(target_height) / stream_height);
+        if (scale < 1.0)
+        {
+            width = std::max(2, static_cast<int>(std::ceil(stream_width * scale / 2)) * 2);
+            height = std::max(2, static_cast<int>(std::ceil(stream_height * scale / 2)) * 2);
+        }
+    }
+}
 
 struct ProcessPipes
 {
     FILE *input;
     FILE *output;
+    pid_t pid;
 };
 
 ProcessPipes popen2(const char *command)
@@ -28,13 +126,13 @@ ProcessPipes popen2(const char *command)
 
     if (pipe(in_pipe.data()) < 0 || pipe(out_pipe.data()) < 0)
     {
-        return {nullptr, nullptr};
+        return {nullptr, nullptr, -1};
     }
 
     pid_t pid = fork();
     if (pid < 0)
     {
-        return {nullptr, nullptr};
+        return {nullptr, nullptr, -1};
     }
 
     if (pid == 0)
@@ -57,139 +155,1173 @@ ProcessPipes popen2(const char *command)
 
     return {
         fdopen(in_pipe[1], "w"),
-        fdopen(out_pipe[0], "r")};
-}
-
-void postToMainThread(std::function<void()> callback)
-{
-    // Allocate a heap object to ensure the callback survives across threads
-    std::function<void()> *cb = new std::function<void()>(std::move(callback));
-
-    // Post the callback to the main thread using g_idle_add
-    g_idle_add([](gpointer user_data) -> gboolean
-               {
-                   // Cast the user data to the function pointer
-                   auto cb = static_cast<std::function<void()> *>(user_data);
-                   (*cb)();                // Execute the callback
-                   delete cb;              // Cleanup memory after execution
-                   return G_SOURCE_REMOVE; // Remove from idle list (it runs only once)
-               },
-               cb); // Pass callback pointer to main thread
+        fdopen(out_pipe[0], "r"),
+        pid};
 }
 
 FFmpegProcess launchFFmpegWithCallback(const char *command,
+                                       size_t frameSize,
                                        std::atomic<bool> &thread_run,
-                                       std::function<void(const std::vector<uint8_t> &)> callback)
+                                       std::function<void(std::vector<uint8_t> &)> callback)
 {
     auto pipes = popen2(command);
     if (!pipes.input || !pipes.output)
     {
         perror("Failed to open pipes");
-        return {nullptr, {}};
+        return {nullptr, {}, -1};
     }
 
     FILE *input = pipes.input;
-    std::thread t([output = pipes.output, callback, &thread_run]()
+    thread_run = true;
+    std::thread t([output = pipes.output, frameSize, callback, &thread_run]()
                   {
-        thread_run = true;
-
-        const size_t bufferSize = 4096;
-        std::vector<uint8_t> buffer(bufferSize);
-        std::vector<uint8_t> accumulatedData;
+        // ffmpeg writes tightly packed raw frames, so every frameSize bytes
+        // is exactly one picture. The callback takes the filled buffer and
+        // may leave a recycled one in its place.
+        std::vector<uint8_t> frame(frameSize);
+        size_t filled = 0;
 
         while (thread_run) {
-            size_t bytesRead = fread(buffer.data(), 1, bufferSize, output);
+            size_t bytesRead = fread(frame.data() + filled, 1, frameSize - filled, output);
             if (bytesRead == 0) {
                 break;
             }
 
-            accumulatedData.insert(accumulatedData.end(), 
-                                 buffer.begin(), 
-                                 buffer.begin() + bytesRead);
-
-            const size_t frameSize = 1920 * 1080 * 4;
-            if (accumulatedData.size() >= frameSize) {
-                postToMainThread([accumulatedData, callback]() {
-                    callback(accumulatedData);
-                });
-                accumulatedData.clear();
+            filled += bytesRead;
+            if (filled == frameSize) {
+                callback(frame);
+                frame.resize(frameSize);
+                filled = 0;
             }
         }
 
-        if (!accumulatedData.empty()) {
-            callback(accumulatedData);
-        }
-
         fclose(output); });
 
-    return {input, std::move(t)};
+    return {input, std::move(t), pipes.pid};
 }
 
-H265Decoder::H265Decoder(GdkWindow *window, FlTextureRegistrar *texture_registrar)
+H265Decoder::H265Decoder(GdkWindow *window, FlTextureRegistrar *texture_registrar, UploadThread *upload_thread)
 {
     this->window = window;
     this->texture_registrar = texture_registrar;
+    this->upload_thread = upload_thread;
+    shedder.setLevelCallback([this](const SheddingStats &stats)
+                             {
+        FlValue *event = fl_value_new_map();
+        fl_value_set_string_take(event, "event", fl_value_new_string("degradationChanged"));
+        fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+        fl_value_set_string_take(event, "level", fl_value_new_int(stats.level));
+        fl_value_set_string_take(event, "maxTemporalId", fl_value_new_int(stats.max_temporal_id));
+        fl_value_set_string_take(event, "dropNonReference", fl_value_new_bool(stats.drop_non_reference));
+        postEvent(event); });
 }
 
 H265Decoder::~H265Decoder()
 {
+    stopTraceReplay();
+    closeFile();
+    stopRtpReceiver();
+    stopShmIngest();
+    stopTraceRecording();
     thread_run = false;
+    if (update_handler != 0)
+    {
+        g_signal_handler_disconnect(frame_clock, update_handler);
+    }
+    if (frame_clock_running)
+    {
+        gdk_frame_clock_end_updating(frame_clock);
+    }
+    stopDecoder();
+    if (texture)
+    {
+        fl_texture_registrar_unregister_texture(texture_registrar, texture);
+    }
+    for (const Output &output : outputs)
+    {
+        fl_texture_registrar_unregister_texture(texture_registrar, output.texture);
+    }
+    if (swap_chain)
+    {
+        // Runs after any upload still queued for this decoder.
+        upload_thread->invoke([this]()
+                              {
+            std::vector<GLuint> names = swap_chain->names();
+            for (const Output &output : outputs)
+            {
+                std::vector<GLuint> output_names = output.swap_chain->names();
+                names.insert(names.end(), output_names.begin(), output_names.end());
+            }
+            glDeleteTextures(names.size(), names.data());
+            glDeleteTextures(1, &staging_texture);
+            renderer.reset(); });
+    }
+    for (const Output &output : outputs)
+    {
+        g_object_unref(output.texture);
+    }
+    if (texture)
+    {
+        g_object_unref(texture);
+    }
 }
 
 _FlTexture *H265Decoder::init(int width, int height)
 {
-    GError *error = NULL;
-    GdkGLContext *context = gdk_window_create_gl_context(this->window, &error);
-    gdk_gl_context_make_current(context);
-    auto openglRenderer = std::make_shared<OpenGLRenderer>(context);
-    int texture_name = openglRenderer->genTexture(width, height);
-    FlMyTextureGL *t =
-        fl_my_texture_gl_new(GL_TEXTURE_2D, texture_name, width, height);
-    g_autoptr(FlTexture) texture = FL_TEXTURE(t);
+    stream_width = width;
+    stream_height = height;
+    swap_chain = new TextureSwapChain();
+    // Texture storage is allocated by the upload thread at the first frame,
+    // using the dimensions the decoder actually produces. Until then the
+    // texture shows a placeholder, published before it is registered.
+    upload_thread->invoke([this]()
+                          {
+        renderer = std::make_shared<OpenGLRenderer>(upload_thread->glContext());
+        swap_chain->publishPlaceholder(*renderer); });
+    FlMyTextureGL *t = fl_my_texture_gl_new(GL_TEXTURE_2D, swap_chain);
+    FlTexture *texture = FL_TEXTURE(t);
     fl_texture_registrar_register_texture(texture_registrar, texture);
-    fl_texture_registrar_mark_texture_frame_available(texture_registrar,
-                                                      texture);
+    this->texture = texture;
 
-    if (width == 1)
+    startDecoder();
+
+    // Upload in the update phase of every display refresh, before Flutter
+    // paints, so a new frame is never missed by a whole refresh interval.
+    frame_clock = gdk_window_get_frame_clock(window);
+    update_handler = g_signal_connect(
+        frame_clock, "update",
+        G_CALLBACK(+[](GdkFrameClock *clock, gpointer user_data)
+                   { static_cast<H265Decoder *>(user_data)->presentDueFrame(clock); }),
+        this);
+    updateFrameClock();
+    return texture;
+}
+
+void H265Decoder::addH265Nal(const uint8_t *nal, const size_t size, int64_t pts)
+{
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    const int64_t now = g_get_monotonic_time();
+    trace_recorder.append(nal, size, pts, now);
+
+    if (!suspended && watchdog.expired(now, pacer.oldestFrameTime()))
     {
-        auto ffmpeg_process = launchFFmpegWithCallback(
-            "ffmpeg -hide_banner -probesize 4K -c:v hevc -hwaccel drm -hwaccel_device /dev/dri/renderD128 -i /home/openup/source.h265 -f rawvideo -y /dev/null",
-            thread_run,
-            [](const std::vector<uint8_t> &data)
+        resetDecoder();
+        if (watchdog.requestsKeyframe())
+        {
+            FlValue *event = fl_value_new_map();
+            fl_value_set_string_take(event, "event", fl_value_new_string("keyframeRequested"));
+            fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+            postEvent(event);
+        }
+    }
+
+    HevcSps sps;
+    bool resized = false;
+    bool has_vps = false;
+    bool dropped = false;
+    int pictures = 0;
+    int pictures_seen = 0;
+    bool first_picture_irap = false;
+    // What the timeshift needs to know of the whole unit.
+    int new_pictures = 0;
+    bool has_irap = false;
+    bool has_sps = false;
+    admitted_nals.clear();
+    hevcForEachNal(nal, size, [&](const uint8_t *unit, size_t unit_size)
+                   {
+        const int type = hevcNalType(unit);
+        if (type >= HEVC_NAL_VPS && type <= HEVC_NAL_PPS)
+        {
+            static const uint8_t start_code[] = {0, 0, 0, 1};
+            std::vector<uint8_t> &parameter_set = parameter_sets[type - HEVC_NAL_VPS];
+            parameter_set.assign(start_code, start_code + sizeof(start_code));
+            parameter_set.insert(parameter_set.end(), unit, unit + unit_size);
+            has_vps = has_vps || type == HEVC_NAL_VPS;
+        }
+        if (type == HEVC_NAL_SPS && hevcParseSps(unit, unit_size, sps))
+        {
+            resized = sps.width != stream_width || sps.height != stream_height;
+        }
+        if (hevcIsVcl(type) && hevcIsFirstSliceSegment(unit, unit_size))
+        {
+            new_pictures++;
+            has_irap = has_irap || hevcIsIrap(type);
+        }
+        has_sps = has_sps || type == HEVC_NAL_SPS;
+        if (suspended)
+        {
+            return;
+        }
+        if (hevcIsVcl(type))
+        {
+            // Whole pictures are admitted or dropped, by their first slice.
+            if (hevcIsFirstSliceSegment(unit, unit_size))
+            {
+                first_picture_irap = pictures_seen++ == 0 && hevcIsIrap(type);
+                wait_for_irap = wait_for_irap && !hevcIsIrap(type);
+                // Both see every picture, to follow IRAPs and sub-layers.
+                const bool admitted = watchdog.admit(type);
+                picture_admitted = shedder.admit(type, hevcTemporalId(unit), now) && admitted && !wait_for_irap;
+                pictures += picture_admitted;
+            }
+            if (!picture_admitted)
             {
-                // renderer->update_texture_with_frame(texture_name, data.data(), 1920, 1080);
-                // fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
-            });
-        this->ffmpeg_process = std::move(ffmpeg_process);
+                dropped = true;
+                return;
+            }
+        }
+        admitted_nals.emplace_back(unit, unit_size); });
+    // Recorded as received, also while suspended or shedding.
+    timeshift.append(nal, size, now, new_pictures, has_irap, has_sps, parameter_sets);
+
+    if (suspended)
+    {
+        // The decoder starts at this size on resume.
+        if (resized)
+        {
+            stream_width = sps.width;
+            stream_height = sps.height;
+        }
+        return;
+    }
+    if (resized)
+    {
+        // A new resolution only takes a decoder restart: the texture and its
+        // id stay, and the swap chain reallocates as frames of the new size
+        // arrive. The cached VPS is replayed so the new decoder can start
+        // at this SPS. The old decoder drains in the background, so the
+        // thread feeding NALs, often the main thread, does not wait for it.
+        // A reverse group starting here goes to the next decoder.
+        reverse_cache.handOver(decoder_generation, decoder_generation + 1);
+        retireDecoder();
+        stream_width = sps.width;
+        stream_height = sps.height;
+        startDecoder();
+        const std::vector<uint8_t> &vps = parameter_sets[0];
+        if (!has_vps && !vps.empty())
+        {
+            fwrite(vps.data(), vps.size(), 1, ffmpeg_process.input);
+        }
     }
-    else if (width == 2)
+    else if (output_size_pending && first_picture_irap)
     {
-        auto ffmpeg_process = launchFFmpegWithCallback(
-            "ffmpeg -hide_banner -probesize 4K -c:v hevc -hwaccel drm -hwaccel_device /dev/dri/renderD128 -i /home/openup/source.h265 -pix_fmt yuv420p -f rawvideo -y /dev/null",
-            thread_run,
-            [](const std::vector<uint8_t> &data)
+        // A new output size takes a restart too. At an IRAP the new decoder
+        // needs nothing from the old one, which drains what it still holds
+        // in the background.
+        reverse_cache.handOver(decoder_generation, decoder_generation + 1);
+        retireDecoder();
+        startDecoder();
+        writeParameterSets();
+    }
+
+    if (pts >= 0 && pts != last_pts)
+    {
+        // Parameter sets and the slices of one picture share a timestamp;
+        // only the first NAL of each access unit starts a new frame.
+        last_pts = pts;
+        pacer.onArrival(pts, now);
+    }
+    if (pts >= 0 && pictures > 0)
+    {
+        // Only pictures that reach the decoder come out as frames.
+        std::lock_guard<std::mutex> lock(pts_mutex);
+        pending_pts.insert(pts);
+    }
+    watchdog.onPicturesQueued(pictures, now);
+    shedder.onPicturesQueued(pictures, now);
+
+    if (ffmpeg_process.input)
+    {
+        if (!dropped)
+        {
+            fwrite(nal, size, 1, ffmpeg_process.input);
+        }
+        else
+        {
+            static const uint8_t start_code[] = {0, 0, 1};
+            for (const auto &admitted : admitted_nals)
             {
-                // renderer->update_texture_with_frame(texture_name, data.data(), 1920, 1080);
-                // fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
-            });
-        this->ffmpeg_process = std::move(ffmpeg_process);
+                fwrite(start_code, sizeof(start_code), 1, ffmpeg_process.input);
+                fwrite(admitted.first, admitted.second, 1, ffmpeg_process.input);
+            }
+        }
+        fflush(ffmpeg_process.input);
+    }
+}
+
+void H265Decoder::setLatencyBudget(int64_t budget, bool request_keyframe)
+{
+    watchdog.configure(budget, request_keyframe);
+}
+
+WatchdogStats H265Decoder::watchdogStats()
+{
+    return watchdog.stats(g_get_monotonic_time());
+}
+
+void H265Decoder::setOverloadPolicy(bool enabled, size_t max_queued_pictures, int64_t max_decode_time)
+{
+    shedder.configure(enabled, max_queued_pictures, max_decode_time);
+}
+
+SheddingStats H265Decoder::sheddingStats()
+{
+    return shedder.stats();
+}
+
+int H265Decoder::startRtpReceiver(const char *address, int port, int payload_type)
+{
+    stopRtpReceiver();
+    rtp_receiver.reset(new RtpReceiver([this](const uint8_t *data, size_t size, int64_t pts)
+                                       { addH265Nal(data, size, pts); }));
+    const int bound_port = rtp_receiver->start(address, port, payload_type);
+    if (bound_port < 0)
+    {
+        rtp_receiver.reset();
     }
-    else if (width == 3)
+    return bound_port;
+}
+
+void H265Decoder::stopRtpReceiver()
+{
+    rtp_receiver.reset();
+}
+
+RtpReceiverStats H265Decoder::rtpStats()
+{
+    return rtp_receiver ? rtp_receiver->stats() : RtpReceiverStats();
+}
+
+bool H265Decoder::startShmIngest(const char *path, size_t capacity)
+{
+    stopShmIngest();
+    shm_ingest.reset(new ShmIngest([this](const uint8_t *data, size_t size, int64_t pts)
+                                   { addH265Nal(data, size, pts); }));
+    if (!shm_ingest->start(path, capacity))
     {
-        auto ffmpeg_process = launchFFmpegWithCallback(
-            "ffmpeg -hide_banner -probesize 4K -c:v hevc -hwaccel drm -hwaccel_device /dev/dri/renderD128 -i /home/openup/source.h265 -pix_fmt rgba -f rawvideo -y /dev/null",
-            thread_run,
-            [](const std::vector<uint8_t> &data)
+        shm_ingest.reset();
+        return false;
+    }
+    return true;
+}
+
+void H265Decoder::stopShmIngest()
+{
+    shm_ingest.reset();
+}
+
+bool H265Decoder::startTraceRecording(const char *path)
+{
+    return trace_recorder.start(path);
+}
+
+void H265Decoder::stopTraceRecording()
+{
+    trace_recorder.stop();
+}
+
+NalTraceStats H265Decoder::traceStats()
+{
+    return trace_recorder.stats();
+}
+
+bool H265Decoder::startTraceReplay(const char *path, double speed)
+{
+    stopTraceReplay();
+    trace_player.reset(new NalTracePlayer(
+        [this](const uint8_t *data, size_t size, int64_t pts)
+        { addH265Nal(data, size, pts); },
+        [this](const NalTraceStats &stats, int64_t elapsed)
+        {
+            FlValue *event = fl_value_new_map();
+            fl_value_set_string_take(event, "event", fl_value_new_string("traceReplayFinished"));
+            fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+            fl_value_set_string_take(event, "records", fl_value_new_int(stats.records));
+            fl_value_set_string_take(event, "bytes", fl_value_new_int(stats.bytes));
+            fl_value_set_string_take(event, "elapsedUs", fl_value_new_int(elapsed));
+            postEvent(event);
+        }));
+    if (!trace_player->start(path, speed))
+    {
+        trace_player.reset();
+        return false;
+    }
+    return true;
+}
+
+void H265Decoder::stopTraceReplay()
+{
+    trace_player.reset();
+}
+
+bool H265Decoder::openFile(const char *path, double fps, FilePlaybackInfo &info, bool cache_index)
+{
+    closeFile();
+    gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "streamline_renderer", nullptr);
+    g_mkdir_with_parents(cache_dir, 0755);
+    FilePlayerCallbacks callbacks;
+    callbacks.nal = [this](const uint8_t *data, size_t size, int64_t pts)
+    { addH265Nal(data, size, pts); };
+    callbacks.reverse_group = [this](size_t count, size_t stride, int64_t first_pts, int64_t span, int64_t arrival)
+    {
+        // Each group goes to a decoder of its own: the one started when the
+        // group before it was fed, or at the discontinuity that began
+        // reverse playback.
+        std::lock_guard<std::mutex> input_lock(input_mutex);
+        reverse_cache.expectGroup(decoder_generation, count, stride, first_pts, span);
+        pacer.onArrival(first_pts, arrival);
+    };
+    callbacks.reverse_group_fed = [this]()
+    {
+        // Closing its input flushes the whole group out of the decoder at
+        // once, and the group ends when that decoder has drained, whatever
+        // number of frames it gave.
+        std::lock_guard<std::mutex> input_lock(input_mutex);
+        retireDecoder();
+        startDecoder();
+        writeParameterSets();
+    };
+    callbacks.discontinuity = [this]()
+    { restartDecoder(); };
+    callbacks.ended = [this]()
+    {
+        FlValue *event = fl_value_new_map();
+        fl_value_set_string_take(event, "event", fl_value_new_string("fileEnded"));
+        fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+        postEvent(event);
+    };
+    file_player.reset(new FilePlayer(std::move(callbacks)));
+    const bool opened = file_player->open(path, fps, cache_index ? cache_dir : "");
+    g_free(cache_dir);
+    if (!opened)
+    {
+        file_player.reset();
+        return false;
+    }
+    info = file_player->info();
+    return true;
+}
+
+int64_t H265Decoder::seekFile(int64_t position)
+{
+    return file_player ? file_player->seek(position) : -1;
+}
+
+void H265Decoder::setFileRate(double rate)
+{
+    if (file_player)
+    {
+        file_player->setRate(rate);
+    }
+}
+
+void H265Decoder::closeFile()
+{
+    file_player.reset();
+}
+
+void H265Decoder::setEventSink(std::function<void(FlValue *event)> event_sink)
+{
+    this->event_sink = std::make_shared<std::function<void(FlValue *event)>>(std::move(event_sink));
+}
+
+void H265Decoder::postEvent(FlValue *event)
+{
+    struct PendingEvent
+    {
+        std::weak_ptr<std::function<void(FlValue *event)>> sink;
+        FlValue *event;
+    };
+    g_idle_add_full(
+        G_PRIORITY_DEFAULT,
+        +[](gpointer user_data) -> gboolean
+        {
+            PendingEvent *pending = static_cast<PendingEvent *>(user_data);
+            auto sink = pending->sink.lock();
+            if (sink && *sink)
             {
-                // renderer->update_texture_with_frame(texture_name, data.data(), 1920, 1080);
-                // fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
-            });
-        this->ffmpeg_process = std::move(ffmpeg_process);
+                (*sink)(pending->event);
+            }
+            return G_SOURCE_REMOVE;
+        },
+        new PendingEvent{event_sink, event},
+        +[](gpointer user_data)
+        {
+            PendingEvent *pending = static_cast<PendingEvent *>(user_data);
+            fl_value_unref(pending->event);
+            delete pending;
+        });
+}
+
+PacingStats H265Decoder::stats()
+{
+    return pacer.stats();
+}
+
+void H265Decoder::setOutputSize(int width, int height)
+{
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    target_width = width;
+    target_height = height;
+    checkOutputSize();
+}
+
+void H265Decoder::setTimeshift(int64_t duration, size_t capacity)
+{
+    timeshift.configure(duration, capacity);
+}
+
+TimeshiftStats H265Decoder::timeshiftStats()
+{
+    return timeshift.stats();
+}
+
+bool H265Decoder::exportTimeshift(const char *path, int64_t back, TimeshiftExport &info)
+{
+    // Copied out first, so input is not held up by the disk.
+    std::vector<uint8_t> stream;
+    if (!timeshift.copyOut(back, stream, info))
+    {
+        return false;
     }
-    return texture;
+    FILE *file = fopen(path, "wb");
+    if (!file)
+    {
+        fprintf(stderr, "Failed to open %s for the timeshift export\n", path);
+        return false;
+    }
+    bool ok = fwrite(stream.data(), stream.size(), 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "Failed to write the timeshift export to %s\n", path);
+        unlink(path);
+    }
+    return ok;
+}
+
+bool H265Decoder::replayTimeshift(H265Decoder &source, int64_t back, FilePlaybackInfo &info)
+{
+    gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "streamline_renderer", nullptr);
+    g_mkdir_with_parents(cache_dir, 0755);
+    gchar *name = g_strdup_printf("timeshift-%d-%p.h265", (int)getpid(), (void *)this);
+    gchar *path = g_build_filename(cache_dir, name, nullptr);
+    TimeshiftExport exported;
+    const bool ok = source.exportTimeshift(path, back, exported) && openFile(path, exported.fps, info, false);
+    // The player maps the file, so it can go right away.
+    unlink(path);
+    g_free(path);
+    g_free(name);
+    g_free(cache_dir);
+    return ok;
+}
+
+void H265Decoder::setOrientation(int quarter_turns, bool mirror)
+{
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    this->quarter_turns = ((quarter_turns % 4) + 4) % 4;
+    this->mirror = mirror;
+    orientation_applied = true;
+    // The target size is in display orientation.
+    checkOutputSize();
+}
+
+void H265Decoder::setRegionOfInterest(float x, float y, float width, float height, bool upscale)
+{
+    std::lock_guard<std::mutex> lock(region_mutex);
+    if (width <= 0 || height <= 0)
+    {
+        x = y = 0;
+        width = height = 1;
+    }
+    region[0] = std::min(std::max(x, 0.0f), 1.0f);
+    region[1] = std::min(std::max(y, 0.0f), 1.0f);
+    region[2] = std::min(width, 1 - region[0]);
+    region[3] = std::min(height, 1 - region[1]);
+    region_upscale = upscale;
+}
+
+bool H265Decoder::appliesOrientation()
+{
+    return orientation_applied;
+}
+
+bool H265Decoder::decodesHidden()
+{
+    // Analytics still need real frames.
+    return !visible && !frame_tap.config().enabled;
+}
+
+void H265Decoder::decodeSize(int &width, int &height)
+{
+    if (decodesHidden())
+    {
+        width = height = kHiddenDecodeSize;
+        return;
+    }
+    const bool turned = quarter_turns % 2 != 0;
+    coverSize(stream_width, stream_height, turned ? target_height : target_width,
+              turned ? target_width : target_height, width, height);
+}
+
+void H265Decoder::checkOutputSize()
+{
+    int output_width, output_height;
+    decodeSize(output_width, output_height);
+    output_size_pending = output_width != width || output_height != height;
+}
+
+void H265Decoder::startDecoder()
+{
+    int width, height;
+    decodeSize(width, height);
+    const bool hidden = decodesHidden();
+    output_size_pending = false;
+    const size_t frame_size = static_cast<size_t>(width) * height * 4;
+    frame_pool.resize(frame_size);
+
+    // Decode the NALs written to stdin and scale to the expected size, so
+    // every frame read back has exactly the size the reader assumes. The
+    // scaler converts to RGBA in the same pass, so a smaller output size
+    // saves conversion as well as the copy and upload.
+    gchar *command = g_strdup_printf(
+        "ffmpeg -hide_banner -loglevel error -probesize 4K -fflags nobuffer -flags low_delay -f hevc -i pipe:0 -vf scale=%d:%d:flags=area -pix_fmt rgba -f rawvideo pipe:1",
+        width, height);
+    const uint64_t generation = ++decoder_generation;
+    ffmpeg_process = launchFFmpegWithCallback(
+        command,
+        frame_size,
+        thread_run,
+        [this, width, height, generation, hidden](std::vector<uint8_t> &data)
+        {
+            decoder_drain.wait(generation);
+            onFrameDecoded(data, width, height, generation, hidden); });
+    g_free(command);
+    this->width = width;
+    this->height = height;
+}
+
+void H265Decoder::stopDecoder()
+{
+    if (ffmpeg_process.input)
+    {
+        fclose(ffmpeg_process.input);
+        ffmpeg_process.input = nullptr;
+    }
+    // Also stops the reader of a retired decoder, which then exits on its
+    // closed stdout, and lets go any frame held back for it.
+    thread_run = false;
+    decoder_drain.cancel();
+    if (ffmpeg_process.pid > 0)
+    {
+        kill(ffmpeg_process.pid, SIGTERM);
+    }
+    if (ffmpeg_process.thread.joinable())
+    {
+        ffmpeg_process.thread.join();
+    }
+    if (ffmpeg_process.pid > 0)
+    {
+        waitpid(ffmpeg_process.pid, nullptr, 0);
+        ffmpeg_process.pid = -1;
+    }
+    if (drain_thread.joinable())
+    {
+        drain_thread.join();
+    }
+}
+
+void H265Decoder::retireDecoder()
+{
+    // Restarts come at most once per IRAP, so the previous drain is
+    // normally long finished.
+    if (drain_thread.joinable())
+    {
+        drain_thread.join();
+    }
+    if (ffmpeg_process.input)
+    {
+        // Closing stdin makes ffmpeg flush the frames it still holds; the
+        // reader delivers them before it sees the end of the stream.
+        fclose(ffmpeg_process.input);
+        ffmpeg_process.input = nullptr;
+    }
+    decoder_drain.begin(decoder_generation);
+    FFmpegProcess process = std::move(ffmpeg_process);
+    ffmpeg_process = FFmpegProcess{nullptr, {}, -1};
+    drain_thread = std::thread([this, process = std::move(process), generation = decoder_generation]() mutable
+                               {
+        if (process.thread.joinable())
+        {
+            process.thread.join();
+        }
+        if (process.pid > 0)
+        {
+            waitpid(process.pid, nullptr, 0);
+        }
+        // Whatever it has not delivered will not come.
+        reverse_cache.finishDecoder(generation);
+        decoder_drain.finish(generation); });
+}
+
+void H265Decoder::restartDecoder()
+{
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    resetDecoder();
+}
+
+void H265Decoder::resetDecoder()
+{
+    flushDecoder();
+    startDecoder();
+    writeParameterSets();
+}
+
+void H265Decoder::writeParameterSets()
+{
+    if (!ffmpeg_process.input)
+    {
+        return;
+    }
+    for (const std::vector<uint8_t> &parameter_set : parameter_sets)
+    {
+        if (!parameter_set.empty())
+        {
+            fwrite(parameter_set.data(), parameter_set.size(), 1, ffmpeg_process.input);
+        }
+    }
+}
+
+void H265Decoder::flushDecoder()
+{
+    stopDecoder();
+    {
+        std::lock_guard<std::mutex> lock(pts_mutex);
+        pending_pts.clear();
+    }
+    last_pts = -1;
+    std::vector<std::vector<uint8_t>> buffers;
+    reverse_cache.clear(buffers);
+    for (auto &buffer : buffers)
+    {
+        frame_pool.release(std::move(buffer));
+    }
+    pacer.reset();
+    watchdog.onDecoderReset();
+    shedder.onDecoderReset();
+}
+
+void H265Decoder::setFrameTap(const TapConfig &config, bool to_dart)
+{
+    frame_tap.configure(config);
+    {
+        // A hidden session decodes at full size while tapped.
+        std::lock_guard<std::mutex> input_lock(input_mutex);
+        checkOutputSize();
+    }
+    if (to_dart && dart_tap_listener == 0)
+    {
+        dart_tap_listener = frame_tap.addListener([this](const std::shared_ptr<const TapFrame> &frame)
+                                                  {
+            FlValue *event = fl_value_new_map();
+            fl_value_set_string_take(event, "event", fl_value_new_string("tapFrame"));
+            fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+            fl_value_set_string_take(event, "width", fl_value_new_int(frame->width));
+            fl_value_set_string_take(event, "height", fl_value_new_int(frame->height));
+            fl_value_set_string_take(event, "format", fl_value_new_string(frame->format == TAP_FORMAT_GREY ? "grey" : "rgba"));
+            fl_value_set_string_take(event, "pts", fl_value_new_int(frame->pts));
+            fl_value_set_string_take(event, "sequence", fl_value_new_int(frame->sequence));
+            fl_value_set_string_take(event, "data", fl_value_new_uint8_list(frame->data.data(), frame->data.size()));
+            postEvent(event); });
+    }
+    else if (!to_dart && dart_tap_listener != 0)
+    {
+        frame_tap.removeListener(dart_tap_listener);
+        dart_tap_listener = 0;
+    }
+}
+
+void H265Decoder::setOverlay(Overlay overlay)
+{
+    std::lock_guard<std::mutex> lock(overlay_mutex);
+    overlay.id = next_overlay_id++;
+    overlays.push_back(std::make_shared<const Overlay>(std::move(overlay)));
+    while (overlays.size() > kMaxPendingOverlays)
+    {
+        overlays.pop_front();
+    }
+}
+
+std::shared_ptr<const Overlay> H265Decoder::dueOverlay(int64_t pts)
+{
+    // Frames without a timestamp show the newest batch.
+    auto due = [pts](const std::shared_ptr<const Overlay> &overlay)
+    { return pts < 0 || overlay->pts < 0 || overlay->pts <= pts; };
+    std::lock_guard<std::mutex> lock(overlay_mutex);
+    while (overlays.size() > 1 && due(overlays[1]))
+    {
+        overlays.pop_front();
+    }
+    if (overlays.empty() || !due(overlays.front()))
+    {
+        return nullptr;
+    }
+    return overlays.front();
+}
+
+void H265Decoder::snapshot(SnapshotCallback done)
+{
+    upload_thread->post([this, done]()
+                        {
+        SwapChainBuffer buffer;
+        if (!renderer || !swap_chain->newest(buffer))
+        {
+            std::vector<uint8_t> none;
+            done(none, 0, 0);
+            return;
+        }
+        // Only the renderer is kept by the follow-up tasks, so they may
+        // outlive the session.
+        finishSnapshot(upload_thread, renderer, renderer->startReadback(buffer.name, buffer.width, buffer.height),
+                       done); });
+}
+
+int64_t H265Decoder::addOutput(int width, int height, OutputFormat format)
+{
+    Output output;
+    output.swap_chain = new TextureSwapChain();
+    output.texture = FL_TEXTURE(fl_my_texture_gl_new(GL_TEXTURE_2D, output.swap_chain));
+    output.width = width;
+    output.height = height;
+    output.format = format;
+    // Blank until the session's next frame.
+    upload_thread->invoke([this, &output]()
+                          { output.swap_chain->publishPlaceholder(*renderer); });
+    fl_texture_registrar_register_texture(texture_registrar, output.texture);
+    std::lock_guard<std::mutex> lock(outputs_mutex);
+    outputs.push_back(output);
+    return reinterpret_cast<int64_t>(output.texture);
+}
+
+bool H265Decoder::removeOutput(int64_t id)
+{
+    Output output;
+    {
+        std::lock_guard<std::mutex> lock(outputs_mutex);
+        auto it = std::find_if(outputs.begin(), outputs.end(), [id](const Output &output)
+                               { return reinterpret_cast<int64_t>(output.texture) == id; });
+        if (it == outputs.end())
+        {
+            return false;
+        }
+        output = *it;
+        outputs.erase(it);
+    }
+    fl_texture_registrar_unregister_texture(texture_registrar, output.texture);
+    upload_thread->invoke([&output]()
+                          {
+        std::vector<GLuint> names = output.swap_chain->names();
+        glDeleteTextures(names.size(), names.data()); });
+    g_object_unref(output.texture);
+    return true;
+}
+
+void H265Decoder::setFrameListener(std::function<void()> listener)
+{
+    upload_thread->invoke([this, &listener]()
+                          { frame_listener = std::move(listener); });
+}
+
+void H265Decoder::setVisible(bool visible)
+{
+    this->visible = visible;
+    updateFrameClock();
+    // Hiding shrinks the decoder output from the next IRAP, and showing
+    // restores it the same way.
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    checkOutputSize();
+}
+
+void H265Decoder::setSuspended(bool suspended)
+{
+    std::lock_guard<std::mutex> input_lock(input_mutex);
+    if (suspended == this->suspended)
+    {
+        return;
+    }
+    this->suspended = suspended;
+    updateFrameClock();
+    if (!suspended)
+    {
+        resetDecoder();
+        wait_for_irap = true;
+        return;
+    }
+
+    flushDecoder();
+    {
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        upload_frame = DecodedFrame();
+    }
+    frame_pool.clear();
+    // Runs after any upload already queued for this decoder. The textures
+    // stay registered, so each chain is left with a blank placeholder.
+    upload_thread->post([this]()
+                        {
+        std::vector<GLuint> names = swap_chain->clear();
+        swap_chain->publishPlaceholder(*renderer);
+        fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
+        std::lock_guard<std::mutex> lock(outputs_mutex);
+        for (const Output &output : outputs)
+        {
+            std::vector<GLuint> output_names = output.swap_chain->clear();
+            names.insert(names.end(), output_names.begin(), output_names.end());
+            output.swap_chain->publishPlaceholder(*renderer);
+            fl_texture_registrar_mark_texture_frame_available(texture_registrar, output.texture);
+        }
+        glDeleteTextures(names.size(), names.data());
+        glDeleteTextures(1, &staging_texture);
+        staging_texture = 0; });
 }
 
-void H265Decoder::addH265Nal(const uint8_t *nal, const size_t size)
+void H265Decoder::updateFrameClock()
 {
-    fwrite(nal, size, 1, ffmpeg_process.input);
-}
\ No newline at end of file
+    const bool run = visible && !suspended;
+    if (frame_clock == nullptr || run == frame_clock_running)
+    {
+        return;
+    }
+    frame_clock_running = run;
+    if (run)
+    {
+        gdk_frame_clock_begin_updating(frame_clock);
+    }
+    else
+    {
+        gdk_frame_clock_end_updating(frame_clock);
+    }
+}
+
+void H265Decoder::onFrameDecoded(std::vector<uint8_t> &data, int width, int height, uint64_t decoder, bool hidden)
+{
+    DecodedFrame frame;
+    frame.data = std::move(data);
+    frame.width = width;
+    frame.height = height;
+    frame.decoded_time = g_get_monotonic_time();
+    data = frame_pool.acquire();
+    watchdog.onFrameDecoded();
+    shedder.onFrameDecoded(frame.decoded_time);
+    if (reverse_cache.take(decoder, frame))
+    {
+        if (!frame.data.empty())
+        {
+            frame_pool.release(std::move(frame.data));
+        }
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pts_mutex);
+        if (!pending_pts.empty())
+        {
+            frame.pts = *pending_pts.begin();
+            pending_pts.erase(pending_pts.begin());
+        }
+    }
+    // Frames decoded while hidden are never shown, even once the session is
+    // visible again and until its decoder is back at full size.
+    if (!hidden)
+    {
+        frame_tap.onFrameDecoded(frame.data.data(), width, height, frame.pts, frame.decoded_time);
+    }
+    if (!visible || hidden)
+    {
+        frame_pool.release(std::move(frame.data));
+        return;
+    }
+    pacer.push(std::move(frame), g_get_monotonic_time());
+}
+
+void H265Decoder::presentDueFrame(GdkFrameClock *clock)
+{
+    // Pick the frame for when this refresh reaches the screen rather than
+    // for when the update phase happens to run.
+    gint64 refresh_interval = 0;
+    gint64 presentation_time = 0;
+    const gint64 frame_time = gdk_frame_clock_get_frame_time(clock);
+    gdk_frame_clock_get_refresh_info(clock, frame_time, &refresh_interval, &presentation_time);
+    const int64_t display_time = presentation_time != 0 ? presentation_time : frame_time + refresh_interval;
+
+    // Reverse playback decodes whole groups ahead; they are released to the
+    // pacer a few frames at a time, as its queue is bounded.
+    DecodedFrame frame;
+    while (pacer.stats().queued_frames < kReverseQueuedFrames && reverse_cache.pop(frame))
+    {
+        frame.decoded_time = g_get_monotonic_time();
+        pacer.push(std::move(frame), frame.decoded_time);
+    }
+
+    if (!pacer.pop(display_time, frame))
+    {
+        return;
+    }
+
+    // Frames are cropped and turned upright as they are uploaded.
+    FrameLayout layout;
+    layoutFrame(frame.width, frame.height, layout);
+    const int display_width = layout.width;
+    const int display_height = layout.height;
+    if (display_width != presented_width || display_height != presented_height)
+    {
+        presented_width = display_width;
+        presented_height = display_height;
+        if (event_sink && *event_sink)
+        {
+            g_autoptr(FlValue) event = fl_value_new_map();
+            fl_value_set_string_take(event, "event", fl_value_new_string("resolutionChanged"));
+            fl_value_set_string_take(event, "textureId", fl_value_new_int(reinterpret_cast<int64_t>(texture)));
+            fl_value_set_string_take(event, "width", fl_value_new_int(display_width));
+            fl_value_set_string_take(event, "height", fl_value_new_int(display_height));
+            (*event_sink)(event);
+        }
+    }
+
+    // If the previous upload has not started yet, replace its frame instead
+    // of queueing a second one.
+    std::lock_guard<std::mutex> lock(upload_mutex);
+    upload_frame = std::move(frame);
+    if (upload_pending)
+    {
+        return;
+    }
+    upload_pending = true;
+    upload_thread->post([this]()
+                        { uploadPendingFrame(); });
+}
+
+void H265Decoder::uploadPendingFrame()
+{
+    DecodedFrame frame;
+    {
+        std::lock_guard<std::mutex> lock(upload_mutex);
+        frame = std::move(upload_frame);
+        upload_pending = false;
+    }
+    if (frame.data.empty())
+    {
+        // Dropped by a suspend.
+        return;
+    }
+
+    FrameLayout layout;
+    layoutFrame(frame.width, frame.height, layout);
+    SourceTransform transform;
+    transform.quarter_turns = layout.quarter_turns;
+    transform.mirror = layout.mirror;
+    const int width = layout.width;
+    const int height = layout.height;
+    const int index = acquireBuffer(swap_chain, width, height);
+    const GLuint name = swap_chain->buffer(index).name;
+    // Only the region of interest leaves the frame buffer.
+    const size_t stride = static_cast<size_t>(frame.width) * 4;
+    const uint8_t *region_data = frame.data.data() + layout.crop_y * stride + layout.crop_x * 4;
+    if (transform.quarter_turns == 0 && !transform.mirror &&
+        width == layout.crop_width && height == layout.crop_height)
+    {
+        renderer->update_texture_with_frame(name, region_data, width, height, stride);
+    }
+    else
+    {
+        // Uploaded as decoded, then turned upright and scaled on the GPU
+        // while being copied into the buffer Flutter samples.
+        if (staging_texture == 0 || staging_width != layout.crop_width || staging_height != layout.crop_height)
+        {
+            glDeleteTextures(1, &staging_texture);
+            staging_texture = renderer->genTexture(layout.crop_width, layout.crop_height);
+            staging_width = layout.crop_width;
+            staging_height = layout.crop_height;
+        }
+        renderer->update_texture_with_frame(staging_texture, region_data, layout.crop_width, layout.crop_height, stride);
+        renderer->drawTexture(staging_texture, layout.crop_width, layout.crop_height,
+                              name, 0, 0, width, height, false, transform);
+    }
+    frame_pool.release(std::move(frame.data));
+
+    {
+        std::lock_guard<std::mutex> lock(outputs_mutex);
+        for (const Output &output : outputs)
+        {
+            int output_width, output_height;
+            fitSize(width, height, output.width, output.height, output_width, output_height);
+            const int output_index = acquireBuffer(output.swap_chain, output_width, output_height);
+            renderer->drawTexture(name, width, height, output.swap_chain->buffer(output_index).name,
+                                  0, 0, output_width, output_height, output.format == OUTPUT_FORMAT_GREY);
+            output.swap_chain->publish(output_index);
+            fl_texture_registrar_mark_texture_frame_available(texture_registrar, output.texture);
+        }
+    }
+
+    // Drawn after the outputs, which show the plain video.
+    std::shared_ptr<const Overlay> overlay = dueOverlay(frame.pts);
+    if (overlay && (!overlay->rects.empty() || !overlay->labels.empty()))
+    {
+        renderer->drawOverlay(*overlay, name, width, height);
+    }
+
+    swap_chain->publish(index);
+    if (frame_listener)
+    {
+        frame_listener();
+        return;
+    }
+    // The texture registrar is safe to signal from any thread.
+    fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
+}
+
+void H265Decoder::layoutFrame(int frame_width, int frame_height, FrameLayout &layout)
+{
+    float display[4];
+    bool upscale;
+    {
+        std::lock_guard<std::mutex> lock(region_mutex);
+        std::copy(region, region + 4, display);
+        upscale = region_upscale;
+    }
+    layout.quarter_turns = quarter_turns;
+    layout.mirror = mirror;
+    float source[4];
+    sourceRegion(layout.quarter_turns, layout.mirror, display, source);
+
+    // Whole pixels covering the region, at least one.
+    layout.crop_x = std::min(static_cast<int>(std::floor(source[0] * frame_width)), frame_width - 1);
+    layout.crop_y = std::min(static_cast<int>(std::floor(source[1] * frame_height)), frame_height - 1);
+    layout.crop_width = std::max(1, std::min(static_cast<int>(std::ceil((source[0] + source[2]) * frame_width)),
+                                             frame_width) -
+                                        layout.crop_x);
+    layout.crop_height = std::max(1, std::min(static_cast<int>(std::ceil((source[1] + source[3]) * frame_height)),
+                                              frame_height) -
+                                         layout.crop_y);
+
+    const int width = upscale ? frame_width : layout.crop_width;
+    const int height = upscale ? frame_height : layout.crop_height;
+    const bool turned = layout.quarter_turns % 2 != 0;
+    layout.width = turned ? height : width;
+    layout.height = turned ? width : height;
+}
+
+int H265Decoder::acquireBuffer(TextureSwapChain *chain, int width, int height)
+{
+    const int index = chain->acquire();
+    SwapChainBuffer buffer = chain->buffer(index);
+    if (buffer.name == 0 || buffer.width != width || buffer.height != height)
+    {
+        // Storage is immutable, so a buffer of the wrong size is replaced.
+        if (buffer.name != 0)
+        {
+            glDeleteTextures(1, &buffer.name);
+        }
+        buffer.name = renderer->genTexture(width, height);
+        chain->setBuffer(index, buffer.name, width, height);
+    }
+    return index;
+}
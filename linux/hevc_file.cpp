@@ -0,0 +1,238 @@
+#include "include/renderer/hevc_file.h"
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    const char kIndexMagic[4] = {'H', 'I', 'D', 'X'};
+    const uint32_t kIndexVersion = 1;
+
+    struct IndexHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t file_size;
+        int64_t file_mtime;
+        uint64_t count;
+    };
+
+    // Non-VCL NAL units that can only appear at the start of an access
+    // unit (section 7.4.2.4.4): AUD, VPS, SPS, PPS, prefix SEI and the
+    // reserved or unspecified types in 41..44 and 48..55.
+    bool startsAccessUnit(int type)
+    {
+        return (type >= HEVC_NAL_VPS && type <= HEVC_NAL_AUD) || type == HEVC_NAL_SEI_PREFIX ||
+               (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+    }
+}
+
+HevcFile::~HevcFile()
+{
+    close();
+}
+
+bool HevcFile::open(const char *path, const std::string &cache_dir)
+{
+    close();
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        perror("Failed to open H.265 file");
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    size = st.st_size;
+    mtime = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    void *address = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED)
+    {
+        perror("Failed to map H.265 file");
+        size = 0;
+        return false;
+    }
+    mapping = static_cast<uint8_t *>(address);
+
+    std::string index_path;
+    if (!cache_dir.empty())
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016zx.hidx", std::hash<std::string>()(path));
+        index_path = cache_dir + "/" + name;
+    }
+    if (index_path.empty() || !loadIndex(index_path))
+    {
+        buildIndex();
+        if (!index_path.empty())
+        {
+            saveIndex(index_path);
+        }
+    }
+    return !access_units.empty();
+}
+
+void HevcFile::close()
+{
+    if (mapping)
+    {
+        munmap(mapping, size);
+        mapping = nullptr;
+    }
+    size = 0;
+    access_units.clear();
+    keyframes = 0;
+}
+
+void HevcFile::buildIndex()
+{
+    access_units.clear();
+    keyframes = 0;
+    uint32_t irap = kNoIrap;
+    bool has_vcl = false;
+    // Start of the prefix NAL units that will belong to the next picture.
+    int64_t pending_start = -1;
+    const uint8_t *previous_end = mapping;
+
+    hevcForEachNal(mapping, size, [&](const uint8_t *nal, size_t nal_size)
+                   {
+        // Back up over the start code, including a leading zero_byte.
+        const uint8_t *start = nal;
+        while (start > previous_end && start[-1] == 0)
+        {
+            start--;
+        }
+        if (start > previous_end && start[-1] == 1)
+        {
+            start--;
+            while (start > previous_end && start[-1] == 0)
+            {
+                start--;
+            }
+        }
+        previous_end = nal + nal_size;
+        const uint64_t offset = start - mapping;
+
+        const int type = hevcNalType(nal);
+        if (startsAccessUnit(type))
+        {
+            if (pending_start < 0)
+            {
+                pending_start = offset;
+            }
+            return;
+        }
+        if (!hevcIsFirstSliceSegment(nal, nal_size))
+        {
+            // Suffix SEI, EOS, filler and the remaining slices of a picture.
+            return;
+        }
+
+        HevcAccessUnit unit{};
+        unit.offset = pending_start >= 0 ? pending_start : offset;
+        unit.type = type;
+        unit.temporal_id = hevcTemporalId(nal);
+        pending_start = -1;
+        if (hevcIsIrap(type))
+        {
+            irap = access_units.size();
+            keyframes++;
+        }
+        unit.irap = irap;
+        if (!access_units.empty())
+        {
+            HevcAccessUnit &last = access_units.back();
+            last.size = unit.offset - last.offset;
+        }
+        access_units.push_back(unit);
+        has_vcl = true; });
+
+    if (has_vcl)
+    {
+        HevcAccessUnit &last = access_units.back();
+        last.size = size - last.offset;
+    }
+}
+
+bool HevcFile::loadIndex(const std::string &index_path)
+{
+    FILE *file = fopen(index_path.c_str(), "rb");
+    if (!file)
+    {
+        return false;
+    }
+    // Nothing read from the cache is trusted: the count has to fit the
+    // index file, and every unit the file and its own IRAP.
+    struct stat info;
+    IndexHeader header;
+    bool ok = fstat(fileno(file), &info) == 0 && fread(&header, sizeof(header), 1, file) == 1 &&
+              memcmp(header.magic, kIndexMagic, 4) == 0 && header.version == kIndexVersion &&
+              header.file_size == size && header.file_mtime == mtime &&
+              header.count <= (uint64_t(info.st_size) - sizeof(header)) / sizeof(HevcAccessUnit);
+    if (ok)
+    {
+        access_units.resize(header.count);
+        ok = fread(access_units.data(), sizeof(HevcAccessUnit), header.count, file) == header.count;
+    }
+    fclose(file);
+
+    keyframes = 0;
+    for (size_t i = 0; ok && i < access_units.size(); i++)
+    {
+        const HevcAccessUnit &unit = access_units[i];
+        if (unit.offset > size || unit.size > size - unit.offset)
+        {
+            ok = false;
+        }
+        else if (unit.irap != kNoIrap && (unit.irap > i || access_units[unit.irap].irap != unit.irap))
+        {
+            ok = false;
+        }
+        else if (unit.irap == i)
+        {
+            keyframes++;
+        }
+    }
+    if (!ok)
+    {
+        access_units.clear();
+    }
+    return ok;
+}
+
+void HevcFile::saveIndex(const std::string &index_path)
+{
+    // Written under a temporary name so a reader never sees half an index.
+    const std::string temporary_path = index_path + ".tmp";
+    FILE *file = fopen(temporary_path.c_str(), "wb");
+    if (!file)
+    {
+        return;
+    }
+    IndexHeader header;
+    memcpy(header.magic, kIndexMagic, 4);
+    header.version = kIndexVersion;
+    header.file_size = size;
+    header.file_mtime = mtime;
+    header.count = access_units.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(access_units.data(), sizeof(HevcAccessUnit), access_units.size(), file) == access_units.size();
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary_path.c_str(), index_path.c_str()) != 0)
+    {
+        unlink(temporary_path.c_str());
+    }
+}
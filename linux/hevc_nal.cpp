@@ -0,0 +1,206 @@
+#include "include/renderer/hevc_nal.h"
+
+#include <vector>
+
+namespace
+{
+    // Reads an RBSP, skipping emulation prevention bytes on the fly.
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+        uint32_t bits(int count)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < count; i++)
+            {
+                value = (value << 1) | bit();
+            }
+            return value;
+        }
+
+        void skip(int count)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                bit();
+            }
+        }
+
+        uint32_t ue()
+        {
+            int leading_zeros = 0;
+            while (!overrun && bit() == 0)
+            {
+                // No syntax element needs more than 32 bits.
+                if (++leading_zeros > 31)
+                {
+                    overrun = true;
+                    return 0;
+                }
+            }
+            return ((1u << leading_zeros) - 1) + bits(leading_zeros);
+        }
+
+        bool ok() const { return !overrun; }
+
+    private:
+        uint32_t bit()
+        {
+            if (bit_offset == 0)
+            {
+                // 0x000003 is an emulation prevention sequence; drop the 03.
+                if (byte_offset >= 2 && byte_offset < size && data[byte_offset] == 0x03 &&
+                    data[byte_offset - 1] == 0 && data[byte_offset - 2] == 0 && !skipped)
+                {
+                    byte_offset++;
+                    skipped = true;
+                }
+                else
+                {
+                    skipped = false;
+                }
+            }
+            if (byte_offset >= size)
+            {
+                overrun = true;
+                return 0;
+            }
+            uint32_t value = (data[byte_offset] >> (7 - bit_offset)) & 1;
+            if (++bit_offset == 8)
+            {
+                bit_offset = 0;
+                byte_offset++;
+            }
+            return value;
+        }
+
+        const uint8_t *data;
+        size_t size;
+        size_t byte_offset = 0;
+        int bit_offset = 0;
+        bool skipped = false;
+        bool overrun = false;
+    };
+
+    // profile_tier_level() of section 7.3.3 with profilePresentFlag set.
+    void skipProfileTierLevel(BitReader &reader, int max_sub_layers_minus1)
+    {
+        // general profile space, tier, idc, compatibility flags, constraint
+        // flags and level: 2 + 1 + 5 + 32 + 48 + 8 bits.
+        reader.skip(96);
+
+        std::vector<bool> profile_present(max_sub_layers_minus1);
+        std::vector<bool> level_present(max_sub_layers_minus1);
+        for (int i = 0; i < max_sub_layers_minus1; i++)
+        {
+            profile_present[i] = reader.bits(1);
+            level_present[i] = reader.bits(1);
+        }
+        if (max_sub_layers_minus1 > 0)
+        {
+            for (int i = max_sub_layers_minus1; i < 8; i++)
+            {
+                reader.skip(2);
+            }
+        }
+        for (int i = 0; i < max_sub_layers_minus1; i++)
+        {
+            if (profile_present[i])
+            {
+                reader.skip(88);
+            }
+            if (level_present[i])
+            {
+                reader.skip(8);
+            }
+        }
+    }
+
+    size_t startCodeAt(const uint8_t *data, size_t size, size_t i)
+    {
+        if (i + 3 <= size && data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1)
+        {
+            return 3;
+        }
+        return 0;
+    }
+}
+
+void hevcForEachNal(const uint8_t *data, size_t size,
+                    const std::function<void(const uint8_t *nal, size_t size)> &f)
+{
+    size_t i = 0;
+    while (i < size && startCodeAt(data, size, i) == 0)
+    {
+        i++;
+    }
+    if (i == size)
+    {
+        if (size > 0)
+        {
+            f(data, size);
+        }
+        return;
+    }
+
+    while (i < size)
+    {
+        const size_t begin = i + startCodeAt(data, size, i);
+        size_t end = begin;
+        while (end < size && startCodeAt(data, size, end) == 0)
+        {
+            end++;
+        }
+        i = end;
+        // Zero bytes before the next start code belong to it (or are trailing_zero_8bits).
+        while (end > begin && data[end - 1] == 0)
+        {
+            end--;
+        }
+        if (end - begin >= 2)
+        {
+            f(data + begin, end - begin);
+        }
+    }
+}
+
+bool hevcParseSps(const uint8_t *nal, size_t size, HevcSps &sps)
+{
+    if (size < 3 || hevcNalType(nal) != HEVC_NAL_SPS)
+    {
+        return false;
+    }
+
+    BitReader reader(nal + 2, size - 2);
+    reader.skip(4); // sps_video_parameter_set_id
+    const int max_sub_layers_minus1 = reader.bits(3);
+    reader.skip(1); // sps_temporal_id_nesting_flag
+    skipProfileTierLevel(reader, max_sub_layers_minus1);
+    reader.ue(); // sps_seq_parameter_set_id
+
+    sps.chroma_format_idc = reader.ue();
+    if (sps.chroma_format_idc == 3)
+    {
+        reader.skip(1); // separate_colour_plane_flag
+    }
+    sps.pic_width = reader.ue();
+    sps.pic_height = reader.ue();
+
+    sps.crop_left = sps.crop_right = sps.crop_top = sps.crop_bottom = 0;
+    if (reader.bits(1))
+    {
+        // Offsets are in chroma sample units (table 6-1).
+        const int sub_width = sps.chroma_format_idc == 1 || sps.chroma_format_idc == 2 ? 2 : 1;
+        const int sub_height = sps.chroma_format_idc == 1 ? 2 : 1;
+        sps.crop_left = reader.ue() * sub_width;
+        sps.crop_right = reader.ue() * sub_width;
+        sps.crop_top = reader.ue() * sub_height;
+        sps.crop_bottom = reader.ue() * sub_height;
+    }
+
+    sps.width = sps.pic_width - sps.crop_left - sps.crop_right;
+    sps.height = sps.pic_height - sps.crop_top - sps.crop_bottom;
+    return reader.ok() && sps.width > 0 && sps.height > 0;
+}
@@ -0,0 +1,33 @@
+#ifndef DECODER_DRAIN_H
+#define DECODER_DRAIN_H
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Keeps the frames of decoders that replace each other in order. A decoder
+// retired with frames still inside delivers all of them before any frame
+// of a later decoder goes through; its own reader and those of decoders
+// before it never wait. Decoders are identified by their generation,
+// counting up from 1. One decoder drains at a time.
+class DecoderDrain
+{
+public:
+    // Marks decoder, just retired, as draining. The previous drain must
+    // have finished.
+    void begin(uint64_t decoder);
+    // Called once decoder has delivered its last frame.
+    void finish(uint64_t decoder);
+    // Holds a frame of decoder until every earlier decoder has drained.
+    // Reader threads only.
+    void wait(uint64_t decoder);
+    // Lets every held frame go, when the decoders are being stopped.
+    void cancel();
+
+private:
+    std::mutex mutex;
+    std::condition_variable condition;
+    // The decoder still delivering its frames, or 0.
+    uint64_t draining = 0;
+};
+
+#endif // DECODER_DRAIN_H
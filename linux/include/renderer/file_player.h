@@ -0,0 +1,133 @@
+#ifndef FILE_PLAYER_H
+#define FILE_PLAYER_H
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hevc_file.h"
+
+struct FilePlaybackInfo
+{
+    int64_t frames = 0;
+    int64_t keyframes = 0;
+    // Microseconds.
+    int64_t duration = 0;
+};
+
+struct FilePlayerCallbacks
+{
+    // Receives access units straight from the file mapping. Those of a
+    // reverse group are untimed (pts -1).
+    std::function<void(const uint8_t *data, size_t size, int64_t pts)> nal;
+    // Announces that the next count decoded frames form a reverse group; see
+    // ReverseGopCache. arrival is the monotonic time first_pts would have
+    // arrived at if it had been fed at its due time.
+    std::function<void(size_t count, size_t stride, int64_t first_pts, int64_t span, int64_t arrival)> reverse_group;
+    // Every access unit of the reverse group announced last has been passed
+    // to nal.
+    std::function<void()> reverse_group_fed;
+    // Asks for the decoder to drop everything in flight and start over, e.g.
+    // after a seek. Parameter sets already seen must be kept.
+    std::function<void()> discontinuity;
+    // Playback reached the end, or the start when playing backwards.
+    std::function<void()> ended;
+};
+
+// Plays an H.265 Annex-B file at a fixed frame rate, passing each access
+// unit to a callback straight from the file mapping. Timestamps keep
+// running across seeks and rate changes, so the pacing clock never sees
+// them go backwards.
+//
+// Away from normal speed only as many pictures are decoded as are shown:
+// fast-forward drops the highest temporal sub-layers, then sub-layer
+// non-reference pictures, and finally everything but IRAPs. Reverse
+// playback decodes a group of pictures at a time, thinned the same way,
+// and shows it back to front.
+class FilePlayer
+{
+public:
+    explicit FilePlayer(FilePlayerCallbacks callbacks);
+    ~FilePlayer();
+
+    // Opens path and starts playing it from the beginning.
+    bool open(const char *path, double fps, const std::string &cache_dir);
+    FilePlaybackInfo info();
+    // Continues from the keyframe at or before position, in microseconds
+    // from the start of the file, and returns that keyframe's position.
+    // When playing backwards, continues from position itself.
+    int64_t seek(int64_t position);
+    // Sets the playback rate: 1 is normal speed, negative plays backwards
+    // and 0 pauses.
+    void setRate(double rate);
+
+private:
+    // A subset of pictures that can be decoded on its own.
+    struct Tier
+    {
+        // Highest TemporalId kept, or -1 for IRAPs only.
+        int max_temporal_id;
+        // Whether sub-layer non-reference pictures at max_temporal_id go.
+        bool drop_non_reference;
+        // Share of all access units kept.
+        double fraction;
+    };
+
+    void run();
+    void stop();
+    void buildTiers();
+    size_t tierForRate(double rate) const;
+    bool keep(const HevcAccessUnit &unit, const Tier &tier) const;
+    bool stepForward(std::unique_lock<std::mutex> &lock);
+    bool stepReverse(std::unique_lock<std::mutex> &lock);
+    bool stepKeyframes(std::unique_lock<std::mutex> &lock);
+    void reportEnd(std::unique_lock<std::mutex> &lock);
+    void jumpTo(int64_t position);
+    int64_t clockNow() const;
+    int64_t dueTime(int64_t pts) const;
+    int64_t mediaPosition() const;
+    int64_t ptsFor(int64_t media) const;
+    void sendEndOfSequence();
+
+    FilePlayerCallbacks callbacks;
+    HevcFile file;
+    int64_t frame_duration = 0;
+    std::vector<Tier> tiers;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool running = false;
+    bool ended_reported = false;
+    double rate = 1.0;
+    bool paused = false;
+    size_t tier = 0;
+    // Tier to switch to at the next IRAP, when more pictures are wanted
+    // than the decoder has references for.
+    size_t pending_tier = 0;
+    // Going forwards, the next access unit to feed; backwards, the end of
+    // the next group to feed.
+    size_t next = 0;
+    // Set after a jump so the RASL pictures of the IRAP fed first, which
+    // reference pictures that were never decoded, are left out.
+    bool skip_rasl = false;
+    // Whether the decoder has seen a picture since it was last restarted.
+    bool decoder_started = false;
+    bool restart_pending = false;
+    uint32_t last_keyframe = HevcFile::kNoIrap;
+
+    // The feed clock: pts is due at wall_base + pts - stream_base.
+    int64_t wall_base = 0;
+    int64_t stream_base = 0;
+    // Next timestamp free to use.
+    int64_t stream_time = 0;
+    // The playhead was at media_anchor (microseconds into the file) at
+    // stream_anchor and moves at rate from there.
+    int64_t media_anchor = 0;
+    int64_t stream_anchor = 0;
+};
+
+#endif // FILE_PLAYER_H
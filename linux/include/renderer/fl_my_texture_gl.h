@@ -4,6 +4,8 @@
 #include <glib-object.h>
 #include <flutter_linux/flutter_linux.h>
 
+class TextureSwapChain;
+
 G_DECLARE_FINAL_TYPE(FlMyTextureGL,
                      fl_my_texture_gl,
                      FL,
@@ -14,13 +16,10 @@ struct _FlMyTextureGL
 {
     FlTextureGL parent_instance;
     uint32_t target;
-    uint32_t name;
-    uint32_t width;
-    uint32_t height;
+    // Owned by the texture; populate samples its newest completed buffer.
+    TextureSwapChain *swap_chain;
 };
 
 FlMyTextureGL *fl_my_texture_gl_new(uint32_t target,
-                                    uint32_t name,
-                                    uint32_t width,
-                                    uint32_t height);
-#endif // FLUTTER_SHELL_PLATFORM_LINUX_CUSTOM_TEXTURE_CLASS_H_
\ No newline at end of file
+                                    TextureSwapChain *swap_chain);
+#endif // FLUTTER_SHELL_PLATFORM_LINUX_CUSTOM_TEXTURE_CLASS_H_
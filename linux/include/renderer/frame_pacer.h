@@ -0,0 +1,81 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct DecodedFrame
+{
+    std::vector<uint8_t> data;
+    int width = 0;
+    int height = 0;
+    // Presentation timestamp in microseconds, -1 for untimed streams.
+    int64_t pts = -1;
+    // When the frame left the decoder, on the monotonic clock.
+    int64_t decoded_time = 0;
+};
+
+struct PacingStats
+{
+    uint64_t frames_presented = 0;
+    uint64_t frames_dropped = 0;
+    size_t queued_frames = 0;
+    // All durations are in microseconds.
+    int64_t playout_delay = 0;
+    int64_t jitter = 0;
+    int64_t latency = 0;
+    int64_t pacing_error = 0;
+};
+
+// Maps stream presentation timestamps onto the local monotonic clock and
+// decides which decoded frame should be on screen at a given time.
+//
+// The pts-to-local offset follows the fastest recent arrival, and the
+// playout delay on top of it adapts to the measured interarrival jitter
+// and to how long frames take to come out of the decoder. All times are
+// in microseconds on the g_get_monotonic_time() clock.
+class FramePacer
+{
+public:
+    // Called when a timestamped access unit is handed to the decoder.
+    void onArrival(int64_t pts, int64_t now);
+
+    // Called from the decoder thread for every decoded frame.
+    void push(DecodedFrame frame, int64_t now);
+
+    // Takes the newest frame that is due at `now`, dropping older due ones.
+    bool pop(int64_t now, DecodedFrame &frame);
+
+    // Decode time of the oldest queued frame, or -1 if none is queued.
+    int64_t oldestFrameTime();
+
+    // Forgets all queued frames and restarts the clock, e.g. on a new stream.
+    void reset();
+
+    PacingStats stats();
+
+private:
+    int64_t dueTime(int64_t pts) const;
+    void adaptDelay();
+
+    std::mutex mutex;
+    std::deque<DecodedFrame> frames;
+
+    bool clock_valid = false;
+    int64_t offset = 0;
+    int64_t window_min = 0;
+    int64_t previous_window_min = 0;
+    int window_count = 0;
+    int64_t last_arrival_pts = 0;
+    int64_t last_arrival_time = 0;
+    int64_t jitter = 0;
+    int64_t decode_margin = 0;
+    int64_t playout_delay = 0;
+
+    int64_t last_presented_pts = -1;
+    int64_t last_presented_time = 0;
+    PacingStats counters;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,29 @@
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Recycles decoded frame buffers between the decoder reader thread and the
+// upload thread, so steady-state decoding does not allocate.
+class FramePool
+{
+public:
+    // Returns a buffer of the current frame size, reusing a released one
+    // when possible.
+    std::vector<uint8_t> acquire();
+    void release(std::vector<uint8_t> buffer);
+    // Changes the frame size; pooled buffers of the old size are freed.
+    void resize(size_t frame_size);
+    // Frees the pooled buffers.
+    void clear();
+
+private:
+    static const size_t kMaxPooledFrames = 4;
+
+    std::mutex mutex;
+    std::vector<std::vector<uint8_t>> buffers;
+    size_t frame_size = 0;
+};
+
+#endif // FRAME_POOL_H
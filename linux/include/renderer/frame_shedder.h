@@ -0,0 +1,74 @@
+#ifndef FRAME_SHEDDER_H
+#define FRAME_SHEDDER_H
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+struct SheddingStats
+{
+    // 0 when nothing is shed.
+    int level = 0;
+    // Highest TemporalId still decoded, and whether its sub-layer
+    // non-reference pictures are dropped as well.
+    int max_temporal_id = 0;
+    bool drop_non_reference = false;
+    uint64_t pictures_shed = 0;
+    size_t queued_pictures = 0;
+    // Smoothed time from a picture entering the decoder to its frame
+    // coming out, in microseconds.
+    int64_t decode_time = 0;
+};
+
+// Sheds pictures that nothing references before they reach an overloaded
+// decoder, so playback degrades to a lower frame rate instead of falling
+// behind. Each level drops more: first the sub-layer non-reference
+// pictures of the highest temporal sub-layer, then that whole sub-layer,
+// then the non-reference pictures of the next one, and so on. Levels go
+// up as soon as the decoder queue or decode time crosses its threshold,
+// and come down after a quiet period, at the next IRAP, since the
+// pictures that come back may reference ones that were dropped.
+class FrameShedder
+{
+public:
+    typedef std::function<void(const SheddingStats &stats)> LevelCallback;
+
+    void configure(bool enabled, size_t max_queued_pictures, int64_t max_decode_time);
+    // Called, without locks held, whenever the level in effect changes.
+    void setLevelCallback(LevelCallback callback);
+
+    // Decides whether a picture, by the type and TemporalId of its first
+    // slice, may go to the decoder.
+    bool admit(int type, int temporal_id, int64_t now);
+    void onPicturesQueued(int count, int64_t now);
+    void onFrameDecoded(int64_t now);
+    // Forgets the pictures queued in a decoder that was restarted.
+    void onDecoderReset();
+
+    SheddingStats stats();
+
+private:
+    // Returns true if the level in effect changed.
+    bool evaluate(int64_t now);
+    SheddingStats snapshot() const;
+
+    std::mutex mutex;
+    LevelCallback callback;
+    bool enabled = true;
+    size_t max_queued_pictures = 6;
+    int64_t max_decode_time = 150000;
+
+    int max_temporal_id_seen = 0;
+    // Level in effect, and the one it returns to at the next IRAP.
+    int level = 0;
+    int target_level = 0;
+    int64_t last_change = 0;
+    int64_t last_overload = 0;
+    // Arrival times of the pictures queued in the decoder, oldest first.
+    std::deque<int64_t> in_flight;
+    int64_t decode_time = 0;
+    uint64_t pictures_shed = 0;
+};
+
+#endif // FRAME_SHEDDER_H
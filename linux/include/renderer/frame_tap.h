@@ -0,0 +1,80 @@
+#ifndef FRAME_TAP_H
+#define FRAME_TAP_H
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.h"
+
+enum TapFormat
+{
+    TAP_FORMAT_RGBA,
+    // One byte of BT.709 luma per pixel.
+    TAP_FORMAT_GREY,
+};
+
+struct TapConfig
+{
+    bool enabled = false;
+    // At least this many microseconds between tapped frames; 0 taps every
+    // frame.
+    int64_t interval = 0;
+    // Frames are scaled down to fit within width x height; 0 x 0 keeps the
+    // decoded size.
+    int width = 0;
+    int height = 0;
+    TapFormat format = TAP_FORMAT_RGBA;
+};
+
+struct TapFrame
+{
+    // Backed by a pooled buffer, which goes back to the pool when the last
+    // reference to the frame is dropped.
+    std::vector<uint8_t> data;
+    int width = 0;
+    int height = 0;
+    TapFormat format = TAP_FORMAT_RGBA;
+    int64_t pts = -1;
+    int64_t decoded_time = 0;
+    // Counts tapped frames, so a listener can tell it missed some.
+    uint64_t sequence = 0;
+};
+
+// Hands decoded frames, at a reduced rate and optionally scaled down or
+// as greyscale, to analytics code without going through the GPU. Each
+// frame is converted once, into a pooled buffer, and shared by all
+// listeners; holding the reference is what keeps it out of the pool, so
+// a listener can finish with it on a thread of its own.
+class FrameTap
+{
+public:
+    typedef std::function<void(const std::shared_ptr<const TapFrame> &frame)> Listener;
+
+    FrameTap();
+
+    void configure(const TapConfig &config);
+    TapConfig config();
+    // Listeners run on the decoder's reader thread and must return quickly.
+    // A listener may still be running when removeListener returns.
+    int addListener(Listener listener);
+    void removeListener(int id);
+
+    // Called with every RGBA frame leaving the decoder.
+    void onFrameDecoded(const uint8_t *rgba, int width, int height, int64_t pts, int64_t decoded_time);
+
+private:
+    static void convert(const uint8_t *rgba, int width, int height, TapFrame &frame);
+
+    std::mutex mutex;
+    TapConfig tap_config;
+    std::vector<std::pair<int, Listener>> listeners;
+    int next_listener_id = 1;
+    int64_t last_tap_time = -1;
+    uint64_t sequence = 0;
+    // Shared with the frames, which may outlive the tap.
+    std::shared_ptr<FramePool> pool;
+};
+
+#endif // FRAME_TAP_H
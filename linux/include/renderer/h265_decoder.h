@@ -1,31 +1,359 @@
 #ifndef H265_DECODER_H
 #define H265_DECODER_H
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
 #include <thread>
+#include <vector>
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 
+#include "decoder_drain.h"
+#include "file_player.h"
+#include "frame_pacer.h"
+#include "frame_pool.h"
+#include "frame_shedder.h"
+#include "frame_tap.h"
+#include "latency_watchdog.h"
+#include "nal_trace.h"
+#include "overlay.h"
+#include "reverse_gop_cache.h"
+#include "rtp_receiver.h"
+#include "shm_ingest.h"
+#include "timeshift_ring.h"
+
+class OpenGLRenderer;
+class TextureSwapChain;
+class UploadThread;
+
+enum OutputFormat
+{
+    OUTPUT_FORMAT_RGBA,
+    OUTPUT_FORMAT_GREY,
+};
+
 struct FFmpegProcess
 {
     FILE *input;
     std::thread thread;
+    pid_t pid;
 };
 
+// Runs an ffmpeg command line with pipes on stdin and stdout, and calls
+// callback on a reader thread for every frameSize bytes it writes.
+FFmpegProcess launchFFmpegWithCallback(const char *command,
+                                       size_t frameSize,
+                                       std::atomic<bool> &thread_run,
+                                       std::function<void(std::vector<uint8_t> &)> callback);
+
 class H265Decoder
 {
 public:
-    H265Decoder(GdkWindow *window, FlTextureRegistrar *texture_registrar);
+    H265Decoder(GdkWindow *window, FlTextureRegistrar *texture_registrar, UploadThread *upload_thread);
     ~H265Decoder();
     _FlTexture *init(int width, int height);
-    void addH265Nal(const uint8_t *nal, const size_t size);
+    // pts is the presentation time in microseconds, or -1 if unknown.
+    // Safe to call from any thread.
+    void addH265Nal(const uint8_t *nal, const size_t size, int64_t pts = -1);
+    PacingStats stats();
+
+    // Flushes the session and resumes at the next IRAP whenever a picture
+    // has waited in the decoder, or a frame for display, longer than budget
+    // microseconds; 0 disables. With request_keyframe, a "keyframeRequested"
+    // event asks the sender for an IRAP.
+    void setLatencyBudget(int64_t budget, bool request_keyframe);
+    WatchdogStats watchdogStats();
+
+    // Sheds discardable pictures before they reach the decoder while more
+    // than max_queued_pictures are queued in it or pictures take longer
+    // than max_decode_time microseconds to come out. Each change of the
+    // applied degradation is reported in a "degradationChanged" event.
+    void setOverloadPolicy(bool enabled, size_t max_queued_pictures, int64_t max_decode_time);
+    SheddingStats sheddingStats();
+
+    // Receives RTP/H.265 with payload_type on a UDP port and decodes it
+    // without going through Dart. Returns the bound port, or -1 on failure.
+    int startRtpReceiver(const char *address, int port, int payload_type);
+    void stopRtpReceiver();
+    RtpReceiverStats rtpStats();
+
+    // Lets a producer process on the same host attach a shared-memory ring
+    // through the Unix socket at path (see shm_ring.h).
+    bool startShmIngest(const char *path, size_t capacity);
+    void stopShmIngest();
+
+    // Logs every NAL given to addH265Nal, with its arrival time, to a trace
+    // file written in the background.
+    bool startTraceRecording(const char *path);
+    void stopTraceRecording();
+    NalTraceStats traceStats();
+    // Feeds a recorded trace into this decoder; see NalTracePlayer for speed.
+    // A "traceReplayFinished" event reports when the whole trace was fed.
+    bool startTraceReplay(const char *path, double speed);
+    void stopTraceReplay();
+
+    // Plays a local H.265 Annex-B file at fps, starting from the beginning.
+    // A "fileEnded" event is sent when its last frame has been fed. Without
+    // cache_index the file's index is built but not kept on disk.
+    bool openFile(const char *path, double fps, FilePlaybackInfo &info, bool cache_index = true);
+    // Returns the position playback resumes from, or -1 without a file.
+    int64_t seekFile(int64_t position);
+    // 1 is normal speed, negative plays backwards and 0 pauses.
+    void setFileRate(double rate);
+    void closeFile();
+
+    // Keeps the last duration microseconds of the session's compressed
+    // input for instant replay, in capacity bytes allocated now; 0 turns it
+    // off. See TimeshiftRing.
+    void setTimeshift(int64_t duration, size_t capacity);
+    TimeshiftStats timeshiftStats();
+    // Writes the timeshift to an Annex-B file at path, from the IRAP at or
+    // before back microseconds before the newest input.
+    bool exportTimeshift(const char *path, int64_t back, TimeshiftExport &info);
+    // Plays source's timeshift in this session, usually a second one, from
+    // the IRAP at or before back microseconds before live. It is played as
+    // a file, so seekFile, setFileRate and closeFile control it.
+    bool replayTimeshift(H265Decoder &source, int64_t back, FilePlaybackInfo &info);
+
+    // Turns frames clockwise by quarter_turns, then mirrors them left to
+    // right, on the GPU as they are uploaded, so the texture is upright and
+    // Flutter needs no transform of its own. Sizes given to setOutputSize
+    // and in events are then in display orientation. Cropping to the
+    // conformance window is already done by the decoder.
+    void setOrientation(int quarter_turns, bool mirror);
+    // Whether setOrientation was used, so Flutter must not turn the texture.
+    bool appliesOrientation();
+
+    // Shows only the region x, y, width x height of the picture, in
+    // fractions of its width and height in display orientation, for digital
+    // zoom. Only the region is uploaded. The texture is the size of the
+    // region, or with upscale the size of the whole picture, scaled on the
+    // GPU. A zero width or height shows the whole picture again.
+    void setRegionOfInterest(float x, float y, float width, float height, bool upscale);
+
+    // Reads back the frame shown last, or about to be, through a pack buffer
+    // and a fence on the upload thread, which polls the fence between its
+    // other work instead of waiting. done is then called on the upload
+    // thread with RGBA pixels, top row first, in display orientation; they
+    // are empty if no frame has been uploaded yet.
+    typedef std::function<void(std::vector<uint8_t> &pixels, int width, int height)> SnapshotCallback;
+    void snapshot(SnapshotCallback done);
+
+    // Hands decoded frames to analytics code as they leave the decoder, also
+    // while the session is hidden. Native code adds its listeners to
+    // frameTap() and gets the pooled frames without a copy. With to_dart
+    // each tapped frame is also sent in a "tapFrame" event, which copies it
+    // once into the message.
+    void setFrameTap(const TapConfig &config, bool to_dart);
+    FrameTap *frameTap() { return &frame_tap; }
+
+    // Blends overlay's rectangles and labels into the session's texture on
+    // the GPU as frames are uploaded, from the frame whose pts is
+    // overlay.pts on, until the next batch is due; a batch without
+    // primitives clears it. Batches must come in pts order. Safe to call
+    // from any thread.
+    void setOverlay(Overlay overlay);
+
+    // Registers another texture that shows this session's frames scaled to
+    // fit within width x height. It is drawn on the GPU from every frame
+    // uploaded for the session, which is still decoded and uploaded once.
+    // Returns its texture id. Main thread only.
+    int64_t addOutput(int width, int height, OutputFormat format);
+    bool removeOutput(int64_t id);
+
+    // Has listener called on the upload thread after each frame is
+    // published, instead of signalling the session's texture, for a
+    // compositor that consumes the swap chain itself. Main thread only.
+    void setFrameListener(std::function<void()> listener);
+    TextureSwapChain *swapChain() const { return swap_chain; }
+
+    // A hidden session keeps decoding, so its reference pictures stay valid,
+    // but its frames are dropped as they leave the decoder instead of being
+    // paced and uploaded. From its next IRAP it also decodes at 2x2, which
+    // saves the scaling, conversion and pipe copy, unless a frame tap is
+    // set; showing it restores the size at the IRAP after, and the texture
+    // keeps its last frame until then. Main thread only.
+    void setVisible(bool visible);
+    // A suspended session also stops its decoder and frees its textures and
+    // frame buffers, keeping only the parameter sets. Its textures stay
+    // registered and show a blank placeholder. On resume it decodes again
+    // from the next IRAP, which replaces it. Main thread only.
+    void setSuspended(bool suspended);
+
+    // Scales frames down as they leave the decoder, so they just cover
+    // width x height, the size the texture is shown at in physical pixels;
+    // 0 x 0 keeps the stream size. The new size applies from the next IRAP.
+    void setOutputSize(int width, int height);
+
+    // Receives events for Dart, such as resolution changes, on the main thread.
+    void setEventSink(std::function<void(FlValue *event)> event_sink);
 
 private:
+    // Starts a decoder for the current stream and output sizes.
+    void startDecoder();
+    // Whether a decoder started now runs at the hidden size: the session is
+    // hidden and nothing taps its frames.
+    bool decodesHidden();
+    // Size the decoder outputs frames at, before they are turned.
+    void decodeSize(int &width, int &height);
+    // Has the decoder restart at the next IRAP if the size it is to output
+    // at has changed, with input_mutex held.
+    void checkOutputSize();
+    // Stops the decoder, and any still draining, without waiting for the
+    // frames they hold.
+    void stopDecoder();
+    // Closes the decoder's input and leaves it to drain and exit on a
+    // background thread, so a new one can start at once. Frames of the new
+    // decoder wait until the old one has delivered all of its own.
+    void retireDecoder();
+    // Drops everything in flight and starts a new decoder primed with the
+    // parameter sets seen so far.
+    void restartDecoder();
+    // Same, with input_mutex held.
+    void resetDecoder();
+    // Stops the decoder and drops everything in flight, with input_mutex held.
+    void flushDecoder();
+    // Runs the frame clock only while frames are shown.
+    void updateFrameClock();
+    // Writes the parameter sets seen so far to a decoder just started.
+    void writeParameterSets();
+    void onFrameDecoded(std::vector<uint8_t> &data, int width, int height, uint64_t decoder, bool hidden);
+    void presentDueFrame(GdkFrameClock *clock);
+    void uploadPendingFrame();
+    // Acquires a buffer of chain, with storage of width x height, and
+    // returns its index. Upload thread only.
+    int acquireBuffer(TextureSwapChain *chain, int width, int height);
+
+    // How a decoded frame becomes the texture.
+    struct FrameLayout
+    {
+        // The part of the frame shown, in its pixels.
+        int crop_x;
+        int crop_y;
+        int crop_width;
+        int crop_height;
+        int quarter_turns;
+        bool mirror;
+        // Size of the texture.
+        int width;
+        int height;
+    };
+    void layoutFrame(int frame_width, int frame_height, FrameLayout &layout);
+    // The overlay batch to draw over the frame with pts, if any.
+    std::shared_ptr<const Overlay> dueOverlay(int64_t pts);
+    // Delivers an event to the sink on the main thread, from any thread.
+    // Takes ownership of event; it is dropped if the decoder is gone.
+    void postEvent(FlValue *event);
+
     GdkWindow *window;
     FlTextureRegistrar *texture_registrar;
-    FFmpegProcess ffmpeg_process;
+    FFmpegProcess ffmpeg_process{};
+    // Counts decoders started, identifying which one a frame comes from.
+    uint64_t decoder_generation = 0;
     std::atomic<bool> thread_run{false};
+    // Joins and reaps the last retired decoder.
+    std::thread drain_thread;
+    DecoderDrain decoder_drain;
+    // Serializes input from Dart and from native receivers.
+    std::mutex input_mutex;
+    std::unique_ptr<RtpReceiver> rtp_receiver;
+    std::unique_ptr<ShmIngest> shm_ingest;
+    NalTraceRecorder trace_recorder;
+    std::unique_ptr<NalTracePlayer> trace_player;
+    std::unique_ptr<FilePlayer> file_player;
+    TimeshiftRing timeshift;
+    // Last VPS, SPS and PPS seen, with start codes, replayed when the
+    // decoder restarts.
+    std::array<std::vector<uint8_t>, 3> parameter_sets;
+    ReverseGopCache reverse_cache;
+    LatencyWatchdog watchdog;
+    FrameShedder shedder;
+    FrameTap frame_tap;
+    // Listener sending tapped frames to Dart, or 0. Main thread only.
+    int dart_tap_listener = 0;
+    // Whether the picture whose slices are arriving goes to the decoder.
+    bool picture_admitted = true;
+    std::atomic<int> quarter_turns{0};
+    std::atomic<bool> mirror{false};
+    std::atomic<bool> orientation_applied{false};
+    // Region of interest in display orientation, or all of the picture.
+    std::mutex region_mutex;
+    float region[4] = {0, 0, 1, 1};
+    bool region_upscale = false;
+    std::atomic<bool> visible{true};
+    std::atomic<bool> suspended{false};
+    // Set on resume: pictures are held back until an IRAP.
+    bool wait_for_irap = false;
+    // NAL units of the current addH265Nal call that go to the decoder.
+    std::vector<std::pair<const uint8_t *, size_t>> admitted_nals;
+    FramePool frame_pool;
+    // Shared so events posted from other threads can tell whether the
+    // decoder still exists when they reach the main thread.
+    std::shared_ptr<std::function<void(FlValue *event)>> event_sink;
+
+    UploadThread *upload_thread;
+    // Created, used and destroyed on the upload thread only.
+    std::shared_ptr<OpenGLRenderer> renderer;
+    FlTexture *texture = nullptr;
+    // Owned by texture.
+    TextureSwapChain *swap_chain = nullptr;
+    struct Output
+    {
+        FlTexture *texture;
+        // Owned by texture.
+        TextureSwapChain *swap_chain;
+        int width;
+        int height;
+        OutputFormat format;
+    };
+    // Upload thread only.
+    std::function<void()> frame_listener;
+    // Frames are uploaded here first when they have to be turned.
+    uint32_t staging_texture = 0;
+    int staging_width = 0;
+    int staging_height = 0;
+    // Overlay batches, the one drawn last first and those not yet due after.
+    std::mutex overlay_mutex;
+    std::deque<std::shared_ptr<const Overlay>> overlays;
+    uint64_t next_overlay_id = 1;
+    // Extra textures drawn from each uploaded frame.
+    std::mutex outputs_mutex;
+    std::vector<Output> outputs;
+    // Size of the stream, from its last SPS.
+    int stream_width = 0;
+    int stream_height = 0;
+    // Size given to setOutputSize, and whether the running decoder has yet
+    // to pick it up.
+    int target_width = 0;
+    int target_height = 0;
+    bool output_size_pending = false;
+    // Output size of the running decoder, and of the frame last presented.
+    int width = 0;
+    int height = 0;
+    int presented_width = 0;
+    int presented_height = 0;
+    GdkFrameClock *frame_clock = nullptr;
+    gulong update_handler = 0;
+    bool frame_clock_running = false;
+
+    // Newest frame handed from the frame clock to the upload thread.
+    std::mutex upload_mutex;
+    DecodedFrame upload_frame;
+    bool upload_pending = false;
+
+    FramePacer pacer;
+    // Timestamps of submitted access units not yet matched to a decoded
+    // frame. Frames leave the decoder in presentation order, so each one
+    // takes the smallest pending timestamp.
+    std::mutex pts_mutex;
+    std::multiset<int64_t> pending_pts;
+    int64_t last_pts = -1;
 };
 
-#endif // H265_DECODER_H
\ No newline at end of file
+#endif // H265_DECODER_H
@@ -0,0 +1,58 @@
+#ifndef HEVC_FILE_H
+#define HEVC_FILE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One access unit of an Annex-B file, with its leading parameter sets and
+// SEI, as a byte range of the mapping.
+struct HevcAccessUnit
+{
+    uint64_t offset;
+    uint32_t size;
+    // Index of the IRAP access unit decoding has to start from to reach
+    // this one, or kNoIrap before the first IRAP of the file.
+    uint32_t irap;
+    // NAL unit type and TemporalId of the first slice.
+    uint8_t type;
+    uint8_t temporal_id;
+    uint8_t reserved[6];
+};
+
+// A memory-mapped H.265 Annex-B elementary stream and its access unit
+// index. Building the index takes a scan of the whole file, so it is kept
+// in a cache directory keyed by path, size and modification time, and
+// reopening a file costs a single read of its index.
+class HevcFile
+{
+public:
+    static const uint32_t kNoIrap = UINT32_MAX;
+
+    ~HevcFile();
+
+    // Maps path and loads or builds its index. cache_dir may be empty to
+    // skip the index cache.
+    bool open(const char *path, const std::string &cache_dir);
+    void close();
+
+    const uint8_t *data() const { return mapping; }
+    const std::vector<HevcAccessUnit> &accessUnits() const { return access_units; }
+    size_t keyframeCount() const { return keyframes; }
+    // Identify the file contents, e.g. for cache keys.
+    size_t fileSize() const { return size; }
+    int64_t modificationTime() const { return mtime; }
+
+private:
+    void buildIndex();
+    bool loadIndex(const std::string &index_path);
+    void saveIndex(const std::string &index_path);
+
+    uint8_t *mapping = nullptr;
+    size_t size = 0;
+    int64_t mtime = 0;
+    std::vector<HevcAccessUnit> access_units;
+    size_t keyframes = 0;
+};
+
+#endif // HEVC_FILE_H
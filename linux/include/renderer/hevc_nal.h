@@ -0,0 +1,114 @@
+#ifndef HEVC_NAL_H
+#define HEVC_NAL_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+enum HevcNalType
+{
+    HEVC_NAL_TRAIL_N = 0,
+    HEVC_NAL_TRAIL_R = 1,
+    HEVC_NAL_TSA_N = 2,
+    HEVC_NAL_TSA_R = 3,
+    HEVC_NAL_STSA_N = 4,
+    HEVC_NAL_STSA_R = 5,
+    HEVC_NAL_RADL_N = 6,
+    HEVC_NAL_RADL_R = 7,
+    HEVC_NAL_RASL_N = 8,
+    HEVC_NAL_RASL_R = 9,
+    HEVC_NAL_BLA_W_LP = 16,
+    HEVC_NAL_BLA_W_RADL = 17,
+    HEVC_NAL_BLA_N_LP = 18,
+    HEVC_NAL_IDR_W_RADL = 19,
+    HEVC_NAL_IDR_N_LP = 20,
+    HEVC_NAL_CRA_NUT = 21,
+    HEVC_NAL_VPS = 32,
+    HEVC_NAL_SPS = 33,
+    HEVC_NAL_PPS = 34,
+    HEVC_NAL_AUD = 35,
+    HEVC_NAL_EOS = 36,
+    HEVC_NAL_EOB = 37,
+    HEVC_NAL_FD = 38,
+    HEVC_NAL_SEI_PREFIX = 39,
+    HEVC_NAL_SEI_SUFFIX = 40,
+};
+
+// The two-byte NAL unit header of ITU-T H.265 section 7.3.1.2. All helpers
+// take a NAL unit without its Annex-B start code.
+inline int hevcNalType(const uint8_t *nal)
+{
+    return (nal[0] >> 1) & 0x3f;
+}
+
+inline int hevcTemporalId(const uint8_t *nal)
+{
+    return (nal[1] & 0x07) - 1;
+}
+
+inline bool hevcIsVcl(int type)
+{
+    return type < 32;
+}
+
+inline bool hevcIsIrap(int type)
+{
+    return type >= HEVC_NAL_BLA_W_LP && type <= 23;
+}
+
+// Sub-layer non-reference pictures (TRAIL_N, TSA_N, ..., RSV_VCL_N14) are
+// never used for prediction within their own temporal sub-layer.
+inline bool hevcIsSubLayerNonReference(int type)
+{
+    return type <= 14 && type % 2 == 0;
+}
+
+// Whether a picture stays in the subset of a stream left after dropping
+// every sub-layer above max_temporal_id and, with drop_non_reference, the
+// sub-layer non-reference pictures of max_temporal_id itself. Such a
+// subset still decodes correctly: nothing in it references a dropped
+// picture. IRAPs are always kept, so a max_temporal_id of -1 leaves them
+// only.
+inline bool hevcInSubLayerSubset(int type, int temporal_id, int max_temporal_id, bool drop_non_reference)
+{
+    if (hevcIsIrap(type))
+    {
+        return true;
+    }
+    if (temporal_id != max_temporal_id)
+    {
+        return temporal_id < max_temporal_id;
+    }
+    return !drop_non_reference || !hevcIsSubLayerNonReference(type);
+}
+
+// True for the first slice segment of a picture, i.e. where a new access
+// unit's picture data begins.
+inline bool hevcIsFirstSliceSegment(const uint8_t *nal, size_t size)
+{
+    return size > 2 && hevcIsVcl(hevcNalType(nal)) && (nal[2] & 0x80) != 0;
+}
+
+// Calls f for each NAL unit in an Annex-B byte stream, without start codes.
+// Data without any start code is treated as a single NAL unit.
+void hevcForEachNal(const uint8_t *data, size_t size,
+                    const std::function<void(const uint8_t *nal, size_t size)> &f);
+
+struct HevcSps
+{
+    int chroma_format_idc = 1;
+    int pic_width = 0;
+    int pic_height = 0;
+    // Conformance window in luma samples.
+    int crop_left = 0;
+    int crop_right = 0;
+    int crop_top = 0;
+    int crop_bottom = 0;
+    // Size of the output pictures after the conformance window is applied.
+    int width = 0;
+    int height = 0;
+};
+
+// Parses the start of a sequence parameter set up to its conformance window.
+bool hevcParseSps(const uint8_t *nal, size_t size, HevcSps &sps);
+
+#endif // HEVC_NAL_H
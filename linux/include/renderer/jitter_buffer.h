@@ -0,0 +1,73 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "rtp_depacketizer.h"
+
+struct JitterBufferStats
+{
+    uint64_t packets_lost = 0;
+    uint64_t packets_reordered = 0;
+    uint64_t packets_duplicate = 0;
+    uint64_t packets_late = 0;
+    // Microseconds.
+    int64_t jitter = 0;
+    int64_t target_delay = 0;
+};
+
+// Puts RTP packets back into sequence order. Packets that arrive in order
+// are released at once; only when a sequence number is missing does the
+// buffer wait, for at most the target delay, before declaring it lost.
+// The target adapts to the measured interarrival jitter and to how late
+// reordered packets have actually turned up, so latency stays as low as
+// the network allows. Packets are copied into preallocated slots. A
+// sender that restarts its sequence, forwards or backwards, is followed.
+class JitterBuffer
+{
+public:
+    JitterBuffer();
+
+    void push(const RtpPacket &packet, const uint8_t *data, size_t size, int64_t now);
+    // Releases every packet that is ready at `now`, in sequence order.
+    void pop(int64_t now, const std::function<void(const uint8_t *data, size_t size)> &f);
+    // Time at which pop() must next be called to give up on a missing
+    // packet, or -1 if nothing is pending.
+    int64_t nextDeadline() const;
+    JitterBufferStats stats() const;
+
+private:
+    static const size_t kCapacity = 1024;
+    static const size_t kMaxPacketSize = 2048;
+
+    struct Slot
+    {
+        std::vector<uint8_t> data;
+        size_t size = 0;
+        uint64_t sequence = 0;
+        bool filled = false;
+    };
+
+    void reset(uint64_t sequence);
+    void updateTargetDelay();
+
+    std::vector<Slot> slots;
+    bool started = false;
+    uint64_t next_sequence = 0;
+    uint64_t highest_sequence = 0;
+    // When the packet at next_sequence was first found missing, or 0.
+    int64_t gap_since = 0;
+    // After a packet far behind the others, the sequence number of the one
+    // that would confirm the sender restarted.
+    uint16_t restart_sequence = 0;
+    bool have_restart = false;
+
+    bool have_transit = false;
+    int64_t last_transit = 0;
+    int64_t reorder_delay = 0;
+    JitterBufferStats counters;
+};
+
+#endif // JITTER_BUFFER_H
@@ -0,0 +1,65 @@
+#ifndef LATENCY_WATCHDOG_H
+#define LATENCY_WATCHDOG_H
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+struct WatchdogStats
+{
+    uint64_t resets = 0;
+    uint64_t pictures_dropped = 0;
+    // Microseconds, 0 when nothing is queued.
+    int64_t oldest_picture_age = 0;
+    int64_t oldest_frame_age = 0;
+};
+
+// Keeps a session within a latency budget. It tracks how long the oldest
+// picture has been inside the decoder; when that, or the age of the
+// oldest decoded frame waiting to be shown, exceeds the budget, the
+// session flushes its queues and the watchdog lets no picture through
+// until the next IRAP, so the stream resumes at real time instead of
+// working through the backlog.
+class LatencyWatchdog
+{
+public:
+    // A budget of 0 disables the watchdog.
+    void configure(int64_t budget, bool request_keyframe);
+    bool enabled();
+    bool requestsKeyframe();
+
+    // Decides whether a picture, given the NAL unit type of its first slice,
+    // may go to the decoder.
+    bool admit(int type);
+    void onPicturesQueued(int count, int64_t now);
+    void onFrameDecoded();
+    // Forgets the pictures queued in a decoder that was restarted.
+    void onDecoderReset();
+
+    // Returns true once the budget is exceeded. The caller then flushes
+    // everything queued, and pictures are held back until an IRAP.
+    bool expired(int64_t now, int64_t oldest_frame_time);
+
+    WatchdogStats stats(int64_t now);
+
+private:
+    enum State
+    {
+        PASS,
+        SKIP_TO_IRAP,
+        // The RASL pictures of the IRAP resumed at reference pictures that
+        // were flushed.
+        SKIP_RASL,
+    };
+
+    std::mutex mutex;
+    int64_t budget = 0;
+    bool request_keyframe = false;
+    // Pictures before the first IRAP cannot be decoded either.
+    State state = SKIP_TO_IRAP;
+    // Arrival times of the pictures queued in the decoder, oldest first.
+    std::deque<int64_t> in_flight;
+    int64_t oldest_frame_time = -1;
+    WatchdogStats counters;
+};
+
+#endif // LATENCY_WATCHDOG_H
@@ -0,0 +1,77 @@
+#ifndef MOSAIC_COMPOSITOR_H
+#define MOSAIC_COMPOSITOR_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <flutter_linux/flutter_linux.h>
+#include <gtk/gtk.h>
+
+class H265Decoder;
+class OpenGLRenderer;
+class TextureSwapChain;
+class UploadThread;
+
+struct MosaicTile
+{
+    H265Decoder *session;
+    // Rectangle of the atlas the session's frames are stretched over, in
+    // pixels from its top left corner.
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Composes many sessions into one atlas texture, so a video wall costs a
+// single Flutter texture and a single frame-available signal per refresh
+// rather than one per tile. Sessions in the mosaic upload as usual but
+// signal the compositor instead of their own texture; once per display
+// refresh in which any of them has a new frame, every tile is redrawn
+// from its session's newest buffer into the next atlas buffer.
+class MosaicCompositor
+{
+public:
+    MosaicCompositor(GdkWindow *window, FlTextureRegistrar *texture_registrar, UploadThread *upload_thread);
+    // Sessions still in the layout are handed back to their own textures.
+    ~MosaicCompositor();
+    FlTexture *init(int width, int height);
+
+    // Replaces the layout. Sessions left out show on their own textures
+    // again. Main thread only.
+    void setLayout(const std::vector<MosaicTile> &tiles);
+    // Takes a session out of the layout, e.g. before it is disposed.
+    void removeSession(H265Decoder *session);
+
+private:
+    void updateFrameClock();
+    // Queues a composition unless one is queued already.
+    void requestCompose();
+    // Upload thread only.
+    void compose();
+
+    GdkWindow *window;
+    FlTextureRegistrar *texture_registrar;
+    UploadThread *upload_thread;
+    FlTexture *texture = nullptr;
+    // Owned by texture.
+    TextureSwapChain *swap_chain = nullptr;
+    int width = 0;
+    int height = 0;
+    GdkFrameClock *frame_clock = nullptr;
+    gulong update_handler = 0;
+    bool frame_clock_running = false;
+    bool layout_empty = true;
+
+    // Set from the main thread with the upload thread waiting, read by
+    // compose().
+    std::vector<MosaicTile> tiles;
+    // Whether any tile has a frame the atlas does not show yet.
+    std::atomic<bool> dirty{false};
+    std::atomic<bool> compose_pending{false};
+    // Created, used and destroyed on the upload thread only.
+    std::shared_ptr<OpenGLRenderer> renderer;
+};
+
+#endif // MOSAIC_COMPOSITOR_H
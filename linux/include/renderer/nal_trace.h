@@ -0,0 +1,85 @@
+#ifndef NAL_TRACE_H
+#define NAL_TRACE_H
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// NAL ingest traces capture what was handed to addH265Nal and when, so a
+// production session can be replayed with its original timing.
+//
+// A trace is the 8-byte header "NALT" + little-endian uint32 version,
+// followed by records of three LEB128 varints -- microseconds since the
+// previous record, pts + 1 (0 when untimed) and the payload size -- and
+// the payload bytes.
+
+struct NalTraceStats
+{
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    // Records lost because the writer thread fell too far behind.
+    uint64_t dropped = 0;
+};
+
+// Appends records to a trace without blocking the ingest path on disk I/O:
+// records are encoded into an in-memory chunk, and full chunks are written
+// by a background thread.
+class NalTraceRecorder
+{
+public:
+    ~NalTraceRecorder();
+
+    bool start(const char *path);
+    void stop();
+    void append(const uint8_t *data, size_t size, int64_t pts, int64_t now);
+    NalTraceStats stats();
+
+private:
+    void run();
+    void flushChunk();
+
+    FILE *file = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<uint8_t> chunk;
+    std::deque<std::vector<uint8_t>> full_chunks;
+    std::vector<std::vector<uint8_t>> free_chunks;
+    bool running = false;
+    int64_t last_time = 0;
+    NalTraceStats counters;
+};
+
+// Feeds a recorded trace back on its own thread. speed scales the
+// recorded timing (2 plays twice as fast); 0 plays as fast as possible
+// and drops timestamps so no frame is held back for pacing.
+class NalTracePlayer
+{
+public:
+    typedef std::function<void(const uint8_t *data, size_t size, int64_t pts)> NalCallback;
+    typedef std::function<void(const NalTraceStats &stats, int64_t elapsed)> FinishedCallback;
+
+    NalTracePlayer(NalCallback callback, FinishedCallback finished);
+    ~NalTracePlayer();
+
+    bool start(const char *path, double speed);
+    void stop();
+
+private:
+    void run(double speed);
+
+    NalCallback callback;
+    FinishedCallback finished;
+    FILE *file = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::atomic<bool> running{false};
+};
+
+#endif // NAL_TRACE_H
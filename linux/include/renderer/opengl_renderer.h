@@ -3,12 +3,59 @@
 #include <gtk/gtk.h>
 #include <GL/glew.h>
 #include <GL/gl.h>
+#include <cstring>
 #include <vector>
 
+#include "overlay.h"
+
+// How drawTexture maps its source onto the target: turned clockwise by
+// quarter_turns, then mirrored left to right.
+struct SourceTransform
+{
+    int quarter_turns = 0;
+    bool mirror = false;
+};
+
+// A copy of a texture on its way into a pack buffer.
+struct Readback
+{
+    GLuint buffer = 0;
+    GLsync fence = nullptr;
+    int width = 0;
+    int height = 0;
+};
+
 class OpenGLRenderer
 {
     GdkGLContext *context;
     GLuint pbo;
+    // Draw pass, created at the first drawTexture().
+    GLuint program = 0;
+    GLuint vertex_array = 0;
+    GLuint framebuffer = 0;
+    GLint footprint_location = -1;
+    GLint grey_location = -1;
+    GLint transform_location = -1;
+    // Overlay pass, created at the first drawOverlay().
+    GLuint overlay_program = 0;
+    GLint overlay_color_location = -1;
+    GLint overlay_label_rect_location = -1;
+    // Labels of the overlay last drawn, rasterized into one texture.
+    struct LabelBox
+    {
+        int y;
+        int width;
+        int height;
+    };
+    GLuint label_texture = 0;
+    int label_texture_width = 0;
+    int label_texture_height = 0;
+    uint64_t label_overlay_id = 0;
+    std::vector<LabelBox> label_boxes;
+
+    bool createProgram();
+    bool createOverlayProgram();
+    void rasterizeLabels(const Overlay &overlay);
 
 public:
     OpenGLRenderer(GdkGLContext *context)
@@ -20,37 +67,92 @@ public:
     ~OpenGLRenderer()
     {
         glDeleteBuffers(1, &pbo);
+        glDeleteProgram(program);
+        glDeleteProgram(overlay_program);
+        glDeleteTextures(1, &label_texture);
+        glDeleteVertexArrays(1, &vertex_array);
+        glDeleteFramebuffers(1, &framebuffer);
     }
 
-    int genTexture(int width, int height)
+    // Allocates immutable RGBA storage for a width x height texture without
+    // touching client memory. When clear is set the storage is zeroed on the
+    // GPU, otherwise it is undefined until the first upload.
+    GLuint genTexture(int width, int height, bool clear = false)
     {
-        std::vector<uint8_t> buffer(width * height * 4, 0);
-
         GLuint texture;
         glGenTextures(1, &texture);
         glBindTexture(GL_TEXTURE_2D, texture);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage)
+        {
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
         glBindTexture(GL_TEXTURE_2D, 0);
 
-        // Initialize PBO with texture size
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
-        glBufferData(GL_PIXEL_UNPACK_BUFFER, width * height * 4, nullptr, GL_STREAM_DRAW);
-        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
+        if (clear)
+        {
+            clearTexture(texture);
+        }
         return texture;
     }
 
-    void update_texture_with_frame(int texture_name, const uint8_t *frame_data, int width, int height)
+    void clearTexture(GLuint texture)
+    {
+        if (GLEW_VERSION_4_4 || GLEW_ARB_clear_texture)
+        {
+            glClearTexImage(texture, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            return;
+        }
+
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &fbo);
+    }
+
+    // Uploads a width x height RGBA image. stride is the distance between
+    // its rows in frame_data, which may be wider when the image is a region
+    // of a larger frame; 0 means the rows are packed.
+    void update_texture_with_frame(GLuint texture_name, const uint8_t *frame_data, int width, int height,
+                                   size_t stride = 0)
     {
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
 
+        // Size the PBO for the frame, orphaning the previous storage so the
+        // map does not wait for the last transfer to finish.
+        const size_t row_size = static_cast<size_t>(width) * 4;
+        const size_t size = row_size * height;
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+
         // Map PBO memory and copy the frame data
-        void *ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        uint8_t *ptr = static_cast<uint8_t *>(glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY));
         if (ptr)
         {
-            memcpy(ptr, frame_data, width * height * 4);
+            if (stride == 0 || stride == row_size)
+            {
+                memcpy(ptr, frame_data, size);
+            }
+            else
+            {
+                // Only the region's rows are copied, so the transfer shrinks
+                // with the region.
+                for (int row = 0; row < height; row++)
+                {
+                    memcpy(ptr + row * row_size, frame_data + row * stride, row_size);
+                }
+            }
             glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
         }
 
@@ -62,6 +164,25 @@ public:
         glBindTexture(GL_TEXTURE_2D, 0);
         glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
     }
+
+    // Draws source, a texture of source_width x source_height, scaled over
+    // the width x height rectangle of target at x, y, counted from its
+    // first row, optionally as greyscale. Returns false if the draw pass
+    // could not be set up.
+    bool drawTexture(GLuint source, int source_width, int source_height,
+                     GLuint target, int x, int y, int width, int height, bool grey,
+                     const SourceTransform &transform = SourceTransform());
+
+    // Blends overlay over target, a width x height texture.
+    bool drawOverlay(const Overlay &overlay, GLuint target, int width, int height);
+
+    // Queues a copy of the RGBA texture into a new pack buffer and returns
+    // without waiting for it.
+    Readback startReadback(GLuint texture, int width, int height);
+    // Waits up to timeout nanoseconds for the copy. Returns false if it is
+    // still running; otherwise fills pixels, top row first and empty on
+    // failure, and frees the readback.
+    bool finishReadback(Readback &readback, std::vector<uint8_t> &pixels, GLuint64 timeout);
 };
 
 #endif // OPENGL_RENDERER_FLUTTER_H
@@ -0,0 +1,46 @@
+#ifndef OVERLAY_H
+#define OVERLAY_H
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Overlay positions are fractions of the width and height of the texture
+// as shown, from its top left corner. Colors are 0xAARRGGBB, not
+// premultiplied.
+struct OverlayRect
+{
+    float x = 0;
+    float y = 0;
+    float width = 0;
+    float height = 0;
+    uint32_t color = 0xffff0000;
+    // Line width in texture pixels, or 0 to fill the rectangle.
+    float stroke_width = 2;
+};
+
+// Text on a background box whose top left corner is at x, y.
+struct OverlayLabel
+{
+    float x = 0;
+    float y = 0;
+    std::string text;
+    uint32_t color = 0xffffffff;
+    uint32_t background = 0x80000000;
+    // In texture pixels.
+    float font_size = 16;
+};
+
+// A batch of primitives drawn over a session's frames, e.g. the detections
+// of one analysed frame.
+struct Overlay
+{
+    // Unique per batch, assigned by the session.
+    uint64_t id = 0;
+    // Shown from the frame with this pts on, until a later batch is due;
+    // -1 shows it from the next frame uploaded.
+    int64_t pts = -1;
+    std::vector<OverlayRect> rects;
+    std::vector<OverlayLabel> labels;
+};
+
+#endif // OVERLAY_H
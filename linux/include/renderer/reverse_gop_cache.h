@@ -0,0 +1,66 @@
+#ifndef REVERSE_GOP_CACHE_H
+#define REVERSE_GOP_CACHE_H
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "frame_pacer.h"
+
+// Holds decoded groups of pictures for reverse playback. A group is fed to
+// the decoder front to back, and its frames come out in presentation order;
+// once all of them are in, they are handed out last-first with display
+// timestamps that count forwards.
+//
+// Each group is decoded by a decoder process of its own. ffmpeg can drop or
+// merge a picture, so a group's frame count is only a hint: the group also
+// ends when its decoder has delivered everything it is going to, and its
+// frames are never confused with those of the next group.
+class ReverseGopCache
+{
+public:
+    // The next count frames of decoder form one group, of which every
+    // stride-th is kept. Kept frames are spread evenly over span
+    // microseconds from first_pts.
+    void expectGroup(uint64_t decoder, size_t count, size_t stride, int64_t first_pts, int64_t span);
+
+    // Called for every frame of decoder. Returns false if no group belongs
+    // to decoder. Otherwise the frame is taken, except for the data of
+    // frames the stride skips or that come after the group is complete,
+    // which is left for the caller to recycle.
+    bool take(uint64_t decoder, DecodedFrame &frame);
+
+    // Completes the groups of decoder with the frames they have, once it
+    // has exited.
+    void finishDecoder(uint64_t decoder);
+    // Moves the groups of decoder from that have no frames yet to decoder
+    // to, when from is replaced before any of their pictures reach it.
+    void handOver(uint64_t from, uint64_t to);
+
+    // Takes the next frame to display from the oldest complete group.
+    bool pop(DecodedFrame &frame);
+
+    // Forgets all groups, returning their frame buffers.
+    void clear(std::vector<std::vector<uint8_t>> &buffers);
+
+private:
+    struct Group
+    {
+        uint64_t decoder;
+        size_t count;
+        size_t stride;
+        int64_t first_pts;
+        int64_t span;
+        size_t received = 0;
+        std::vector<DecodedFrame> frames;
+    };
+
+    // Gives the kept frames of a complete group their timestamps.
+    static void complete(Group &group);
+
+    std::mutex mutex;
+    std::deque<Group> groups;
+};
+
+#endif // REVERSE_GOP_CACHE_H
@@ -0,0 +1,64 @@
+#ifndef RTP_DEPACKETIZER_H
+#define RTP_DEPACKETIZER_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct RtpPacket
+{
+    uint16_t sequence = 0;
+    uint32_t timestamp = 0;
+    uint32_t ssrc = 0;
+    uint8_t payload_type = 0;
+    bool marker = false;
+    const uint8_t *payload = nullptr;
+    size_t payload_size = 0;
+};
+
+// Parses the fixed RTP header of RFC 3550, skipping CSRCs, header
+// extensions and padding. payload points into data.
+bool parseRtpPacket(const uint8_t *data, size_t size, RtpPacket &packet);
+
+// Reassembles H.265 access units from RTP payloads as specified by RFC 7798:
+// single NAL unit packets, aggregation packets (AP) and fragmentation units
+// (FU). Access units are emitted as Annex-B byte streams when the marker
+// bit is set or the RTP timestamp changes. Assumes sprop-max-don-diff is 0,
+// i.e. no DONL fields and transmission order equal to decoding order.
+//
+// An access unit is emitted as damaged when packets of it may be missing:
+// a hole in the sequence damages the access unit it cuts short, if its
+// marker has not been seen, and the one the next packet belongs to.
+class RtpDepacketizer
+{
+public:
+    typedef std::function<void(const uint8_t *data, size_t size, uint32_t rtp_timestamp, bool damaged)> AccessUnitCallback;
+
+    explicit RtpDepacketizer(AccessUnitCallback callback);
+
+    // Duplicate and late packets are dropped.
+    void push(const RtpPacket &packet);
+    // Drops any partially received fragment, e.g. after known packet loss.
+    void discardFragment();
+    // Packets skipped by forward jumps in the sequence number.
+    uint64_t packetsLost() const { return packets_lost; }
+
+private:
+    void appendNal(const uint8_t *nal, size_t size);
+    void flush();
+
+    AccessUnitCallback callback;
+    std::vector<uint8_t> access_unit;
+    uint32_t timestamp = 0;
+    bool have_timestamp = false;
+    uint16_t last_sequence = 0;
+    bool have_sequence = false;
+    // Offset in access_unit where the NAL being reassembled from FUs begins.
+    size_t fragment_start = 0;
+    bool in_fragment = false;
+    // Whether the access unit being assembled may be missing packets.
+    bool damaged = false;
+    uint64_t packets_lost = 0;
+};
+
+#endif // RTP_DEPACKETIZER_H
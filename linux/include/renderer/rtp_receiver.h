@@ -0,0 +1,76 @@
+#ifndef RTP_RECEIVER_H
+#define RTP_RECEIVER_H
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "jitter_buffer.h"
+#include "rtp_depacketizer.h"
+
+struct RtpReceiverStats
+{
+    uint64_t packets_received = 0;
+    uint64_t bytes_received = 0;
+    uint64_t access_units = 0;
+    // Access units dropped while waiting for an IRAP after unrepaired loss.
+    uint64_t access_units_skipped = 0;
+    // Packets from another source than the first one, or with another
+    // payload type than the one configured.
+    uint64_t packets_ignored = 0;
+    JitterBufferStats jitter_buffer;
+};
+
+// Receives RTP/H.265 over UDP on its own thread and hands complete access
+// units, with their presentation time in microseconds, to a callback.
+// Packets are read in batches with recvmmsg to keep the syscall count low
+// at high bitrates, and reordered by a jitter buffer before they are
+// depacketized. After loss that could not be repaired, access units are
+// skipped until the next IRAP picture. The receiver locks onto the SSRC of
+// the first packet it accepts and ignores other sources.
+class RtpReceiver
+{
+public:
+    typedef std::function<void(const uint8_t *data, size_t size, int64_t pts)> AccessUnitCallback;
+
+    explicit RtpReceiver(AccessUnitCallback callback);
+    ~RtpReceiver();
+
+    // Binds to address (nullptr for any) and port (0 for an ephemeral one)
+    // and starts receiving packets of payload_type. Returns the bound port,
+    // or -1 on failure.
+    int start(const char *address, int port, int payload_type);
+    void stop();
+    RtpReceiverStats stats();
+
+private:
+    void run();
+    void onAccessUnit(const uint8_t *data, size_t size, uint32_t rtp_timestamp, bool damaged);
+
+    AccessUnitCallback callback;
+    RtpDepacketizer depacketizer;
+    // Only touched by the receive thread, except for stats().
+    std::mutex jitter_mutex;
+    JitterBuffer jitter_buffer;
+    bool waiting_for_irap = false;
+    int payload_type = 0;
+    bool have_ssrc = false;
+    uint32_t ssrc = 0;
+    int socket_fd = -1;
+    int wake_fd = -1;
+    std::thread thread;
+
+    // RTP timestamps unwrapped to 64 bits, relative to the first one.
+    bool have_timestamp = false;
+    uint32_t last_timestamp = 0;
+    int64_t extended_timestamp = 0;
+
+    std::atomic<uint64_t> packets_received{0};
+    std::atomic<uint64_t> bytes_received{0};
+    std::atomic<uint64_t> access_units{0};
+    std::atomic<uint64_t> access_units_skipped{0};
+    std::atomic<uint64_t> packets_ignored{0};
+};
+
+#endif // RTP_RECEIVER_H
@@ -0,0 +1,52 @@
+#ifndef SHM_INGEST_H
+#define SHM_INGEST_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "shm_ring.h"
+
+// Accepts NAL units from a co-located producer process through a
+// memfd-backed ring (see shm_ring.h) handed out over a Unix socket, and
+// passes them to a callback straight from the shared mapping, without
+// copies and without Dart. One producer is served at a time.
+class ShmIngest
+{
+public:
+    typedef std::function<void(const uint8_t *data, size_t size, int64_t pts)> NalCallback;
+
+    explicit ShmIngest(NalCallback callback);
+    ~ShmIngest();
+
+    // Listens on the Unix socket at path with a ring of capacity bytes,
+    // which must lie within kShmRingMinCapacity and kShmRingMaxCapacity.
+    // A stale socket at path is replaced; any other file is left alone and
+    // fails the start.
+    bool start(const char *path, size_t capacity);
+    void stop();
+
+private:
+    void run();
+    bool acceptProducer();
+    void closeProducer();
+    void consume();
+
+    NalCallback callback;
+    std::string path;
+    size_t capacity = 0;
+    int listen_fd = -1;
+    int wake_fd = -1;
+    std::thread thread;
+
+    // Per-producer state.
+    int client_fd = -1;
+    int memfd = -1;
+    int data_fd = -1;
+    int space_fd = -1;
+    ShmRingHeader *ring = nullptr;
+    size_t mapping_size = 0;
+};
+
+#endif // SHM_INGEST_H
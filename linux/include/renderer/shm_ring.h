@@ -0,0 +1,67 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+#include <atomic>
+#include <cstdint>
+
+// Layout of the shared-memory ingest ring, shared with producer processes.
+//
+// A producer connects to the plugin's Unix socket and receives one message
+// carrying a ShmRingHello and, via SCM_RIGHTS, three descriptors: the
+// memfd holding the ring, an eventfd the producer writes to after
+// publishing records, and an eventfd the plugin writes to after consuming
+// records. The memfd is sealed against resizing.
+//
+// The memfd starts with a ShmRingHeader followed by `capacity` bytes of
+// record data. Indices count bytes monotonically and are taken modulo
+// capacity. Each record is a ShmRecordHeader followed by `size` bytes of
+// Annex-B data, padded to kShmRecordAlignment. A record never wraps: if it
+// does not fit before the end of the ring, the producer writes a header
+// with SHM_RECORD_PADDING covering the remaining bytes and starts again at
+// offset 0; if fewer bytes than a header remain, they are skipped without
+// one. The producer advances write_index with release semantics after
+// writing a record; the plugin advances read_index the same way after
+// consuming it.
+
+static const uint32_t kShmRingMagic = 0x48323635; // "H265"
+static const uint32_t kShmRingVersion = 1;
+static const uint32_t kShmRecordAlignment = 8;
+// Bounds on the capacity a ring may be created with.
+static const uint64_t kShmRingMinCapacity = 4096;
+static const uint64_t kShmRingMaxCapacity = uint64_t(1) << 30;
+
+enum ShmRecordFlags
+{
+    SHM_RECORD_PADDING = 1,
+};
+
+struct ShmRingHello
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+};
+
+struct ShmRingHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;
+    alignas(64) std::atomic<uint64_t> write_index;
+    alignas(64) std::atomic<uint64_t> read_index;
+};
+
+struct ShmRecordHeader
+{
+    uint32_t size;
+    uint32_t flags;
+    // Presentation time in microseconds, or -1.
+    int64_t pts;
+};
+
+inline uint64_t shmRecordSpan(uint32_t size)
+{
+    const uint64_t span = sizeof(ShmRecordHeader) + size;
+    return (span + kShmRecordAlignment - 1) & ~uint64_t(kShmRecordAlignment - 1);
+}
+
+#endif // SHM_RING_H
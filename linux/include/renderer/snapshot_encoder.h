@@ -0,0 +1,56 @@
+#ifndef SNAPSHOT_ENCODER_H
+#define SNAPSHOT_ENCODER_H
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum SnapshotFormat
+{
+    SNAPSHOT_FORMAT_PNG,
+    SNAPSHOT_FORMAT_JPEG,
+    SNAPSHOT_FORMAT_RGBA,
+};
+
+struct SnapshotJob
+{
+    // RGBA, top row first.
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    SnapshotFormat format = SNAPSHOT_FORMAT_PNG;
+    // The image is written to this file if set, otherwise returned.
+    std::string path;
+    // Called on the worker thread with the encoded image, which is empty
+    // when written to path. ok is false if encoding or writing failed.
+    std::function<void(bool ok, std::vector<uint8_t> &data)> done;
+};
+
+// Encodes stills taken from sessions on a worker thread of its own, so
+// neither the main thread nor the upload thread waits for PNG or JPEG
+// compression. Jobs run in the order they were queued; those still queued
+// when the encoder is destroyed are dropped without calling done.
+class SnapshotEncoder
+{
+public:
+    SnapshotEncoder();
+    ~SnapshotEncoder();
+
+    void encode(SnapshotJob job);
+
+private:
+    void run();
+    void process(SnapshotJob &job);
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<SnapshotJob> jobs;
+    bool running = true;
+};
+
+#endif // SNAPSHOT_ENCODER_H
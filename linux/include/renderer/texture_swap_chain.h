@@ -0,0 +1,64 @@
+#ifndef TEXTURE_SWAP_CHAIN_H
+#define TEXTURE_SWAP_CHAIN_H
+#include <GL/glew.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class OpenGLRenderer;
+
+struct SwapChainBuffer
+{
+    GLuint name = 0;
+    int width = 0;
+    int height = 0;
+    // Signalled when the upload into this buffer has completed.
+    GLsync upload_fence = nullptr;
+    // Signalled when the raster thread has finished sampling this buffer.
+    GLsync release_fence = nullptr;
+};
+
+// A small ring of textures shared between the uploading context and the
+// Flutter raster thread. The producer always writes into a buffer that is
+// neither on screen nor waiting to be shown, and the consumer always picks
+// the newest completed one, so neither side ever waits on the other's use
+// of a single texture. Cross-context ordering is done with GL fences.
+class TextureSwapChain
+{
+public:
+    static const int kLength = 3;
+
+    void setBuffer(int index, GLuint name, int width, int height);
+    std::vector<GLuint> names();
+    // Empties the chain and returns the texture names for the caller to
+    // delete. Called with the uploading context current, which must
+    // publishPlaceholder() before the texture is drawn again.
+    std::vector<GLuint> clear();
+
+    // Producer side, with the uploading context current. acquire() returns
+    // a free buffer index after making the GPU wait until the raster thread
+    // has released it; publish() makes it the newest frame.
+    int acquire();
+    SwapChainBuffer buffer(int index);
+    void publish(int index);
+    // Publishes a transparent 1x1 buffer. Flutter treats a texture with
+    // nothing to show as an error, so this is done before a texture is
+    // registered and whenever its buffers are freed.
+    void publishPlaceholder(OpenGLRenderer &renderer);
+    // The buffer published last, whether or not it is shown yet; false
+    // before the first publish(). Reads of it issued now complete before
+    // any later upload into it.
+    bool newest(SwapChainBuffer &buffer);
+
+    // Consumer side, with the Flutter context current. False before the
+    // first publish().
+    bool latest(uint32_t *name, uint32_t *width, uint32_t *height);
+
+private:
+    std::mutex mutex;
+    SwapChainBuffer buffers[kLength];
+    int front = -1;
+    int ready = -1;
+};
+
+#endif // TEXTURE_SWAP_CHAIN_H
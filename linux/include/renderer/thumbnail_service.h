@@ -0,0 +1,88 @@
+#ifndef THUMBNAIL_SERVICE_H
+#define THUMBNAIL_SERVICE_H
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum ThumbnailFormat
+{
+    THUMBNAIL_FORMAT_RGBA,
+    THUMBNAIL_FORMAT_JPEG,
+};
+
+// Highest frame rate a request may give. Positions map to frames through
+// the frame duration in whole microseconds.
+static const double kMaxThumbnailFps = 1000.0;
+
+struct ThumbnailRequest
+{
+    int id = 0;
+    std::string path;
+    // Microseconds from the start of the file, at fps, which must lie in
+    // (0, kMaxThumbnailFps].
+    std::vector<int64_t> positions;
+    double fps = 30.0;
+    int width = 160;
+    // 0 keeps the aspect ratio of the stream.
+    int height = 0;
+    ThumbnailFormat format = THUMBNAIL_FORMAT_RGBA;
+};
+
+struct Thumbnail
+{
+    int request_id = 0;
+    // The position asked for, and that of the keyframe shown.
+    int64_t position = 0;
+    int64_t keyframe_position = 0;
+    int width = 0;
+    int height = 0;
+    ThumbnailFormat format = THUMBNAIL_FORMAT_RGBA;
+    std::vector<uint8_t> data;
+};
+
+// Extracts small thumbnails from H.265 Annex-B files for timeline views.
+// Only the keyframe at or before each position is decoded, scaled down by
+// ffmpeg, on a worker thread and decoder process that both run at the
+// lowest CPU priority. Thumbnails are cached on disk by file contents,
+// keyframe offset, size and format, so a recording opened again shows its
+// timeline without decoding.
+class ThumbnailService
+{
+public:
+    typedef std::function<void(const Thumbnail &thumbnail)> ThumbnailCallback;
+    typedef std::function<void(int request_id)> DoneCallback;
+
+    // Callbacks run on the worker thread. done is called once per request,
+    // after its last thumbnail, also when the request fails or is cancelled.
+    ThumbnailService(const std::string &cache_dir, ThumbnailCallback callback, DoneCallback done);
+    ~ThumbnailService();
+
+    // Queues request and returns its id.
+    int request(ThumbnailRequest request);
+    void cancel(int request_id);
+
+private:
+    void run();
+    void process(const ThumbnailRequest &request);
+    bool cancelled(int request_id);
+
+    std::string cache_dir;
+    ThumbnailCallback callback;
+    DoneCallback done;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<ThumbnailRequest> requests;
+    std::set<int> cancelled_ids;
+    int next_id = 1;
+    bool running = true;
+};
+
+#endif // THUMBNAIL_SERVICE_H
@@ -0,0 +1,84 @@
+#ifndef TIMESHIFT_RING_H
+#define TIMESHIFT_RING_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct TimeshiftStats
+{
+    // Microseconds of input held, from the first IRAP kept.
+    int64_t duration = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+    size_t units = 0;
+    size_t keyframes = 0;
+};
+
+struct TimeshiftExport
+{
+    size_t pictures = 0;
+    size_t bytes = 0;
+    // Microseconds between the first and the last unit written.
+    int64_t duration = 0;
+    // Estimated from the arrival times, for playing the export back.
+    double fps = 0;
+};
+
+// Keeps the last stretch of a session's compressed input for instant
+// replay. Units are copied as they arrive into an arena allocated once by
+// configure(), next to an index of fixed size, so memory stays constant
+// and appending never allocates. The oldest units make way for new ones;
+// whole groups of pictures are kept for the configured duration, so the
+// window always starts at an IRAP. Each IRAP is stored with the parameter
+// sets in effect, so replay and export can start at any of them.
+class TimeshiftRing
+{
+public:
+    // Keeps duration microseconds of input in an arena of capacity bytes,
+    // whichever is shorter. 0 for either frees the ring.
+    void configure(int64_t duration, size_t capacity);
+    bool enabled();
+
+    // Appends one unit of input as given to the decoder, in which pictures
+    // new pictures begin, an IRAP among them if irap is set. parameter_sets,
+    // with start codes, are stored in front of an IRAP unit that has no SPS
+    // of its own.
+    void append(const uint8_t *data, size_t size, int64_t arrival, int pictures, bool irap, bool has_sps,
+                const std::array<std::vector<uint8_t>, 3> &parameter_sets);
+
+    // Copies out the units from the IRAP at or before back microseconds
+    // before the newest unit to the end. Falls back to the first IRAP kept.
+    // Returns false if the ring holds no IRAP.
+    bool copyOut(int64_t back, std::vector<uint8_t> &stream, TimeshiftExport &info);
+    TimeshiftStats stats();
+
+private:
+    struct Unit
+    {
+        // Position in the stream of all bytes ever appended; the arena
+        // holds it at offset % capacity.
+        uint64_t offset;
+        uint32_t size;
+        int32_t pictures;
+        int64_t arrival;
+        bool irap;
+    };
+
+    const Unit &unit(size_t i) const { return units[(first + i) % units.size()]; }
+    void dropFirst();
+    void evict(size_t size, int64_t arrival);
+    void write(const uint8_t *data, size_t size);
+    void read(uint64_t offset, size_t size, uint8_t *out) const;
+
+    std::mutex mutex;
+    int64_t duration = 0;
+    std::vector<uint8_t> arena;
+    std::vector<Unit> units;
+    size_t first = 0;
+    size_t count = 0;
+    uint64_t write_offset = 0;
+};
+
+#endif // TIMESHIFT_RING_H
@@ -0,0 +1,41 @@
+#ifndef UPLOAD_THREAD_H
+#define UPLOAD_THREAD_H
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <gtk/gtk.h>
+
+// Runs all texture uploads and other GL work of the plugin on one thread
+// with its own GL context, which shares objects with the Flutter context.
+// Tasks run in the order they were posted.
+class UploadThread
+{
+public:
+    UploadThread(GdkWindow *window);
+    ~UploadThread();
+
+    void post(std::function<void()> task);
+    // Runs task on the upload thread and waits for it, e.g. to create or
+    // delete GL objects.
+    void invoke(std::function<void()> task);
+
+    // False if the GL context or GLEW could not be initialised.
+    bool isReady() const { return ready; }
+    GdkGLContext *glContext() const { return context; }
+
+private:
+    void run();
+
+    GdkGLContext *context = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<std::function<void()>> tasks;
+    bool running = true;
+    bool ready = false;
+};
+
+#endif // UPLOAD_THREAD_H
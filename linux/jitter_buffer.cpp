@@ -0,0 +1,190 @@
+#include "include/renderer/jitter_buffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    const int64_t kMinTargetDelay = 2000;
+    const int64_t kMaxTargetDelay = 200000;
+    const int64_t kRtpClockRate = 90000;
+    // Packets further behind the newest one than this are not reordered but
+    // from long ago, or from a sender that restarted its sequence.
+    const int kMaxMisorder = 100;
+}
+
+JitterBuffer::JitterBuffer() : slots(kCapacity)
+{
+    for (auto &slot : slots)
+    {
+        slot.data.resize(kMaxPacketSize);
+    }
+    counters.target_delay = kMinTargetDelay;
+}
+
+void JitterBuffer::push(const RtpPacket &packet, const uint8_t *data, size_t size, int64_t now)
+{
+    if (size > kMaxPacketSize)
+    {
+        return;
+    }
+
+    // Extend the 16-bit sequence number relative to the highest one seen.
+    uint64_t sequence;
+    if (!started)
+    {
+        sequence = packet.sequence + 0x10000;
+        reset(sequence);
+        started = true;
+    }
+    else
+    {
+        const int delta = int16_t(packet.sequence - uint16_t(highest_sequence));
+        if (delta >= -kMaxMisorder)
+        {
+            sequence = highest_sequence + delta;
+        }
+        else if (have_restart && packet.sequence == restart_sequence)
+        {
+            // Two packets in a row far behind: the sender restarted at a
+            // lower sequence number (RFC 3550, appendix A.1). What is still
+            // waiting belongs to the old sequence and is dropped.
+            sequence = (highest_sequence | 0xffff) + 1 + packet.sequence;
+            reset(sequence);
+            have_restart = false;
+            have_transit = false;
+        }
+        else
+        {
+            restart_sequence = uint16_t(packet.sequence + 1);
+            have_restart = true;
+            counters.packets_late++;
+            return;
+        }
+    }
+
+    if (sequence < next_sequence)
+    {
+        counters.packets_late++;
+        return;
+    }
+    if (sequence >= next_sequence + kCapacity)
+    {
+        // Too far ahead to wait for what is missing; the sender restarted or
+        // we fell far behind.
+        counters.packets_lost += sequence - next_sequence;
+        reset(sequence);
+    }
+
+    Slot &slot = slots[sequence % kCapacity];
+    if (slot.filled && slot.sequence == sequence)
+    {
+        counters.packets_duplicate++;
+        return;
+    }
+    memcpy(slot.data.data(), data, size);
+    slot.size = size;
+    slot.sequence = sequence;
+    slot.filled = true;
+
+    if (sequence > highest_sequence)
+    {
+        // Interarrival jitter of RFC 3550, in microseconds.
+        const int64_t transit = now - int64_t(packet.timestamp) * 1000000 / kRtpClockRate;
+        if (have_transit && sequence == highest_sequence + 1)
+        {
+            const int64_t d = transit - last_transit;
+            // Ignore 32-bit timestamp wraps.
+            if (std::llabs(d) < 10000000)
+            {
+                counters.jitter += (std::llabs(d) - counters.jitter) / 16;
+            }
+        }
+        last_transit = transit;
+        have_transit = true;
+        highest_sequence = sequence;
+    }
+    else
+    {
+        counters.packets_reordered++;
+        if (sequence == next_sequence && gap_since != 0)
+        {
+            // Remember how long the hole took to fill, with a slow decay.
+            const int64_t delay = now - gap_since;
+            reorder_delay = std::max(reorder_delay - reorder_delay / 64, delay + delay / 4);
+        }
+    }
+    updateTargetDelay();
+}
+
+void JitterBuffer::pop(int64_t now, const std::function<void(const uint8_t *data, size_t size)> &f)
+{
+    if (!started)
+    {
+        return;
+    }
+
+    while (next_sequence <= highest_sequence)
+    {
+        Slot &slot = slots[next_sequence % kCapacity];
+        if (slot.filled && slot.sequence == next_sequence)
+        {
+            f(slot.data.data(), slot.size);
+            slot.filled = false;
+            next_sequence++;
+            gap_since = 0;
+            continue;
+        }
+
+        if (gap_since == 0)
+        {
+            gap_since = now;
+        }
+        if (now - gap_since < counters.target_delay)
+        {
+            break;
+        }
+
+        // Give up on the whole run of missing packets at once.
+        while (next_sequence <= highest_sequence)
+        {
+            Slot &missing = slots[next_sequence % kCapacity];
+            if (missing.filled && missing.sequence == next_sequence)
+            {
+                break;
+            }
+            counters.packets_lost++;
+            next_sequence++;
+        }
+        gap_since = 0;
+    }
+}
+
+int64_t JitterBuffer::nextDeadline() const
+{
+    return gap_since != 0 ? gap_since + counters.target_delay : -1;
+}
+
+JitterBufferStats JitterBuffer::stats() const
+{
+    return counters;
+}
+
+void JitterBuffer::reset(uint64_t sequence)
+{
+    for (auto &slot : slots)
+    {
+        slot.filled = false;
+    }
+    next_sequence = sequence;
+    highest_sequence = sequence - 1;
+    gap_since = 0;
+}
+
+void JitterBuffer::updateTargetDelay()
+{
+    counters.target_delay = std::min(std::max(std::max(reorder_delay, 2 * counters.jitter),
+                                              kMinTargetDelay),
+                                     kMaxTargetDelay);
+}
@@ -0,0 +1,124 @@
+#include "include/renderer/latency_watchdog.h"
+
+#include <cstdio>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    // More pictures than this queued in the decoder means some were
+    // discarded there without output; the oldest records are stale.
+    const size_t kMaxInFlight = 64;
+}
+
+void LatencyWatchdog::configure(int64_t budget, bool request_keyframe)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->budget = budget;
+    this->request_keyframe = request_keyframe;
+    if (budget == 0)
+    {
+        in_flight.clear();
+    }
+}
+
+bool LatencyWatchdog::enabled()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return budget > 0;
+}
+
+bool LatencyWatchdog::requestsKeyframe()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return request_keyframe;
+}
+
+bool LatencyWatchdog::admit(int type)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (hevcIsIrap(type))
+    {
+        state = state == SKIP_TO_IRAP ? SKIP_RASL : PASS;
+        return true;
+    }
+    const bool rasl = type == HEVC_NAL_RASL_N || type == HEVC_NAL_RASL_R;
+    const bool leading = type >= HEVC_NAL_RADL_N && type <= HEVC_NAL_RASL_R;
+    if (state == SKIP_RASL && !leading)
+    {
+        state = PASS;
+    }
+    // The state follows the stream while disabled, so enabling the
+    // watchdog mid-stream does not hold anything back.
+    if (budget > 0 && (state == SKIP_TO_IRAP || (state == SKIP_RASL && rasl)))
+    {
+        counters.pictures_dropped++;
+        return false;
+    }
+    return true;
+}
+
+void LatencyWatchdog::onPicturesQueued(int count, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (budget == 0)
+    {
+        return;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        in_flight.push_back(now);
+    }
+    while (in_flight.size() > kMaxInFlight)
+    {
+        in_flight.pop_front();
+    }
+}
+
+void LatencyWatchdog::onFrameDecoded()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!in_flight.empty())
+    {
+        in_flight.pop_front();
+    }
+}
+
+void LatencyWatchdog::onDecoderReset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    in_flight.clear();
+}
+
+bool LatencyWatchdog::expired(int64_t now, int64_t oldest_frame_time)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    this->oldest_frame_time = oldest_frame_time;
+    if (budget == 0 || state == SKIP_TO_IRAP)
+    {
+        return false;
+    }
+    const int64_t picture_age = in_flight.empty() ? 0 : now - in_flight.front();
+    const int64_t frame_age = oldest_frame_time < 0 ? 0 : now - oldest_frame_time;
+    if (picture_age <= budget && frame_age <= budget)
+    {
+        return false;
+    }
+
+    counters.resets++;
+    fprintf(stderr, "Latency budget of %lld ms exceeded (decoder %lld ms, display %lld ms behind), skipping to the next IRAP (reset %llu)\n",
+            (long long)budget / 1000, (long long)picture_age / 1000, (long long)frame_age / 1000,
+            (unsigned long long)counters.resets);
+    state = SKIP_TO_IRAP;
+    in_flight.clear();
+    return true;
+}
+
+WatchdogStats LatencyWatchdog::stats(int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    WatchdogStats result = counters;
+    result.oldest_picture_age = in_flight.empty() ? 0 : now - in_flight.front();
+    result.oldest_frame_age = oldest_frame_time < 0 ? 0 : now - oldest_frame_time;
+    return result;
+}
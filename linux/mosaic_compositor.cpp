@@ -0,0 +1,170 @@
+#include <GL/glew.h>
+#include "include/renderer/mosaic_compositor.h"
+
+#include <algorithm>
+
+#include "include/renderer/fl_my_texture_gl.h"
+#include "include/renderer/h265_decoder.h"
+#include "include/renderer/opengl_renderer.h"
+#include "include/renderer/texture_swap_chain.h"
+#include "include/renderer/upload_thread.h"
+
+MosaicCompositor::MosaicCompositor(GdkWindow *window, FlTextureRegistrar *texture_registrar, UploadThread *upload_thread)
+{
+    this->window = window;
+    this->texture_registrar = texture_registrar;
+    this->upload_thread = upload_thread;
+}
+
+MosaicCompositor::~MosaicCompositor()
+{
+    setLayout({});
+    if (update_handler != 0)
+    {
+        g_signal_handler_disconnect(frame_clock, update_handler);
+    }
+    if (texture)
+    {
+        fl_texture_registrar_unregister_texture(texture_registrar, texture);
+        // Runs after any composition still queued.
+        upload_thread->invoke([this]()
+                              {
+            std::vector<GLuint> names = swap_chain->names();
+            glDeleteTextures(names.size(), names.data());
+            renderer.reset(); });
+        g_object_unref(texture);
+    }
+}
+
+FlTexture *MosaicCompositor::init(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    swap_chain = new TextureSwapChain();
+    // The atlas is blank until a layout is set, and has a buffer to show
+    // before it is registered.
+    upload_thread->invoke([this, width, height]()
+                          {
+        renderer = std::make_shared<OpenGLRenderer>(upload_thread->glContext());
+        const int index = swap_chain->acquire();
+        const GLuint name = renderer->genTexture(width, height, true);
+        swap_chain->setBuffer(index, name, width, height);
+        swap_chain->publish(index); });
+    texture = FL_TEXTURE(fl_my_texture_gl_new(GL_TEXTURE_2D, swap_chain));
+    fl_texture_registrar_register_texture(texture_registrar, texture);
+
+    // Connected after the sessions' own handlers, so the composition is
+    // queued behind the uploads of the same refresh.
+    frame_clock = gdk_window_get_frame_clock(window);
+    update_handler = g_signal_connect_after(
+        frame_clock, "update",
+        G_CALLBACK(+[](GdkFrameClock *, gpointer user_data)
+                   { static_cast<MosaicCompositor *>(user_data)->requestCompose(); }),
+        this);
+    updateFrameClock();
+    return texture;
+}
+
+void MosaicCompositor::setLayout(const std::vector<MosaicTile> &tiles)
+{
+    for (const MosaicTile &tile : this->tiles)
+    {
+        auto kept = std::find_if(tiles.begin(), tiles.end(), [&tile](const MosaicTile &other)
+                                 { return other.session == tile.session; });
+        if (kept == tiles.end())
+        {
+            tile.session->setFrameListener(nullptr);
+        }
+    }
+    for (const MosaicTile &tile : tiles)
+    {
+        tile.session->setFrameListener([this]()
+                                       { dirty = true; });
+    }
+    upload_thread->invoke([this, &tiles]()
+                          { this->tiles = tiles; });
+    dirty = true;
+    layout_empty = tiles.empty();
+    updateFrameClock();
+    if (layout_empty && texture)
+    {
+        // Drawn blank once more, as the clock no longer runs.
+        requestCompose();
+    }
+}
+
+void MosaicCompositor::updateFrameClock()
+{
+    // Refreshes only drive compositions while there are tiles to redraw.
+    const bool run = !layout_empty;
+    if (frame_clock == nullptr || run == frame_clock_running)
+    {
+        return;
+    }
+    frame_clock_running = run;
+    if (run)
+    {
+        gdk_frame_clock_begin_updating(frame_clock);
+    }
+    else
+    {
+        gdk_frame_clock_end_updating(frame_clock);
+    }
+}
+
+void MosaicCompositor::requestCompose()
+{
+    if (!compose_pending.exchange(true))
+    {
+        upload_thread->post([this]()
+                            { compose(); });
+    }
+}
+
+void MosaicCompositor::removeSession(H265Decoder *session)
+{
+    std::vector<MosaicTile> kept;
+    for (const MosaicTile &tile : tiles)
+    {
+        if (tile.session != session)
+        {
+            kept.push_back(tile);
+        }
+    }
+    if (kept.size() != tiles.size())
+    {
+        setLayout(kept);
+    }
+}
+
+void MosaicCompositor::compose()
+{
+    compose_pending = false;
+    if (!dirty.exchange(false))
+    {
+        return;
+    }
+
+    const int index = swap_chain->acquire();
+    SwapChainBuffer buffer = swap_chain->buffer(index);
+    if (buffer.name == 0)
+    {
+        buffer.name = renderer->genTexture(width, height);
+        swap_chain->setBuffer(index, buffer.name, width, height);
+    }
+    // Buffers rotate, so each one is redrawn whole.
+    renderer->clearTexture(buffer.name);
+    for (const MosaicTile &tile : tiles)
+    {
+        // The session's newest completed frame; its swap chain treats the
+        // compositor as its consumer.
+        uint32_t name, frame_width, frame_height;
+        if (tile.session->swapChain()->latest(&name, &frame_width, &frame_height))
+        {
+            renderer->drawTexture(name, frame_width, frame_height,
+                                  buffer.name, tile.x, tile.y, tile.width, tile.height, false);
+        }
+    }
+    swap_chain->publish(index);
+    fl_texture_registrar_mark_texture_frame_available(texture_registrar, texture);
+}
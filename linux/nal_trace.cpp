@@ -0,0 +1,280 @@
+#include "include/renderer/nal_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+    const char kTraceMagic[4] = {'N', 'A', 'L', 'T'};
+    const uint32_t kTraceVersion = 1;
+    const size_t kChunkSize = 1024 * 1024;
+    // About a second of a high-bitrate stream may be waiting for the disk.
+    const size_t kMaxFullChunks = 8;
+
+    void putVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(uint8_t(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(uint8_t(value));
+    }
+
+    bool getVarint(FILE *file, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const int byte = fgetc(file);
+            if (byte == EOF)
+            {
+                return false;
+            }
+            value |= uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int64_t monotonicTime()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+}
+
+NalTraceRecorder::~NalTraceRecorder()
+{
+    stop();
+}
+
+bool NalTraceRecorder::start(const char *path)
+{
+    stop();
+    file = fopen(path, "wb");
+    if (!file)
+    {
+        perror("Failed to open NAL trace for writing");
+        return false;
+    }
+    uint8_t header[8];
+    memcpy(header, kTraceMagic, 4);
+    for (int i = 0; i < 4; i++)
+    {
+        header[4 + i] = uint8_t(kTraceVersion >> (8 * i));
+    }
+    fwrite(header, sizeof(header), 1, file);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    counters = NalTraceStats();
+    last_time = 0;
+    chunk.clear();
+    chunk.reserve(kChunkSize);
+    running = true;
+    thread = std::thread([this]()
+                         { run(); });
+    return true;
+}
+
+void NalTraceRecorder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+        {
+            return;
+        }
+        flushChunk();
+        running = false;
+    }
+    condition.notify_one();
+    thread.join();
+    fclose(file);
+    file = nullptr;
+}
+
+void NalTraceRecorder::append(const uint8_t *data, size_t size, int64_t pts, int64_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running)
+    {
+        return;
+    }
+    if (full_chunks.size() >= kMaxFullChunks)
+    {
+        counters.dropped++;
+        return;
+    }
+
+    putVarint(chunk, last_time == 0 ? 0 : now - last_time);
+    putVarint(chunk, pts < 0 ? 0 : pts + 1);
+    putVarint(chunk, size);
+    chunk.insert(chunk.end(), data, data + size);
+    last_time = now;
+    counters.records++;
+    counters.bytes += size;
+
+    if (chunk.size() >= kChunkSize)
+    {
+        flushChunk();
+        condition.notify_one();
+    }
+}
+
+NalTraceStats NalTraceRecorder::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void NalTraceRecorder::flushChunk()
+{
+    if (chunk.empty())
+    {
+        return;
+    }
+    full_chunks.push_back(std::move(chunk));
+    if (free_chunks.empty())
+    {
+        chunk = std::vector<uint8_t>();
+        chunk.reserve(kChunkSize);
+    }
+    else
+    {
+        chunk = std::move(free_chunks.back());
+        free_chunks.pop_back();
+    }
+}
+
+void NalTraceRecorder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]()
+                       { return !running || !full_chunks.empty(); });
+        if (full_chunks.empty())
+        {
+            break;
+        }
+        std::vector<uint8_t> buffer = std::move(full_chunks.front());
+        full_chunks.pop_front();
+
+        lock.unlock();
+        fwrite(buffer.data(), buffer.size(), 1, file);
+        buffer.clear();
+        lock.lock();
+        free_chunks.push_back(std::move(buffer));
+    }
+}
+
+NalTracePlayer::NalTracePlayer(NalCallback callback, FinishedCallback finished)
+    : callback(std::move(callback)), finished(std::move(finished))
+{
+}
+
+NalTracePlayer::~NalTracePlayer()
+{
+    stop();
+}
+
+bool NalTracePlayer::start(const char *path, double speed)
+{
+    stop();
+    file = fopen(path, "rb");
+    uint8_t header[8];
+    if (!file || fread(header, sizeof(header), 1, file) != 1 || memcmp(header, kTraceMagic, 4) != 0)
+    {
+        fprintf(stderr, "Not a NAL trace: %s\n", path);
+        if (file)
+        {
+            fclose(file);
+            file = nullptr;
+        }
+        return false;
+    }
+
+    running = true;
+    thread = std::thread([this, speed]()
+                         { run(speed); });
+    return true;
+}
+
+void NalTracePlayer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    condition.notify_one();
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    if (file)
+    {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void NalTracePlayer::run(double speed)
+{
+    const int64_t start = monotonicTime();
+    int64_t recorded_time = 0;
+    std::vector<uint8_t> data;
+    NalTraceStats stats;
+
+    // Record sizes come from the file, so none may claim more than is left
+    // of it.
+    const long data_start = ftell(file);
+    fseek(file, 0, SEEK_END);
+    const uint64_t file_size = uint64_t(std::max(ftell(file), data_start));
+    fseek(file, data_start, SEEK_SET);
+
+    uint64_t delta, pts, size;
+    while (getVarint(file, delta) && getVarint(file, pts) && getVarint(file, size))
+    {
+        if (size > file_size - uint64_t(ftell(file)))
+        {
+            fprintf(stderr, "NAL trace record overruns the file, stopping replay\n");
+            break;
+        }
+        data.resize(size);
+        if (fread(data.data(), 1, size, file) != size)
+        {
+            break;
+        }
+
+        recorded_time += delta;
+        if (speed > 0)
+        {
+            const auto due = std::chrono::steady_clock::time_point(
+                std::chrono::microseconds(start + int64_t(recorded_time / speed)));
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait_until(lock, due, [this]()
+                                 { return !running; });
+        }
+        if (!running)
+        {
+            return;
+        }
+
+        int64_t record_pts = -1;
+        if (pts != 0 && speed > 0)
+        {
+            record_pts = int64_t((pts - 1) / speed);
+        }
+        callback(data.data(), data.size(), record_pts);
+        stats.records++;
+        stats.bytes += size;
+    }
+
+    finished(stats, monotonicTime() - start);
+}
@@ -1 +1,461 @@
-#include "include/renderer/opengl_renderer.h"
\ No newline at end of file
+#include "include/renderer/opengl_renderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // A quad over the whole viewport from gl_VertexID alone, so the pass
+    // needs no vertex buffer. Texture coordinates keep row 0 of the source
+    // in row 0 of the target.
+    const char *kVertexShader = R"(#version 150
+out vec2 uv;
+void main()
+{
+    vec2 position = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    uv = position;
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+    // Four bilinear taps spread over each target pixel average up to 4x4
+    // source texels, a cheap stand-in for an area filter when scaling down.
+    // transform maps target texture coordinates to source ones.
+    const char *kFragmentShader = R"(#version 150
+uniform sampler2D source;
+uniform vec2 footprint;
+uniform bool grey;
+uniform mat3 transform;
+in vec2 uv;
+out vec4 color;
+vec4 tap(vec2 offset)
+{
+    return texture(source, (transform * vec3(uv + offset, 1.0)).xy);
+}
+void main()
+{
+    color = 0.25 * (tap(vec2(-footprint.x, -footprint.y)) + tap(vec2(footprint.x, -footprint.y)) +
+                    tap(vec2(-footprint.x, footprint.y)) + tap(vec2(footprint.x, footprint.y)));
+    if (grey)
+    {
+        float luma = dot(color.rgb, vec3(0.2126, 0.7152, 0.0722));
+        color = vec4(vec3(luma), color.a);
+    }
+}
+)";
+
+    // Solid fills, or a box of the label texture at label_rect (offset and
+    // size in texture coordinates). Both are premultiplied for blending.
+    const char *kOverlayFragmentShader = R"(#version 150
+uniform sampler2D labels;
+uniform vec4 color;
+uniform vec4 label_rect;
+in vec2 uv;
+out vec4 result;
+void main()
+{
+    result = label_rect.z > 0.0 ? texture(labels, label_rect.xy + uv * label_rect.zw) : color;
+}
+)";
+
+    // The affine map from target to source texture coordinates, as a
+    // column-major 3x3 matrix: mirroring is undone first, then the turns.
+    void sourceMatrix(const SourceTransform &transform, float matrix[9])
+    {
+        float a[4] = {1, 0, 0, 1};
+        float b[2] = {0, 0};
+        if (transform.mirror)
+        {
+            a[0] = -1;
+            b[0] = 1;
+        }
+        // Source coordinates of target (u, v) after turning clockwise:
+        // (v, 1 - u), (1 - u, 1 - v) and (1 - v, u).
+        static const float kTurns[4][6] = {
+            {1, 0, 0, 1, 0, 0},
+            {0, 1, -1, 0, 0, 1},
+            {-1, 0, 0, -1, 1, 1},
+            {0, -1, 1, 0, 1, 0},
+        };
+        const float *r = kTurns[((transform.quarter_turns % 4) + 4) % 4];
+        matrix[0] = r[0] * a[0] + r[1] * a[2];
+        matrix[1] = r[2] * a[0] + r[3] * a[2];
+        matrix[2] = 0;
+        matrix[3] = r[0] * a[1] + r[1] * a[3];
+        matrix[4] = r[2] * a[1] + r[3] * a[3];
+        matrix[5] = 0;
+        matrix[6] = r[0] * b[0] + r[1] * b[1] + r[4];
+        matrix[7] = r[2] * b[0] + r[3] * b[1] + r[5];
+        matrix[8] = 1;
+    }
+
+    // Offset of the taps from a target pixel's centre, in target texture
+    // coordinates: a quarter pixel once each pixel covers two or more source
+    // texels, shrinking to none at 1:1 so unscaled draws stay sharp.
+    float tapOffset(float texels_per_pixel, int size)
+    {
+        return 0.25f * std::min(1.0f, std::max(0.0f, texels_per_pixel - 1)) / size;
+    }
+
+    GLuint compileShader(GLenum type, const char *source)
+    {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, nullptr);
+        glCompileShader(shader);
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            char log[512];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cerr << "Failed to compile shader: " << log << std::endl;
+            glDeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+
+    // Links the full-viewport quad with fragment_source; 0 on failure.
+    GLuint linkProgram(const char *fragment_source)
+    {
+        GLuint vertex_shader = compileShader(GL_VERTEX_SHADER, kVertexShader);
+        GLuint fragment_shader = compileShader(GL_FRAGMENT_SHADER, fragment_source);
+        if (vertex_shader == 0 || fragment_shader == 0)
+        {
+            glDeleteShader(vertex_shader);
+            glDeleteShader(fragment_shader);
+            return 0;
+        }
+
+        GLuint linked = glCreateProgram();
+        glAttachShader(linked, vertex_shader);
+        glAttachShader(linked, fragment_shader);
+        glLinkProgram(linked);
+        glDeleteShader(vertex_shader);
+        glDeleteShader(fragment_shader);
+        GLint status = GL_FALSE;
+        glGetProgramiv(linked, GL_LINK_STATUS, &status);
+        if (status != GL_TRUE)
+        {
+            char log[512];
+            glGetProgramInfoLog(linked, sizeof(log), nullptr, log);
+            std::cerr << "Failed to link draw program: " << log << std::endl;
+            glDeleteProgram(linked);
+            return 0;
+        }
+        return linked;
+    }
+
+    void premultiplied(uint32_t argb, float rgba[4])
+    {
+        const float alpha = (argb >> 24) / 255.0f;
+        rgba[0] = ((argb >> 16) & 0xff) / 255.0f * alpha;
+        rgba[1] = ((argb >> 8) & 0xff) / 255.0f * alpha;
+        rgba[2] = (argb & 0xff) / 255.0f * alpha;
+        rgba[3] = alpha;
+    }
+
+    void setCairoColor(cairo_t *cairo, uint32_t argb)
+    {
+        cairo_set_source_rgba(cairo, ((argb >> 16) & 0xff) / 255.0, ((argb >> 8) & 0xff) / 255.0,
+                              (argb & 0xff) / 255.0, (argb >> 24) / 255.0);
+    }
+
+    const int kLabelPadding = 3;
+    // Labels past this height of the label texture are left out.
+    const int kMaxLabelTextureSize = 4096;
+}
+
+bool OpenGLRenderer::createProgram()
+{
+    if (program != 0)
+    {
+        return true;
+    }
+    program = linkProgram(kFragmentShader);
+    if (program == 0)
+    {
+        return false;
+    }
+    footprint_location = glGetUniformLocation(program, "footprint");
+    grey_location = glGetUniformLocation(program, "grey");
+    transform_location = glGetUniformLocation(program, "transform");
+    if (vertex_array == 0)
+    {
+        glGenVertexArrays(1, &vertex_array);
+    }
+    if (framebuffer == 0)
+    {
+        glGenFramebuffers(1, &framebuffer);
+    }
+    return true;
+}
+
+bool OpenGLRenderer::createOverlayProgram()
+{
+    if (overlay_program != 0)
+    {
+        return true;
+    }
+    overlay_program = linkProgram(kOverlayFragmentShader);
+    if (overlay_program == 0)
+    {
+        return false;
+    }
+    overlay_color_location = glGetUniformLocation(overlay_program, "color");
+    overlay_label_rect_location = glGetUniformLocation(overlay_program, "label_rect");
+    if (vertex_array == 0)
+    {
+        glGenVertexArrays(1, &vertex_array);
+    }
+    if (framebuffer == 0)
+    {
+        glGenFramebuffers(1, &framebuffer);
+    }
+    return true;
+}
+
+bool OpenGLRenderer::drawTexture(GLuint source, int source_width, int source_height,
+                                 GLuint target, int x, int y, int width, int height, bool grey,
+                                 const SourceTransform &transform)
+{
+    if (!createProgram())
+    {
+        return false;
+    }
+    float matrix[9];
+    sourceMatrix(transform, matrix);
+    // Source texels covered by one target pixel along each target axis.
+    const float texels_x = std::hypot(matrix[0] * source_width, matrix[1] * source_height) / width;
+    const float texels_y = std::hypot(matrix[3] * source_width, matrix[4] * source_height) / height;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glViewport(x, y, width, height);
+
+    glUseProgram(program);
+    glUniform2f(footprint_location, tapOffset(texels_x, width), tapOffset(texels_y, height));
+    glUniform1i(grey_location, grey);
+    glUniformMatrix3fv(transform_location, 1, GL_FALSE, matrix);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source);
+    glBindVertexArray(vertex_array);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+void OpenGLRenderer::rasterizeLabels(const Overlay &overlay)
+{
+    label_overlay_id = overlay.id;
+    label_boxes.clear();
+    if (overlay.labels.empty())
+    {
+        return;
+    }
+
+    // Measure first, then stack the labels in one surface.
+    cairo_surface_t *scratch = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    cairo_t *cairo = cairo_create(scratch);
+    cairo_select_font_face(cairo, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    int atlas_width = 1;
+    int atlas_height = 0;
+    for (const OverlayLabel &label : overlay.labels)
+    {
+        cairo_set_font_size(cairo, label.font_size);
+        cairo_font_extents_t font;
+        cairo_text_extents_t text;
+        cairo_font_extents(cairo, &font);
+        cairo_text_extents(cairo, label.text.c_str(), &text);
+        LabelBox box;
+        box.y = atlas_height;
+        box.width = std::min(kMaxLabelTextureSize, int(std::ceil(text.x_advance)) + 2 * kLabelPadding);
+        box.height = int(std::ceil(font.ascent + font.descent)) + 2 * kLabelPadding;
+        if (box.y + box.height > kMaxLabelTextureSize)
+        {
+            break;
+        }
+        label_boxes.push_back(box);
+        atlas_width = std::max(atlas_width, box.width);
+        atlas_height += box.height;
+    }
+    cairo_destroy(cairo);
+    cairo_surface_destroy(scratch);
+    if (label_boxes.empty())
+    {
+        return;
+    }
+
+    cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, atlas_width, atlas_height);
+    cairo = cairo_create(surface);
+    cairo_select_font_face(cairo, "sans-serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    for (size_t i = 0; i < label_boxes.size(); i++)
+    {
+        const OverlayLabel &label = overlay.labels[i];
+        const LabelBox &box = label_boxes[i];
+        setCairoColor(cairo, label.background);
+        cairo_rectangle(cairo, 0, box.y, box.width, box.height);
+        cairo_fill(cairo);
+        cairo_set_font_size(cairo, label.font_size);
+        cairo_font_extents_t font;
+        cairo_font_extents(cairo, &font);
+        setCairoColor(cairo, label.color);
+        cairo_move_to(cairo, kLabelPadding, box.y + kLabelPadding + font.ascent);
+        cairo_show_text(cairo, label.text.c_str());
+    }
+    cairo_destroy(cairo);
+    cairo_surface_flush(surface);
+
+    // Cairo's ARGB32 is premultiplied BGRA in memory on little-endian hosts.
+    if (label_texture == 0)
+    {
+        glGenTextures(1, &label_texture);
+    }
+    glBindTexture(GL_TEXTURE_2D, label_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride(surface) / 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlas_width, atlas_height, 0, GL_BGRA, GL_UNSIGNED_BYTE,
+                 cairo_image_surface_get_data(surface));
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    label_texture_width = atlas_width;
+    label_texture_height = atlas_height;
+    cairo_surface_destroy(surface);
+}
+
+bool OpenGLRenderer::drawOverlay(const Overlay &overlay, GLuint target, int width, int height)
+{
+    if (!createOverlayProgram())
+    {
+        return false;
+    }
+    if (overlay.id != label_overlay_id)
+    {
+        rasterizeLabels(overlay);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(overlay_program);
+    glBindVertexArray(vertex_array);
+
+    // Each rectangle, or side of one, is a viewport-sized quad.
+    glUniform4f(overlay_label_rect_location, 0, 0, 0, 0);
+    auto fill = [](int x, int y, int w, int h)
+    {
+        if (w > 0 && h > 0)
+        {
+            glViewport(x, y, w, h);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+    };
+    for (const OverlayRect &rect : overlay.rects)
+    {
+        float color[4];
+        premultiplied(rect.color, color);
+        glUniform4fv(overlay_color_location, 1, color);
+        const int x = int(std::lround(rect.x * width));
+        const int y = int(std::lround(rect.y * height));
+        const int w = int(std::lround((rect.x + rect.width) * width)) - x;
+        const int h = int(std::lround((rect.y + rect.height) * height)) - y;
+        const int stroke = int(std::lround(rect.stroke_width));
+        if (stroke <= 0 || 2 * stroke >= w || 2 * stroke >= h)
+        {
+            fill(x, y, w, h);
+            continue;
+        }
+        fill(x, y, w, stroke);
+        fill(x, y + h - stroke, w, stroke);
+        fill(x, y + stroke, stroke, h - 2 * stroke);
+        fill(x + w - stroke, y + stroke, stroke, h - 2 * stroke);
+    }
+
+    if (!label_boxes.empty())
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, label_texture);
+        for (size_t i = 0; i < label_boxes.size(); i++)
+        {
+            const LabelBox &box = label_boxes[i];
+            glUniform4f(overlay_label_rect_location, 0, float(box.y) / label_texture_height,
+                        float(box.width) / label_texture_width, float(box.height) / label_texture_height);
+            fill(int(std::lround(overlay.labels[i].x * width)), int(std::lround(overlay.labels[i].y * height)),
+                 box.width, box.height);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glDisable(GL_BLEND);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return true;
+}
+
+Readback OpenGLRenderer::startReadback(GLuint texture, int width, int height)
+{
+    Readback readback;
+    readback.width = width;
+    readback.height = height;
+    if (framebuffer == 0)
+    {
+        glGenFramebuffers(1, &framebuffer);
+    }
+    glGenBuffers(1, &readback.buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(width) * height * 4, nullptr, GL_STREAM_READ);
+
+    // With a pack buffer bound glReadPixels only queues the copy.
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    return readback;
+}
+
+bool OpenGLRenderer::finishReadback(Readback &readback, std::vector<uint8_t> &pixels, GLuint64 timeout)
+{
+    const GLenum status = glClientWaitSync(readback.fence, 0, timeout);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        return false;
+    }
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    pixels.clear();
+    if (status != GL_WAIT_FAILED)
+    {
+        const size_t size = static_cast<size_t>(readback.width) * readback.height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const uint8_t *data = static_cast<const uint8_t *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT));
+        if (data)
+        {
+            pixels.assign(data, data + size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &readback.buffer);
+    readback.buffer = 0;
+    return true;
+}
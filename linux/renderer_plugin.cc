@@ -1,13 +1,24 @@
 #include <GL/glew.h>
 #include "include/renderer/renderer_plugin.h"
 #include "include/renderer/h265_decoder.h"
+#include "include/renderer/mosaic_compositor.h"
+#include "include/renderer/snapshot_encoder.h"
+#include "include/renderer/thumbnail_service.h"
+#include "include/renderer/upload_thread.h"
 
 #include <flutter_linux/flutter_linux.h>
 #include <gtk/gtk.h>
 
 #include <cstring>
+#include <map>
+#include <memory>
 
-H265Decoder *decoder;
+// Decoding sessions by texture id. Calls that name no textureId go to the
+// one created by "init".
+static std::map<int64_t, H265Decoder *> sessions;
+static int64_t default_session = 0;
+// Atlas textures by texture id.
+static std::map<int64_t, MosaicCompositor *> mosaics;
 
 #define RENDERER_PLUGIN(obj)                                     \
   (G_TYPE_CHECK_INSTANCE_CAST((obj), renderer_plugin_get_type(), \
@@ -18,12 +29,161 @@ struct _RendererPlugin
   GObject parent_instance;
   FlTextureRegistrar *texture_registrar;
   FlView *fl_view;
+  UploadThread *upload_thread;
+  FlEventChannel *event_channel;
+  ThumbnailService *thumbnail_service;
+  SnapshotEncoder *snapshot_encoder;
 };
 
 G_DEFINE_TYPE(RendererPlugin,
               renderer_plugin,
               g_object_get_type())
 
+static H265Decoder *find_session(FlValue *args)
+{
+  FlValue *id_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "textureId") : NULL;
+  const int64_t id = id_value != NULL && fl_value_get_type(id_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(id_value) : default_session;
+  auto it = sessions.find(id);
+  return it != sessions.end() ? it->second : nullptr;
+}
+
+static void delete_session(int64_t id)
+{
+  auto it = sessions.find(id);
+  if (it != sessions.end())
+  {
+    for (auto &mosaic : mosaics)
+    {
+      mosaic.second->removeSession(it->second);
+    }
+    delete it->second;
+    sessions.erase(it);
+  }
+}
+
+// Mosaics go first, as they refer to sessions.
+static void delete_all_sessions()
+{
+  for (auto &mosaic : mosaics)
+  {
+    delete mosaic.second;
+  }
+  mosaics.clear();
+  for (auto &session : sessions)
+  {
+    delete session.second;
+  }
+  sessions.clear();
+}
+
+static FlMethodResponse *decoder_not_initialized_response()
+{
+  g_autoptr(FlValue) error_message = fl_value_new_string("Decoder has not been initialized");
+  return FL_METHOD_RESPONSE(fl_method_error_response_new(
+      "BAD_STATE", "Decoder has not been initialized", error_message));
+}
+
+// Whether value is a list of count values of the given types.
+static bool list_has_types(FlValue *value, const FlValueType *types, size_t count)
+{
+  if (fl_value_get_type(value) != FL_VALUE_TYPE_LIST || fl_value_get_length(value) != count)
+  {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++)
+  {
+    if (fl_value_get_type(fl_value_get_list_value(value, i)) != types[i])
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Sends event on the main thread; takes ownership of it. Safe to call from
+// any thread.
+static void send_event_later(FlEventChannel *event_channel, FlValue *event)
+{
+  struct PendingEvent
+  {
+    FlEventChannel *channel;
+    FlValue *event;
+  };
+  g_idle_add_full(
+      G_PRIORITY_DEFAULT,
+      +[](gpointer user_data) -> gboolean
+      {
+        PendingEvent *pending = static_cast<PendingEvent *>(user_data);
+        fl_event_channel_send(pending->channel, pending->event, nullptr, nullptr);
+        return G_SOURCE_REMOVE;
+      },
+      new PendingEvent{FL_EVENT_CHANNEL(g_object_ref(event_channel)), event},
+      +[](gpointer user_data)
+      {
+        PendingEvent *pending = static_cast<PendingEvent *>(user_data);
+        g_object_unref(pending->channel);
+        fl_value_unref(pending->event);
+        delete pending;
+      });
+}
+
+// Answers method_call on the main thread; takes ownership of response. Safe
+// to call from any thread.
+static void respond_later(FlMethodCall *method_call, FlMethodResponse *response)
+{
+  struct PendingResponse
+  {
+    FlMethodCall *method_call;
+    FlMethodResponse *response;
+  };
+  g_idle_add_full(
+      G_PRIORITY_DEFAULT,
+      +[](gpointer user_data) -> gboolean
+      {
+        PendingResponse *pending = static_cast<PendingResponse *>(user_data);
+        fl_method_call_respond(pending->method_call, pending->response, nullptr);
+        return G_SOURCE_REMOVE;
+      },
+      new PendingResponse{FL_METHOD_CALL(g_object_ref(method_call)), response},
+      +[](gpointer user_data)
+      {
+        PendingResponse *pending = static_cast<PendingResponse *>(user_data);
+        g_object_unref(pending->method_call);
+        g_object_unref(pending->response);
+        delete pending;
+      });
+}
+
+static ThumbnailService *thumbnail_service_new(FlEventChannel *event_channel)
+{
+  gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "streamline_renderer", nullptr);
+  g_mkdir_with_parents(cache_dir, 0755);
+  ThumbnailService *service = new ThumbnailService(
+      cache_dir,
+      [event_channel](const Thumbnail &thumbnail)
+      {
+        FlValue *event = fl_value_new_map();
+        fl_value_set_string_take(event, "event", fl_value_new_string("thumbnail"));
+        fl_value_set_string_take(event, "requestId", fl_value_new_int(thumbnail.request_id));
+        fl_value_set_string_take(event, "position", fl_value_new_int(thumbnail.position));
+        fl_value_set_string_take(event, "keyframePosition", fl_value_new_int(thumbnail.keyframe_position));
+        fl_value_set_string_take(event, "width", fl_value_new_int(thumbnail.width));
+        fl_value_set_string_take(event, "height", fl_value_new_int(thumbnail.height));
+        fl_value_set_string_take(event, "format", fl_value_new_string(thumbnail.format == THUMBNAIL_FORMAT_JPEG ? "jpeg" : "rgba"));
+        fl_value_set_string_take(event, "data", fl_value_new_uint8_list(thumbnail.data.data(), thumbnail.data.size()));
+        send_event_later(event_channel, event);
+      },
+      [event_channel](int request_id)
+      {
+        FlValue *event = fl_value_new_map();
+        fl_value_set_string_take(event, "event", fl_value_new_string("thumbnailsDone"));
+        fl_value_set_string_take(event, "requestId", fl_value_new_int(request_id));
+        send_event_later(event_channel, event);
+      });
+  g_free(cache_dir);
+  return service;
+}
+
 // Called when a method call is received from Flutter.
 static void renderer_plugin_handle_method_call(
     RendererPlugin *self,
@@ -32,40 +192,76 @@ static void renderer_plugin_handle_method_call(
   g_autoptr(FlMethodResponse) response = nullptr;
 
   const gchar *method = fl_method_call_get_name(method_call);
+  H265Decoder *decoder = find_session(fl_method_call_get_args(method_call));
 
-  if (strcmp(method, "init") == 0)
+  // "init" replaces the default session; "createSession" adds another.
+  if (strcmp(method, "init") == 0 || strcmp(method, "createSession") == 0)
   {
-    glewExperimental = GL_TRUE; // Optional, enables more extensions
-    if (glewInit() != GLEW_OK)
+    GdkWindow *window = gtk_widget_get_parent_window(GTK_WIDGET(self->fl_view));
+    if (self->upload_thread == nullptr)
     {
-      g_autoptr(FlValue) error_message = fl_value_new_string("Missing width or height parameter");
-      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
-          "FAILURE", "Failed to init GLEW", error_message));
+      self->upload_thread = new UploadThread(window);
     }
-
-    GdkWindow *window = gtk_widget_get_parent_window(GTK_WIDGET(self->fl_view));
-    decoder = new H265Decoder(window, self->texture_registrar);
     FlValue *args = fl_method_call_get_args(method_call);
     FlValue *width_value = fl_value_lookup_string(args, "width");
     FlValue *height_value = fl_value_lookup_string(args, "height");
-    if (width_value == NULL || height_value == NULL)
+    if (!self->upload_thread->isReady())
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Failed to init GLEW");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "FAILURE", "Failed to init GLEW", error_message));
+    }
+    else if (width_value == NULL || height_value == NULL)
     {
       g_autoptr(FlValue) error_message = fl_value_new_string("Missing width or height parameter");
       response = FL_METHOD_RESPONSE(fl_method_error_response_new(
           "INVALID_ARGUMENT", "Missing width or height parameter", error_message));
     }
-    int width = fl_value_get_int(width_value);
-    int height = fl_value_get_int(height_value);
-    auto texture = decoder->init(width, height);
-    g_autoptr(FlValue) result =
-        fl_value_new_int(reinterpret_cast<int64_t>(texture));
-    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    else
+    {
+      const bool is_default = strcmp(method, "init") == 0;
+      if (is_default)
+      {
+        delete_session(default_session);
+      }
+      decoder = new H265Decoder(window, self->texture_registrar, self->upload_thread);
+      FlEventChannel *event_channel = self->event_channel;
+      decoder->setEventSink([event_channel](FlValue *event)
+                            { fl_event_channel_send(event_channel, event, nullptr, nullptr); });
+      int width = fl_value_get_int(width_value);
+      int height = fl_value_get_int(height_value);
+      auto texture = decoder->init(width, height);
+      const int64_t id = reinterpret_cast<int64_t>(texture);
+      sessions[id] = decoder;
+      if (is_default)
+      {
+        default_session = id;
+      }
+      g_autoptr(FlValue) result = fl_value_new_int(id);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
   }
   else if (strcmp(method, "addH265Nal") == 0)
   {
     FlValue *args = fl_method_call_get_args(method_call);
-    const uint8_t *nal = fl_value_get_uint8_list(args);
-    const size_t size = fl_value_get_length(args);
+    int64_t pts = -1;
+    if (fl_value_get_type(args) == FL_VALUE_TYPE_MAP)
+    {
+      // Timestamped NALs arrive as {nal, pts}, plain ones as the bare bytes.
+      FlValue *pts_value = fl_value_lookup_string(args, "pts");
+      if (pts_value != NULL && fl_value_get_type(pts_value) == FL_VALUE_TYPE_INT)
+      {
+        pts = fl_value_get_int(pts_value);
+      }
+      args = fl_value_lookup_string(args, "nal");
+    }
+    const uint8_t *nal = NULL;
+    size_t size = 0;
+    if (args != NULL && fl_value_get_type(args) == FL_VALUE_TYPE_UINT8_LIST)
+    {
+      nal = fl_value_get_uint8_list(args);
+      size = fl_value_get_length(args);
+    }
     if (nal == NULL)
     {
       g_autoptr(FlValue) error_message = fl_value_new_string("Missing h265 data argument");
@@ -76,20 +272,1033 @@ static void renderer_plugin_handle_method_call(
     {
       if (decoder == nullptr)
       {
-        g_autoptr(FlValue) error_message = fl_value_new_string("Decoder has not been initialized");
+        response = decoder_not_initialized_response();
+      }
+      else
+      {
+        decoder->addH265Nal(nal, size, pts);
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+      }
+    }
+  }
+  else if (strcmp(method, "getStats") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      PacingStats stats = decoder->stats();
+      g_autoptr(FlValue) result = fl_value_new_map();
+      fl_value_set_string_take(result, "framesPresented", fl_value_new_int(stats.frames_presented));
+      fl_value_set_string_take(result, "framesDropped", fl_value_new_int(stats.frames_dropped));
+      fl_value_set_string_take(result, "queuedFrames", fl_value_new_int(stats.queued_frames));
+      fl_value_set_string_take(result, "playoutDelayUs", fl_value_new_int(stats.playout_delay));
+      fl_value_set_string_take(result, "jitterUs", fl_value_new_int(stats.jitter));
+      fl_value_set_string_take(result, "latencyUs", fl_value_new_int(stats.latency));
+      fl_value_set_string_take(result, "pacingErrorUs", fl_value_new_int(stats.pacing_error));
+      RtpReceiverStats rtp_stats = decoder->rtpStats();
+      fl_value_set_string_take(result, "rtpPacketsReceived", fl_value_new_int(rtp_stats.packets_received));
+      fl_value_set_string_take(result, "rtpBytesReceived", fl_value_new_int(rtp_stats.bytes_received));
+      fl_value_set_string_take(result, "rtpAccessUnits", fl_value_new_int(rtp_stats.access_units));
+      fl_value_set_string_take(result, "rtpAccessUnitsSkipped", fl_value_new_int(rtp_stats.access_units_skipped));
+      fl_value_set_string_take(result, "rtpPacketsIgnored", fl_value_new_int(rtp_stats.packets_ignored));
+      fl_value_set_string_take(result, "rtpPacketsLost", fl_value_new_int(rtp_stats.jitter_buffer.packets_lost));
+      fl_value_set_string_take(result, "rtpPacketsReordered", fl_value_new_int(rtp_stats.jitter_buffer.packets_reordered));
+      fl_value_set_string_take(result, "rtpPacketsDuplicate", fl_value_new_int(rtp_stats.jitter_buffer.packets_duplicate));
+      fl_value_set_string_take(result, "rtpPacketsLate", fl_value_new_int(rtp_stats.jitter_buffer.packets_late));
+      fl_value_set_string_take(result, "rtpJitterUs", fl_value_new_int(rtp_stats.jitter_buffer.jitter));
+      fl_value_set_string_take(result, "rtpJitterBufferDelayUs", fl_value_new_int(rtp_stats.jitter_buffer.target_delay));
+      WatchdogStats watchdog_stats = decoder->watchdogStats();
+      fl_value_set_string_take(result, "watchdogResets", fl_value_new_int(watchdog_stats.resets));
+      fl_value_set_string_take(result, "watchdogPicturesDropped", fl_value_new_int(watchdog_stats.pictures_dropped));
+      fl_value_set_string_take(result, "oldestPictureAgeUs", fl_value_new_int(watchdog_stats.oldest_picture_age));
+      fl_value_set_string_take(result, "oldestFrameAgeUs", fl_value_new_int(watchdog_stats.oldest_frame_age));
+      SheddingStats shedding_stats = decoder->sheddingStats();
+      fl_value_set_string_take(result, "shedLevel", fl_value_new_int(shedding_stats.level));
+      fl_value_set_string_take(result, "picturesShed", fl_value_new_int(shedding_stats.pictures_shed));
+      fl_value_set_string_take(result, "decodeTimeUs", fl_value_new_int(shedding_stats.decode_time));
+      TimeshiftStats timeshift_stats = decoder->timeshiftStats();
+      fl_value_set_string_take(result, "timeshiftDurationUs", fl_value_new_int(timeshift_stats.duration));
+      fl_value_set_string_take(result, "timeshiftBytes", fl_value_new_int(timeshift_stats.bytes));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "setLatencyBudget") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *budget_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "budgetUs") : NULL;
+    FlValue *request_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "requestKeyframe") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (budget_value == NULL || fl_value_get_type(budget_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing budgetUs parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing budgetUs parameter", error_message));
+    }
+    else
+    {
+      bool request_keyframe = request_value != NULL && fl_value_get_type(request_value) == FL_VALUE_TYPE_BOOL &&
+                              fl_value_get_bool(request_value);
+      decoder->setLatencyBudget(fl_value_get_int(budget_value), request_keyframe);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "setOverloadPolicy") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *enabled_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "enabled") : NULL;
+    FlValue *queued_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "maxQueuedPictures") : NULL;
+    FlValue *decode_time_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "maxDecodeTimeUs") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (enabled_value == NULL || fl_value_get_type(enabled_value) != FL_VALUE_TYPE_BOOL ||
+             queued_value == NULL || fl_value_get_type(queued_value) != FL_VALUE_TYPE_INT ||
+             decode_time_value == NULL || fl_value_get_type(decode_time_value) != FL_VALUE_TYPE_INT ||
+             fl_value_get_int(queued_value) < 1 || fl_value_get_int(decode_time_value) < 1)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing or invalid overload policy parameters");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing or invalid overload policy parameters", error_message));
+    }
+    else
+    {
+      decoder->setOverloadPolicy(fl_value_get_bool(enabled_value), fl_value_get_int(queued_value),
+                                 fl_value_get_int(decode_time_value));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "setFrameTap") == 0)
+  {
+    // Width, height and interval default to 0, and the format to RGBA.
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *enabled_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "enabled") : NULL;
+    FlValue *interval_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "intervalUs") : NULL;
+    FlValue *width_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "width") : NULL;
+    FlValue *height_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "height") : NULL;
+    FlValue *format_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "format") : NULL;
+    TapConfig config;
+    config.interval = interval_value != NULL && fl_value_get_type(interval_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(interval_value) : 0;
+    config.width = width_value != NULL && fl_value_get_type(width_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(width_value) : 0;
+    config.height = height_value != NULL && fl_value_get_type(height_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(height_value) : 0;
+    const char *format = format_value != NULL && fl_value_get_type(format_value) == FL_VALUE_TYPE_STRING ? fl_value_get_string(format_value) : "rgba";
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (enabled_value == NULL || fl_value_get_type(enabled_value) != FL_VALUE_TYPE_BOOL ||
+             config.interval < 0 || config.width < 0 || config.height < 0 ||
+             (strcmp(format, "rgba") != 0 && strcmp(format, "grey") != 0))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing or invalid frame tap parameters");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing or invalid frame tap parameters", error_message));
+    }
+    else
+    {
+      config.enabled = fl_value_get_bool(enabled_value);
+      config.format = strcmp(format, "grey") == 0 ? TAP_FORMAT_GREY : TAP_FORMAT_RGBA;
+      decoder->setFrameTap(config, config.enabled);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "setOutputSize") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *width_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "width") : NULL;
+    FlValue *height_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "height") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (width_value == NULL || fl_value_get_type(width_value) != FL_VALUE_TYPE_INT ||
+             height_value == NULL || fl_value_get_type(height_value) != FL_VALUE_TYPE_INT ||
+             fl_value_get_int(width_value) < 0 || fl_value_get_int(height_value) < 0)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing width or height parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing width or height parameter", error_message));
+    }
+    else
+    {
+      decoder->setOutputSize(fl_value_get_int(width_value), fl_value_get_int(height_value));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "addOutput") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *width_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "width") : NULL;
+    FlValue *height_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "height") : NULL;
+    FlValue *format_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "format") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (width_value == NULL || fl_value_get_type(width_value) != FL_VALUE_TYPE_INT ||
+             height_value == NULL || fl_value_get_type(height_value) != FL_VALUE_TYPE_INT ||
+             fl_value_get_int(width_value) < 2 || fl_value_get_int(height_value) < 2)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing width or height parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing width or height parameter", error_message));
+    }
+    else
+    {
+      OutputFormat format = OUTPUT_FORMAT_RGBA;
+      if (format_value != NULL && fl_value_get_type(format_value) == FL_VALUE_TYPE_STRING &&
+          strcmp(fl_value_get_string(format_value), "grey") == 0)
+      {
+        format = OUTPUT_FORMAT_GREY;
+      }
+      g_autoptr(FlValue) result = fl_value_new_int(
+          decoder->addOutput(fl_value_get_int(width_value), fl_value_get_int(height_value), format));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "removeOutput") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *output_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "outputId") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (output_value == NULL || fl_value_get_type(output_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing outputId parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing outputId parameter", error_message));
+    }
+    else if (!decoder->removeOutput(fl_value_get_int(output_value)))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("No such output");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "No such output", error_message));
+    }
+    else
+    {
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "createMosaic") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *width_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "width") : NULL;
+    FlValue *height_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "height") : NULL;
+    if (self->upload_thread == nullptr || !self->upload_thread->isReady())
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (width_value == NULL || fl_value_get_type(width_value) != FL_VALUE_TYPE_INT ||
+             height_value == NULL || fl_value_get_type(height_value) != FL_VALUE_TYPE_INT ||
+             fl_value_get_int(width_value) < 1 || fl_value_get_int(height_value) < 1)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing width or height parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing width or height parameter", error_message));
+    }
+    else
+    {
+      GdkWindow *window = gtk_widget_get_parent_window(GTK_WIDGET(self->fl_view));
+      MosaicCompositor *mosaic = new MosaicCompositor(window, self->texture_registrar, self->upload_thread);
+      const int64_t id = reinterpret_cast<int64_t>(
+          mosaic->init(fl_value_get_int(width_value), fl_value_get_int(height_value)));
+      mosaics[id] = mosaic;
+      g_autoptr(FlValue) result = fl_value_new_int(id);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "setOverlay") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *pts_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "pts") : NULL;
+    FlValue *rects_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "rects") : NULL;
+    FlValue *labels_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "labels") : NULL;
+    Overlay overlay;
+    overlay.pts = pts_value != NULL && fl_value_get_type(pts_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(pts_value) : -1;
+    bool valid = (rects_value == NULL || fl_value_get_type(rects_value) == FL_VALUE_TYPE_LIST) &&
+                 (labels_value == NULL || fl_value_get_type(labels_value) == FL_VALUE_TYPE_LIST);
+    // Each rect is [x, y, width, height, color, strokeWidth].
+    static const FlValueType rect_types[] = {FL_VALUE_TYPE_FLOAT, FL_VALUE_TYPE_FLOAT, FL_VALUE_TYPE_FLOAT,
+                                             FL_VALUE_TYPE_FLOAT, FL_VALUE_TYPE_INT, FL_VALUE_TYPE_FLOAT};
+    for (size_t i = 0; valid && rects_value != NULL && i < fl_value_get_length(rects_value); i++)
+    {
+      FlValue *rect_value = fl_value_get_list_value(rects_value, i);
+      valid = list_has_types(rect_value, rect_types, 6);
+      if (valid)
+      {
+        OverlayRect rect;
+        rect.x = fl_value_get_float(fl_value_get_list_value(rect_value, 0));
+        rect.y = fl_value_get_float(fl_value_get_list_value(rect_value, 1));
+        rect.width = fl_value_get_float(fl_value_get_list_value(rect_value, 2));
+        rect.height = fl_value_get_float(fl_value_get_list_value(rect_value, 3));
+        rect.color = static_cast<uint32_t>(fl_value_get_int(fl_value_get_list_value(rect_value, 4)));
+        rect.stroke_width = fl_value_get_float(fl_value_get_list_value(rect_value, 5));
+        overlay.rects.push_back(rect);
+      }
+    }
+    // Each label is [x, y, text, color, background, fontSize].
+    static const FlValueType label_types[] = {FL_VALUE_TYPE_FLOAT, FL_VALUE_TYPE_FLOAT, FL_VALUE_TYPE_STRING,
+                                              FL_VALUE_TYPE_INT, FL_VALUE_TYPE_INT, FL_VALUE_TYPE_FLOAT};
+    for (size_t i = 0; valid && labels_value != NULL && i < fl_value_get_length(labels_value); i++)
+    {
+      FlValue *label_value = fl_value_get_list_value(labels_value, i);
+      valid = list_has_types(label_value, label_types, 6);
+      if (valid)
+      {
+        OverlayLabel label;
+        label.x = fl_value_get_float(fl_value_get_list_value(label_value, 0));
+        label.y = fl_value_get_float(fl_value_get_list_value(label_value, 1));
+        label.text = fl_value_get_string(fl_value_get_list_value(label_value, 2));
+        label.color = static_cast<uint32_t>(fl_value_get_int(fl_value_get_list_value(label_value, 3)));
+        label.background = static_cast<uint32_t>(fl_value_get_int(fl_value_get_list_value(label_value, 4)));
+        label.font_size = fl_value_get_float(fl_value_get_list_value(label_value, 5));
+        overlay.labels.push_back(label);
+      }
+    }
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (!valid)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Invalid rects or labels parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Invalid rects or labels parameter", error_message));
+    }
+    else
+    {
+      decoder->setOverlay(std::move(overlay));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "setMosaicLayout") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *mosaic_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "mosaicId") : NULL;
+    FlValue *tiles_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "tiles") : NULL;
+    auto mosaic = mosaic_value != NULL && fl_value_get_type(mosaic_value) == FL_VALUE_TYPE_INT
+                      ? mosaics.find(fl_value_get_int(mosaic_value))
+                      : mosaics.end();
+    std::vector<MosaicTile> tiles;
+    bool valid = tiles_value != NULL && fl_value_get_type(tiles_value) == FL_VALUE_TYPE_LIST;
+    for (size_t i = 0; valid && i < fl_value_get_length(tiles_value); i++)
+    {
+      // Each tile is [textureId, x, y, width, height].
+      FlValue *tile_value = fl_value_get_list_value(tiles_value, i);
+      valid = fl_value_get_type(tile_value) == FL_VALUE_TYPE_LIST && fl_value_get_length(tile_value) == 5;
+      for (size_t j = 0; valid && j < 5; j++)
+      {
+        valid = fl_value_get_type(fl_value_get_list_value(tile_value, j)) == FL_VALUE_TYPE_INT;
+      }
+      if (!valid)
+      {
+        break;
+      }
+      auto session = sessions.find(fl_value_get_int(fl_value_get_list_value(tile_value, 0)));
+      valid = session != sessions.end();
+      if (valid)
+      {
+        tiles.push_back(MosaicTile{session->second,
+                                   static_cast<int>(fl_value_get_int(fl_value_get_list_value(tile_value, 1))),
+                                   static_cast<int>(fl_value_get_int(fl_value_get_list_value(tile_value, 2))),
+                                   static_cast<int>(fl_value_get_int(fl_value_get_list_value(tile_value, 3))),
+                                   static_cast<int>(fl_value_get_int(fl_value_get_list_value(tile_value, 4)))});
+      }
+    }
+    if (mosaic == mosaics.end())
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("No such mosaic");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "No such mosaic", error_message));
+    }
+    else if (!valid)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Invalid tiles parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Invalid tiles parameter", error_message));
+    }
+    else
+    {
+      mosaic->second->setLayout(tiles);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "disposeMosaic") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *mosaic_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "mosaicId") : NULL;
+    if (mosaic_value != NULL && fl_value_get_type(mosaic_value) == FL_VALUE_TYPE_INT)
+    {
+      auto mosaic = mosaics.find(fl_value_get_int(mosaic_value));
+      if (mosaic != mosaics.end())
+      {
+        delete mosaic->second;
+        mosaics.erase(mosaic);
+      }
+    }
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+  }
+  else if (strcmp(method, "setOrientation") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *turns_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "quarterTurns") : NULL;
+    FlValue *mirror_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "mirror") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (turns_value == NULL || fl_value_get_type(turns_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing quarterTurns parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing quarterTurns parameter", error_message));
+    }
+    else
+    {
+      bool mirror = mirror_value != NULL && fl_value_get_type(mirror_value) == FL_VALUE_TYPE_BOOL &&
+                    fl_value_get_bool(mirror_value);
+      decoder->setOrientation(fl_value_get_int(turns_value), mirror);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "snapshot") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *format_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "format") : NULL;
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    const char *format_name = format_value != NULL && fl_value_get_type(format_value) == FL_VALUE_TYPE_STRING ? fl_value_get_string(format_value) : "png";
+    SnapshotFormat format = SNAPSHOT_FORMAT_PNG;
+    if (strcmp(format_name, "jpeg") == 0)
+    {
+      format = SNAPSHOT_FORMAT_JPEG;
+    }
+    else if (strcmp(format_name, "rgba") == 0)
+    {
+      format = SNAPSHOT_FORMAT_RGBA;
+    }
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (format == SNAPSHOT_FORMAT_PNG && strcmp(format_name, "png") != 0)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Unknown snapshot format");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Unknown snapshot format", error_message));
+    }
+    else
+    {
+      if (self->snapshot_encoder == nullptr)
+      {
+        self->snapshot_encoder = new SnapshotEncoder();
+      }
+      SnapshotEncoder *encoder = self->snapshot_encoder;
+      const std::string path = path_value != NULL && fl_value_get_type(path_value) == FL_VALUE_TYPE_STRING ? fl_value_get_string(path_value) : "";
+      std::shared_ptr<FlMethodCall> call(FL_METHOD_CALL(g_object_ref(method_call)), g_object_unref);
+      // Answered once the frame has been read back and encoded.
+      decoder->snapshot([encoder, call, format, format_name = std::string(format_name), path](std::vector<uint8_t> &pixels, int width, int height)
+                        {
+        if (pixels.empty())
+        {
+          respond_later(call.get(), FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr)));
+          return;
+        }
+        SnapshotJob job;
+        job.pixels = std::move(pixels);
+        job.width = width;
+        job.height = height;
+        job.format = format;
+        job.path = path;
+        job.done = [call, format_name, path, width, height](bool ok, std::vector<uint8_t> &data)
+        {
+          if (!ok)
+          {
+            g_autoptr(FlValue) error_message = fl_value_new_string("Failed to encode snapshot");
+            respond_later(call.get(), FL_METHOD_RESPONSE(fl_method_error_response_new(
+                                          "SNAPSHOT_FAILED", "Failed to encode snapshot", error_message)));
+            return;
+          }
+          g_autoptr(FlValue) result = fl_value_new_map();
+          fl_value_set_string_take(result, "width", fl_value_new_int(width));
+          fl_value_set_string_take(result, "height", fl_value_new_int(height));
+          fl_value_set_string_take(result, "format", fl_value_new_string(format_name.c_str()));
+          if (path.empty())
+          {
+            fl_value_set_string_take(result, "data", fl_value_new_uint8_list(data.data(), data.size()));
+          }
+          else
+          {
+            fl_value_set_string_take(result, "path", fl_value_new_string(path.c_str()));
+          }
+          respond_later(call.get(), FL_METHOD_RESPONSE(fl_method_success_response_new(result)));
+        };
+        encoder->encode(std::move(job)); });
+      return;
+    }
+  }
+  else if (strcmp(method, "setRegionOfInterest") == 0)
+  {
+    // Without a region the whole picture is shown again.
+    FlValue *args = fl_method_call_get_args(method_call);
+    double region[4] = {0, 0, 0, 0};
+    const char *keys[4] = {"x", "y", "width", "height"};
+    bool valid = true;
+    for (int i = 0; i < 4; i++)
+    {
+      FlValue *value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, keys[i]) : NULL;
+      if (value == NULL || fl_value_get_type(value) == FL_VALUE_TYPE_NULL)
+      {
+        continue;
+      }
+      if (fl_value_get_type(value) != FL_VALUE_TYPE_FLOAT)
+      {
+        valid = false;
+        break;
+      }
+      region[i] = fl_value_get_float(value);
+    }
+    FlValue *upscale_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "upscale") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (!valid || region[0] < 0 || region[1] < 0 || region[2] < 0 || region[3] < 0 ||
+             region[0] + region[2] > 1.0001 || region[1] + region[3] > 1.0001)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Region must lie within 0..1");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Region must lie within 0..1", error_message));
+    }
+    else
+    {
+      bool upscale = upscale_value != NULL && fl_value_get_type(upscale_value) == FL_VALUE_TYPE_BOOL &&
+                     fl_value_get_bool(upscale_value);
+      decoder->setRegionOfInterest(region[0], region[1], region[2], region[3], upscale);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "needsTransformation") == 0)
+  {
+    // Frames need turning in Flutter unless the session turns them itself.
+    g_autoptr(FlValue) result = fl_value_new_bool(decoder == nullptr || !decoder->appliesOrientation());
+    response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+  }
+  else if (strcmp(method, "setVisibility") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *visible_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "visible") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (visible_value == NULL || fl_value_get_type(visible_value) != FL_VALUE_TYPE_BOOL)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing visible parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing visible parameter", error_message));
+    }
+    else
+    {
+      decoder->setVisible(fl_value_get_bool(visible_value));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "suspend") == 0 || strcmp(method, "resume") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->setSuspended(strcmp(method, "suspend") == 0);
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "startRtpReceiver") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *port_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "port") : NULL;
+    FlValue *address_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "address") : NULL;
+    FlValue *payload_type_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "payloadType") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (port_value == NULL || fl_value_get_type(port_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing port parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing port parameter", error_message));
+    }
+    else if (payload_type_value != NULL &&
+             (fl_value_get_type(payload_type_value) != FL_VALUE_TYPE_INT ||
+              fl_value_get_int(payload_type_value) < 0 || fl_value_get_int(payload_type_value) > 127))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("payloadType must be between 0 and 127");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "payloadType must be between 0 and 127", error_message));
+    }
+    else
+    {
+      const gchar *address = address_value != NULL && fl_value_get_type(address_value) == FL_VALUE_TYPE_STRING
+                                 ? fl_value_get_string(address_value)
+                                 : nullptr;
+      const int payload_type = payload_type_value != NULL ? fl_value_get_int(payload_type_value) : 96;
+      int port = decoder->startRtpReceiver(address, fl_value_get_int(port_value), payload_type);
+      if (port < 0)
+      {
+        g_autoptr(FlValue) error_message = fl_value_new_string("Failed to bind RTP socket");
         response = FL_METHOD_RESPONSE(fl_method_error_response_new(
-            "BAD_STATE", "Decoder has not been initialized", error_message));
+            "FAILURE", "Failed to bind RTP socket", error_message));
+      }
+      else
+      {
+        g_autoptr(FlValue) result = fl_value_new_int(port);
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+      }
+    }
+  }
+  else if (strcmp(method, "stopRtpReceiver") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->stopRtpReceiver();
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "startShmIngest") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    FlValue *capacity_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "capacity") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path parameter", error_message));
+    }
+    else if (capacity_value != NULL &&
+             (fl_value_get_type(capacity_value) != FL_VALUE_TYPE_INT ||
+              fl_value_get_int(capacity_value) < int64_t(kShmRingMinCapacity) ||
+              fl_value_get_int(capacity_value) > int64_t(kShmRingMaxCapacity)))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("capacity must be between 4 KiB and 1 GiB");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "capacity must be between 4 KiB and 1 GiB", error_message));
+    }
+    else
+    {
+      size_t capacity = capacity_value != NULL ? fl_value_get_int(capacity_value) : 16 * 1024 * 1024;
+      if (decoder->startShmIngest(fl_value_get_string(path_value), capacity))
+      {
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
       }
       else
       {
-        decoder->addH265Nal(nal, size);
+        g_autoptr(FlValue) error_message = fl_value_new_string("Failed to listen on the ingest socket");
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+            "FAILURE", "Failed to listen on the ingest socket", error_message));
+      }
+    }
+  }
+  else if (strcmp(method, "stopShmIngest") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->stopShmIngest();
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "startTraceRecording") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path parameter", error_message));
+    }
+    else if (decoder->startTraceRecording(fl_value_get_string(path_value)))
+    {
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+    else
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Failed to open the trace file");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "FAILURE", "Failed to open the trace file", error_message));
+    }
+  }
+  else if (strcmp(method, "stopTraceRecording") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->stopTraceRecording();
+      NalTraceStats stats = decoder->traceStats();
+      g_autoptr(FlValue) result = fl_value_new_map();
+      fl_value_set_string_take(result, "records", fl_value_new_int(stats.records));
+      fl_value_set_string_take(result, "bytes", fl_value_new_int(stats.bytes));
+      fl_value_set_string_take(result, "dropped", fl_value_new_int(stats.dropped));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "startTraceReplay") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    FlValue *speed_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "speed") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path parameter", error_message));
+    }
+    else
+    {
+      double speed = speed_value != NULL && fl_value_get_type(speed_value) == FL_VALUE_TYPE_FLOAT
+                         ? fl_value_get_float(speed_value)
+                         : 1.0;
+      if (decoder->startTraceReplay(fl_value_get_string(path_value), speed))
+      {
         response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
       }
+      else
+      {
+        g_autoptr(FlValue) error_message = fl_value_new_string("Failed to open the trace file");
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+            "FAILURE", "Failed to open the trace file", error_message));
+      }
+    }
+  }
+  else if (strcmp(method, "stopTraceReplay") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->stopTraceReplay();
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "setTimeshift") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *duration_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "durationUs") : NULL;
+    FlValue *capacity_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "capacityBytes") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (duration_value == NULL || fl_value_get_type(duration_value) != FL_VALUE_TYPE_INT ||
+             capacity_value == NULL || fl_value_get_type(capacity_value) != FL_VALUE_TYPE_INT ||
+             fl_value_get_int(duration_value) < 0 || fl_value_get_int(capacity_value) < 0)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing durationUs or capacityBytes parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing durationUs or capacityBytes parameter", error_message));
+    }
+    else
+    {
+      decoder->setTimeshift(fl_value_get_int(duration_value), fl_value_get_int(capacity_value));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "exportTimeshift") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    FlValue *back_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "backUs") : NULL;
+    const int64_t back = back_value != NULL && fl_value_get_type(back_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(back_value) : INT64_MAX;
+    TimeshiftExport info;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path parameter", error_message));
+    }
+    else if (!decoder->exportTimeshift(fl_value_get_string(path_value), back, info))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Nothing to export");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "FAILURE", "Nothing to export", error_message));
+    }
+    else
+    {
+      g_autoptr(FlValue) result = fl_value_new_map();
+      fl_value_set_string_take(result, "pictures", fl_value_new_int(info.pictures));
+      fl_value_set_string_take(result, "bytes", fl_value_new_int(info.bytes));
+      fl_value_set_string_take(result, "durationUs", fl_value_new_int(info.duration));
+      fl_value_set_string_take(result, "fps", fl_value_new_float(info.fps));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "replayTimeshift") == 0)
+  {
+    // Plays the timeshift of sourceTextureId in the session of textureId.
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *source_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "sourceTextureId") : NULL;
+    FlValue *back_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "backUs") : NULL;
+    auto source = source_value != NULL && fl_value_get_type(source_value) == FL_VALUE_TYPE_INT ? sessions.find(fl_value_get_int(source_value)) : sessions.end();
+    const int64_t back = back_value != NULL && fl_value_get_type(back_value) == FL_VALUE_TYPE_INT ? fl_value_get_int(back_value) : INT64_MAX;
+    FilePlaybackInfo info;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (source == sessions.end())
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing or unknown sourceTextureId parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing or unknown sourceTextureId parameter", error_message));
+    }
+    else if (!decoder->replayTimeshift(*source->second, back, info))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Nothing to replay");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "FAILURE", "Nothing to replay", error_message));
+    }
+    else
+    {
+      g_autoptr(FlValue) result = fl_value_new_map();
+      fl_value_set_string_take(result, "frames", fl_value_new_int(info.frames));
+      fl_value_set_string_take(result, "keyframes", fl_value_new_int(info.keyframes));
+      fl_value_set_string_take(result, "durationUs", fl_value_new_int(info.duration));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "openFile") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *path_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "path") : NULL;
+    FlValue *fps_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "fps") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path parameter", error_message));
+    }
+    else
+    {
+      double fps = fps_value != NULL && fl_value_get_type(fps_value) == FL_VALUE_TYPE_FLOAT
+                       ? fl_value_get_float(fps_value)
+                       : 30.0;
+      FilePlaybackInfo info;
+      if (decoder->openFile(fl_value_get_string(path_value), fps, info))
+      {
+        g_autoptr(FlValue) result = fl_value_new_map();
+        fl_value_set_string_take(result, "frames", fl_value_new_int(info.frames));
+        fl_value_set_string_take(result, "keyframes", fl_value_new_int(info.keyframes));
+        fl_value_set_string_take(result, "durationUs", fl_value_new_int(info.duration));
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+      }
+      else
+      {
+        g_autoptr(FlValue) error_message = fl_value_new_string("Failed to open the H.265 file");
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+            "FAILURE", "Failed to open the H.265 file", error_message));
+      }
+    }
+  }
+  else if (strcmp(method, "seekFile") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *position_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "position") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (position_value == NULL || fl_value_get_type(position_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing position parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing position parameter", error_message));
+    }
+    else
+    {
+      int64_t position = decoder->seekFile(fl_value_get_int(position_value));
+      if (position < 0)
+      {
+        g_autoptr(FlValue) error_message = fl_value_new_string("No file is open");
+        response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+            "BAD_STATE", "No file is open", error_message));
+      }
+      else
+      {
+        g_autoptr(FlValue) result = fl_value_new_int(position);
+        response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+      }
+    }
+  }
+  else if (strcmp(method, "setFileRate") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *rate_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "rate") : NULL;
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else if (rate_value == NULL || fl_value_get_type(rate_value) != FL_VALUE_TYPE_FLOAT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing rate parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing rate parameter", error_message));
+    }
+    else
+    {
+      decoder->setFileRate(fl_value_get_float(rate_value));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "closeFile") == 0)
+  {
+    if (decoder == nullptr)
+    {
+      response = decoder_not_initialized_response();
+    }
+    else
+    {
+      decoder->closeFile();
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
+    }
+  }
+  else if (strcmp(method, "requestThumbnails") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    const bool is_map = fl_value_get_type(args) == FL_VALUE_TYPE_MAP;
+    FlValue *path_value = is_map ? fl_value_lookup_string(args, "path") : NULL;
+    FlValue *positions_value = is_map ? fl_value_lookup_string(args, "positions") : NULL;
+    FlValue *fps_value = is_map ? fl_value_lookup_string(args, "fps") : NULL;
+    FlValue *width_value = is_map ? fl_value_lookup_string(args, "width") : NULL;
+    FlValue *height_value = is_map ? fl_value_lookup_string(args, "height") : NULL;
+    FlValue *format_value = is_map ? fl_value_lookup_string(args, "format") : NULL;
+    if (path_value == NULL || fl_value_get_type(path_value) != FL_VALUE_TYPE_STRING ||
+        positions_value == NULL || fl_value_get_type(positions_value) != FL_VALUE_TYPE_LIST)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing path or positions parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing path or positions parameter", error_message));
+    }
+    else if (fps_value != NULL &&
+             (fl_value_get_type(fps_value) != FL_VALUE_TYPE_FLOAT ||
+              !(fl_value_get_float(fps_value) > 0 && fl_value_get_float(fps_value) <= kMaxThumbnailFps)))
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("fps must be between 0 and 1000");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "fps must be between 0 and 1000", error_message));
+    }
+    else
+    {
+      ThumbnailRequest request;
+      request.path = fl_value_get_string(path_value);
+      for (size_t i = 0; i < fl_value_get_length(positions_value); i++)
+      {
+        FlValue *position = fl_value_get_list_value(positions_value, i);
+        if (fl_value_get_type(position) == FL_VALUE_TYPE_INT)
+        {
+          request.positions.push_back(fl_value_get_int(position));
+        }
+      }
+      if (fps_value != NULL)
+      {
+        request.fps = fl_value_get_float(fps_value);
+      }
+      if (width_value != NULL && fl_value_get_type(width_value) == FL_VALUE_TYPE_INT)
+      {
+        request.width = fl_value_get_int(width_value);
+      }
+      if (height_value != NULL && fl_value_get_type(height_value) == FL_VALUE_TYPE_INT)
+      {
+        request.height = fl_value_get_int(height_value);
+      }
+      if (format_value != NULL && fl_value_get_type(format_value) == FL_VALUE_TYPE_STRING &&
+          strcmp(fl_value_get_string(format_value), "jpeg") == 0)
+      {
+        request.format = THUMBNAIL_FORMAT_JPEG;
+      }
+      if (self->thumbnail_service == nullptr)
+      {
+        self->thumbnail_service = thumbnail_service_new(self->event_channel);
+      }
+      g_autoptr(FlValue) result = fl_value_new_int(self->thumbnail_service->request(std::move(request)));
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(result));
+    }
+  }
+  else if (strcmp(method, "cancelThumbnails") == 0)
+  {
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *id_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "requestId") : NULL;
+    if (id_value == NULL || fl_value_get_type(id_value) != FL_VALUE_TYPE_INT)
+    {
+      g_autoptr(FlValue) error_message = fl_value_new_string("Missing requestId parameter");
+      response = FL_METHOD_RESPONSE(fl_method_error_response_new(
+          "INVALID_ARGUMENT", "Missing requestId parameter", error_message));
+    }
+    else
+    {
+      if (self->thumbnail_service != nullptr)
+      {
+        self->thumbnail_service->cancel(fl_value_get_int(id_value));
+      }
+      response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
     }
   }
   else if (strcmp(method, "dispose") == 0)
   {
-    decoder = nullptr;
+    // With a textureId only that session goes, otherwise all of them.
+    FlValue *args = fl_method_call_get_args(method_call);
+    FlValue *id_value = fl_value_get_type(args) == FL_VALUE_TYPE_MAP ? fl_value_lookup_string(args, "textureId") : NULL;
+    if (id_value != NULL && fl_value_get_type(id_value) == FL_VALUE_TYPE_INT)
+    {
+      delete_session(fl_value_get_int(id_value));
+    }
+    else
+    {
+      delete_all_sessions();
+    }
     response = FL_METHOD_RESPONSE(fl_method_success_response_new(nullptr));
   }
   else
@@ -102,6 +1311,16 @@ static void renderer_plugin_handle_method_call(
 
 static void renderer_plugin_dispose(GObject *object)
 {
+  RendererPlugin *self = RENDERER_PLUGIN(object);
+  delete_all_sessions();
+  delete self->upload_thread;
+  self->upload_thread = nullptr;
+  delete self->thumbnail_service;
+  self->thumbnail_service = nullptr;
+  // After the upload thread, which hands it the last snapshots.
+  delete self->snapshot_encoder;
+  self->snapshot_encoder = nullptr;
+  g_clear_object(&self->event_channel);
   G_OBJECT_CLASS(renderer_plugin_parent_class)->dispose(object);
 }
 
@@ -136,6 +1355,9 @@ void renderer_plugin_register_with_registrar(
                             "com.openup.streamline/renderer", FL_METHOD_CODEC(codec));
   fl_method_channel_set_method_call_handler(
       channel, method_call_cb, g_object_ref(plugin), g_object_unref);
+  plugin->event_channel =
+      fl_event_channel_new(fl_plugin_registrar_get_messenger(registrar),
+                           "com.openup.streamline/renderer/events", FL_METHOD_CODEC(codec));
 
   g_object_unref(plugin);
 }
@@ -0,0 +1,118 @@
+#include "include/renderer/reverse_gop_cache.h"
+
+void ReverseGopCache::expectGroup(uint64_t decoder, size_t count, size_t stride, int64_t first_pts, int64_t span)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Group group;
+    group.decoder = decoder;
+    group.count = count;
+    group.stride = stride;
+    group.first_pts = first_pts;
+    group.span = span;
+    groups.push_back(std::move(group));
+}
+
+bool ReverseGopCache::take(uint64_t decoder, DecodedFrame &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    bool owned = false;
+    for (Group &group : groups)
+    {
+        if (group.decoder != decoder)
+        {
+            continue;
+        }
+        owned = true;
+        if (group.received == group.count)
+        {
+            continue;
+        }
+        // The last frame of a group is always kept so it starts the reversal.
+        const bool last = group.received + 1 == group.count;
+        if (group.received++ % group.stride == 0 || last)
+        {
+            group.frames.push_back(std::move(frame));
+        }
+        if (last)
+        {
+            complete(group);
+        }
+        return true;
+    }
+    // A frame beyond the count of its decoder's groups is dropped.
+    return owned;
+}
+
+void ReverseGopCache::finishDecoder(uint64_t decoder)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Group &group : groups)
+    {
+        if (group.decoder == decoder && group.received < group.count)
+        {
+            group.received = group.count;
+            complete(group);
+        }
+    }
+}
+
+void ReverseGopCache::handOver(uint64_t from, uint64_t to)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Group &group : groups)
+    {
+        if (group.decoder == from && group.received == 0)
+        {
+            group.decoder = to;
+        }
+    }
+}
+
+void ReverseGopCache::complete(Group &group)
+{
+    if (group.frames.empty())
+    {
+        return;
+    }
+    const int64_t interval = group.span / static_cast<int64_t>(group.frames.size());
+    int64_t pts = group.first_pts;
+    for (auto it = group.frames.rbegin(); it != group.frames.rend(); ++it)
+    {
+        it->pts = pts;
+        pts += interval;
+    }
+}
+
+bool ReverseGopCache::pop(DecodedFrame &frame)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!groups.empty())
+    {
+        Group &group = groups.front();
+        if (group.received < group.count)
+        {
+            return false;
+        }
+        if (!group.frames.empty())
+        {
+            frame = std::move(group.frames.back());
+            group.frames.pop_back();
+            return true;
+        }
+        groups.pop_front();
+    }
+    return false;
+}
+
+void ReverseGopCache::clear(std::vector<std::vector<uint8_t>> &buffers)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Group &group : groups)
+    {
+        for (DecodedFrame &frame : group.frames)
+        {
+            buffers.push_back(std::move(frame.data));
+        }
+    }
+    groups.clear();
+}
@@ -0,0 +1,185 @@
+#include "include/renderer/rtp_depacketizer.h"
+
+namespace
+{
+    const uint8_t kStartCode[] = {0, 0, 0, 1};
+    const int kAggregationPacket = 48;
+    const int kFragmentationUnit = 49;
+    const int kPayloadContentInformation = 50;
+    // Packets at most this far behind the newest one are duplicates or came
+    // late; further back, the sender has restarted its sequence (RFC 3550,
+    // appendix A.1).
+    const int kMaxMisorder = 100;
+}
+
+bool parseRtpPacket(const uint8_t *data, size_t size, RtpPacket &packet)
+{
+    if (size < 12 || (data[0] >> 6) != 2)
+    {
+        return false;
+    }
+
+    const bool padding = data[0] & 0x20;
+    const bool extension = data[0] & 0x10;
+    const int csrc_count = data[0] & 0x0f;
+    packet.marker = data[1] & 0x80;
+    packet.payload_type = data[1] & 0x7f;
+    packet.sequence = (data[2] << 8) | data[3];
+    packet.timestamp = (uint32_t(data[4]) << 24) | (data[5] << 16) | (data[6] << 8) | data[7];
+    packet.ssrc = (uint32_t(data[8]) << 24) | (data[9] << 16) | (data[10] << 8) | data[11];
+
+    size_t offset = 12 + csrc_count * 4;
+    if (extension)
+    {
+        if (offset + 4 > size)
+        {
+            return false;
+        }
+        offset += 4 + ((data[offset + 2] << 8) | data[offset + 3]) * 4;
+    }
+    size_t end = size;
+    if (padding)
+    {
+        end -= data[size - 1];
+    }
+    if (offset >= end || end > size)
+    {
+        return false;
+    }
+
+    packet.payload = data + offset;
+    packet.payload_size = end - offset;
+    return true;
+}
+
+RtpDepacketizer::RtpDepacketizer(AccessUnitCallback callback)
+    : callback(std::move(callback))
+{
+}
+
+void RtpDepacketizer::push(const RtpPacket &packet)
+{
+    bool discontinuity = false;
+    if (have_sequence)
+    {
+        const int gap = int16_t(uint16_t(packet.sequence - last_sequence));
+        if (gap <= 0 && gap >= -kMaxMisorder)
+        {
+            // Already received, or given up on as lost.
+            return;
+        }
+        if (gap != 1)
+        {
+            // Only packets skipped going forwards count as lost.
+            if (gap > 1)
+            {
+                packets_lost += gap - 1;
+            }
+            // The rest of a fragmented NAL can never be completed.
+            discardFragment();
+            discontinuity = true;
+        }
+    }
+    last_sequence = packet.sequence;
+    have_sequence = true;
+
+    // An access unit whose marker was seen is complete, whatever follows.
+    if (discontinuity && !access_unit.empty())
+    {
+        damaged = true;
+    }
+    if (have_timestamp && packet.timestamp != timestamp)
+    {
+        flush();
+    }
+    damaged = damaged || discontinuity;
+    timestamp = packet.timestamp;
+    have_timestamp = true;
+
+    const uint8_t *payload = packet.payload;
+    const size_t size = packet.payload_size;
+    if (size < 2)
+    {
+        return;
+    }
+
+    const int type = (payload[0] >> 1) & 0x3f;
+    if (type == kAggregationPacket)
+    {
+        size_t offset = 2;
+        while (offset + 2 <= size)
+        {
+            const size_t nal_size = (payload[offset] << 8) | payload[offset + 1];
+            offset += 2;
+            if (nal_size == 0 || offset + nal_size > size)
+            {
+                break;
+            }
+            appendNal(payload + offset, nal_size);
+            offset += nal_size;
+        }
+    }
+    else if (type == kFragmentationUnit)
+    {
+        if (size < 3)
+        {
+            return;
+        }
+        const bool start = payload[2] & 0x80;
+        const bool end = payload[2] & 0x40;
+        const int fu_type = payload[2] & 0x3f;
+        if (start)
+        {
+            discardFragment();
+            // Rebuild the NAL unit header from the payload header and FU type.
+            const uint8_t header[] = {uint8_t((payload[0] & 0x81) | (fu_type << 1)), payload[1]};
+            fragment_start = access_unit.size();
+            in_fragment = true;
+            appendNal(header, sizeof(header));
+        }
+        if (in_fragment)
+        {
+            access_unit.insert(access_unit.end(), payload + 3, payload + size);
+            if (end)
+            {
+                in_fragment = false;
+            }
+        }
+    }
+    else if (type != kPayloadContentInformation)
+    {
+        appendNal(payload, size);
+    }
+
+    if (packet.marker)
+    {
+        flush();
+    }
+}
+
+void RtpDepacketizer::discardFragment()
+{
+    if (in_fragment)
+    {
+        access_unit.resize(fragment_start);
+        in_fragment = false;
+        damaged = true;
+    }
+}
+
+void RtpDepacketizer::appendNal(const uint8_t *nal, size_t size)
+{
+    access_unit.insert(access_unit.end(), kStartCode, kStartCode + sizeof(kStartCode));
+    access_unit.insert(access_unit.end(), nal, nal + size);
+}
+
+void RtpDepacketizer::flush()
+{
+    discardFragment();
+    if (!access_unit.empty())
+    {
+        callback(access_unit.data(), access_unit.size(), timestamp, damaged);
+        access_unit.clear();
+    }
+    damaged = false;
+}
@@ -0,0 +1,239 @@
+#include "include/renderer/rtp_receiver.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    // H.265 RTP streams use a 90 kHz clock (RFC 7798, section 7.1).
+    const int64_t kRtpClockRate = 90000;
+    const int kBatchSize = 32;
+    const size_t kMaxPacketSize = 2048;
+    const int kReceiveBufferSize = 4 * 1024 * 1024;
+
+    // Same clock as g_get_monotonic_time(), in microseconds.
+    int64_t monotonicTime()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+}
+
+RtpReceiver::RtpReceiver(AccessUnitCallback callback)
+    : callback(std::move(callback)),
+      depacketizer([this](const uint8_t *data, size_t size, uint32_t rtp_timestamp, bool damaged)
+                   { onAccessUnit(data, size, rtp_timestamp, damaged); })
+{
+}
+
+RtpReceiver::~RtpReceiver()
+{
+    stop();
+}
+
+int RtpReceiver::start(const char *address, int port, int payload_type)
+{
+    stop();
+    this->payload_type = payload_type;
+    have_ssrc = false;
+
+    socket_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (socket_fd < 0)
+    {
+        perror("Failed to create RTP socket");
+        return -1;
+    }
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF, &kReceiveBufferSize, sizeof(kReceiveBufferSize));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (address != nullptr && inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "Invalid RTP bind address %s\n", address);
+        stop();
+        return -1;
+    }
+    if (bind(socket_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0)
+    {
+        perror("Failed to bind RTP socket");
+        stop();
+        return -1;
+    }
+    socklen_t addr_size = sizeof(addr);
+    getsockname(socket_fd, reinterpret_cast<sockaddr *>(&addr), &addr_size);
+
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    thread = std::thread([this]()
+                         { run(); });
+    return ntohs(addr.sin_port);
+}
+
+void RtpReceiver::stop()
+{
+    if (thread.joinable())
+    {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+        {
+            perror("Failed to wake RTP thread");
+        }
+        thread.join();
+    }
+    if (wake_fd >= 0)
+    {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    if (socket_fd >= 0)
+    {
+        close(socket_fd);
+        socket_fd = -1;
+    }
+}
+
+RtpReceiverStats RtpReceiver::stats()
+{
+    RtpReceiverStats result;
+    result.packets_received = packets_received;
+    result.bytes_received = bytes_received;
+    result.access_units = access_units;
+    result.access_units_skipped = access_units_skipped;
+    result.packets_ignored = packets_ignored;
+    std::lock_guard<std::mutex> lock(jitter_mutex);
+    result.jitter_buffer = jitter_buffer.stats();
+    return result;
+}
+
+void RtpReceiver::run()
+{
+    std::vector<uint8_t> buffers(kBatchSize * kMaxPacketSize);
+    iovec iovecs[kBatchSize];
+    mmsghdr messages[kBatchSize];
+
+    auto release = [this](const uint8_t *data, size_t size)
+    {
+        RtpPacket packet;
+        if (parseRtpPacket(data, size, packet))
+        {
+            depacketizer.push(packet);
+        }
+    };
+
+    pollfd fds[2] = {{socket_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    while (true)
+    {
+        // Wake up in time to give up on a missing packet.
+        int timeout = -1;
+        {
+            std::lock_guard<std::mutex> lock(jitter_mutex);
+            const int64_t deadline = jitter_buffer.nextDeadline();
+            if (deadline >= 0)
+            {
+                timeout = std::max<int64_t>(0, (deadline - monotonicTime() + 999) / 1000);
+            }
+        }
+        if (poll(fds, 2, timeout) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+        if (!(fds[0].revents & POLLIN))
+        {
+            std::lock_guard<std::mutex> lock(jitter_mutex);
+            jitter_buffer.pop(monotonicTime(), release);
+            continue;
+        }
+
+        memset(messages, 0, sizeof(messages));
+        for (int i = 0; i < kBatchSize; i++)
+        {
+            iovecs[i].iov_base = buffers.data() + i * kMaxPacketSize;
+            iovecs[i].iov_len = kMaxPacketSize;
+            messages[i].msg_hdr.msg_iov = &iovecs[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        const int count = recvmmsg(socket_fd, messages, kBatchSize, MSG_DONTWAIT, nullptr);
+        const int64_t now = monotonicTime();
+        std::lock_guard<std::mutex> lock(jitter_mutex);
+        for (int i = 0; i < count; i++)
+        {
+            RtpPacket packet;
+            const uint8_t *data = buffers.data() + i * kMaxPacketSize;
+            packets_received++;
+            bytes_received += messages[i].msg_len;
+            if (!parseRtpPacket(data, messages[i].msg_len, packet))
+            {
+                continue;
+            }
+            if (packet.payload_type != payload_type || (have_ssrc && packet.ssrc != ssrc))
+            {
+                packets_ignored++;
+                continue;
+            }
+            ssrc = packet.ssrc;
+            have_ssrc = true;
+            jitter_buffer.push(packet, data, messages[i].msg_len, now);
+        }
+        jitter_buffer.pop(now, release);
+    }
+}
+
+void RtpReceiver::onAccessUnit(const uint8_t *data, size_t size, uint32_t rtp_timestamp, bool damaged)
+{
+    if (!have_timestamp)
+    {
+        have_timestamp = true;
+        extended_timestamp = 0;
+    }
+    else
+    {
+        extended_timestamp += int32_t(rtp_timestamp - last_timestamp);
+    }
+    last_timestamp = rtp_timestamp;
+    access_units++;
+
+    // A damaged access unit, and anything after it, references pictures the
+    // decoder never got whole, so wait for an intact random access point
+    // instead of feeding it corrupt data.
+    if (damaged)
+    {
+        waiting_for_irap = true;
+    }
+    if (waiting_for_irap)
+    {
+        bool irap = false;
+        hevcForEachNal(data, size, [&irap](const uint8_t *nal, size_t)
+                       { irap = irap || hevcIsIrap(hevcNalType(nal)); });
+        if (damaged || !irap)
+        {
+            access_units_skipped++;
+            return;
+        }
+        waiting_for_irap = false;
+    }
+
+    // Timestamps running backwards (B-frames) still map to valid times as
+    // long as they stay after the first access unit.
+    const int64_t pts = extended_timestamp * 1000000 / kRtpClockRate;
+    callback(data, size, pts < 0 ? -1 : pts);
+}
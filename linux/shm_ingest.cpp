@@ -0,0 +1,269 @@
+#include "include/renderer/shm_ingest.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+ShmIngest::ShmIngest(NalCallback callback) : callback(std::move(callback))
+{
+}
+
+ShmIngest::~ShmIngest()
+{
+    stop();
+}
+
+bool ShmIngest::start(const char *path, size_t capacity)
+{
+    stop();
+
+    if (capacity < kShmRingMinCapacity || capacity > kShmRingMaxCapacity)
+    {
+        fprintf(stderr, "Shared-memory ring capacity out of range: %zu\n", capacity);
+        return false;
+    }
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Shared-memory ingest socket path too long: %s\n", path);
+        return false;
+    }
+    strcpy(addr.sun_path, path);
+
+    // Only a socket left behind by an earlier listener is removed.
+    struct stat info;
+    if (lstat(path, &info) == 0)
+    {
+        if (!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "Shared-memory ingest path exists and is not a socket: %s\n", path);
+            return false;
+        }
+        unlink(path);
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0 ||
+        bind(listen_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, 1) < 0)
+    {
+        perror("Failed to listen for shared-memory producers");
+        stop();
+        return false;
+    }
+
+    this->path = path;
+    this->capacity = capacity & ~size_t(kShmRecordAlignment - 1);
+    wake_fd = eventfd(0, EFD_CLOEXEC);
+    thread = std::thread([this]()
+                         { run(); });
+    return true;
+}
+
+void ShmIngest::stop()
+{
+    if (thread.joinable())
+    {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) < 0)
+        {
+            perror("Failed to wake shared-memory ingest thread");
+        }
+        thread.join();
+    }
+    closeProducer();
+    if (wake_fd >= 0)
+    {
+        close(wake_fd);
+        wake_fd = -1;
+    }
+    if (listen_fd >= 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        unlink(path.c_str());
+    }
+}
+
+void ShmIngest::run()
+{
+    while (true)
+    {
+        pollfd fds[3] = {{wake_fd, POLLIN, 0}, {listen_fd, POLLIN, 0}, {-1, POLLIN, 0}};
+        if (client_fd >= 0)
+        {
+            // While a producer is attached, watch its data eventfd and its
+            // socket (for hang-up) instead of accepting.
+            fds[1] = {client_fd, POLLIN, 0};
+            fds[2] = {data_fd, POLLIN, 0};
+        }
+        if (poll(fds, 3, -1) < 0 && errno != EINTR)
+        {
+            break;
+        }
+        if (fds[0].revents)
+        {
+            break;
+        }
+
+        if (client_fd < 0)
+        {
+            if (fds[1].revents & POLLIN)
+            {
+                acceptProducer();
+            }
+            continue;
+        }
+        if (fds[2].revents & POLLIN)
+        {
+            uint64_t count;
+            if (read(data_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            {
+                perror("Failed to read shared-memory data eventfd");
+            }
+            consume();
+        }
+        if (fds[1].revents & (POLLHUP | POLLERR | POLLIN))
+        {
+            // Producers send nothing after the handshake; anything else is a
+            // hang-up. Take what was published before going away.
+            consume();
+            closeProducer();
+        }
+    }
+}
+
+bool ShmIngest::acceptProducer()
+{
+    client_fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client_fd < 0)
+    {
+        return false;
+    }
+
+    mapping_size = sizeof(ShmRingHeader) + capacity;
+    memfd = memfd_create("renderer-ingest", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    data_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    space_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (memfd < 0 || data_fd < 0 || space_fd < 0 || ftruncate(memfd, mapping_size) < 0 ||
+        fcntl(memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0)
+    {
+        perror("Failed to create shared-memory ring");
+        closeProducer();
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        perror("Failed to map shared-memory ring");
+        closeProducer();
+        return false;
+    }
+    ring = new (mapping) ShmRingHeader();
+    ring->magic = kShmRingMagic;
+    ring->version = kShmRingVersion;
+    ring->capacity = capacity;
+    ring->write_index.store(0, std::memory_order_relaxed);
+    ring->read_index.store(0, std::memory_order_release);
+
+    ShmRingHello hello = {kShmRingMagic, kShmRingVersion, capacity};
+    iovec iov = {&hello, sizeof(hello)};
+    const int fds[3] = {memfd, data_fd, space_fd};
+    char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr message{};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+    if (sendmsg(client_fd, &message, MSG_NOSIGNAL) < 0)
+    {
+        perror("Failed to hand the shared-memory ring to the producer");
+        closeProducer();
+        return false;
+    }
+    return true;
+}
+
+void ShmIngest::closeProducer()
+{
+    if (ring)
+    {
+        munmap(ring, mapping_size);
+        ring = nullptr;
+    }
+    for (int *fd : {&client_fd, &memfd, &data_fd, &space_fd})
+    {
+        if (*fd >= 0)
+        {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+void ShmIngest::consume()
+{
+    if (!ring)
+    {
+        return;
+    }
+
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(ring + 1);
+    uint64_t read_index = ring->read_index.load(std::memory_order_relaxed);
+    const uint64_t write_index = ring->write_index.load(std::memory_order_acquire);
+    if (write_index - read_index > capacity)
+    {
+        fprintf(stderr, "Shared-memory producer overran the ring, disconnecting\n");
+        closeProducer();
+        return;
+    }
+
+    while (read_index != write_index)
+    {
+        const uint64_t offset = read_index % capacity;
+        if (capacity - offset < sizeof(ShmRecordHeader))
+        {
+            // Too little room left for a header; producers skip it too.
+            read_index += capacity - offset;
+            continue;
+        }
+        ShmRecordHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        const uint64_t span = header.flags & SHM_RECORD_PADDING ? capacity - offset : shmRecordSpan(header.size);
+        if (offset + span > capacity || span > write_index - read_index)
+        {
+            fprintf(stderr, "Malformed shared-memory record, disconnecting\n");
+            closeProducer();
+            return;
+        }
+        if (!(header.flags & SHM_RECORD_PADDING))
+        {
+            callback(data + offset + sizeof(header), header.size, header.pts);
+        }
+        read_index += span;
+    }
+
+    ring->read_index.store(read_index, std::memory_order_release);
+    uint64_t one = 1;
+    if (write(space_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        perror("Failed to signal shared-memory space");
+    }
+}
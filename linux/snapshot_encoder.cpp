@@ -0,0 +1,117 @@
+#include "include/renderer/snapshot_encoder.h"
+
+#include <gtk/gtk.h>
+
+#include <cstdio>
+
+#include <unistd.h>
+
+namespace
+{
+    const char kJpegQuality[] = "92";
+
+    bool encodeImage(const SnapshotJob &job, std::vector<uint8_t> &data)
+    {
+        if (job.format == SNAPSHOT_FORMAT_RGBA)
+        {
+            data = job.pixels;
+            return true;
+        }
+        GdkPixbuf *pixbuf = gdk_pixbuf_new_from_data(job.pixels.data(), GDK_COLORSPACE_RGB, TRUE, 8,
+                                                     job.width, job.height, job.width * 4, nullptr, nullptr);
+        gchar *buffer = nullptr;
+        gsize size = 0;
+        GError *error = nullptr;
+        const bool ok = job.format == SNAPSHOT_FORMAT_JPEG
+                            ? gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size, "jpeg", &error,
+                                                        "quality", kJpegQuality, nullptr)
+                            : gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size, "png", &error, nullptr);
+        g_object_unref(pixbuf);
+        if (!ok)
+        {
+            fprintf(stderr, "Failed to encode snapshot: %s\n", error->message);
+            g_error_free(error);
+            return false;
+        }
+        data.assign(buffer, buffer + size);
+        g_free(buffer);
+        return true;
+    }
+
+    // Written under a temporary name first, so the file never appears half
+    // written.
+    bool writeFile(const std::string &path, const std::vector<uint8_t> &data)
+    {
+        const std::string temporary_path = path + ".tmp";
+        FILE *file = fopen(temporary_path.c_str(), "wb");
+        if (!file)
+        {
+            fprintf(stderr, "Failed to write snapshot to %s\n", path.c_str());
+            return false;
+        }
+        bool ok = fwrite(data.data(), data.size(), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temporary_path.c_str(), path.c_str()) != 0)
+        {
+            unlink(temporary_path.c_str());
+            fprintf(stderr, "Failed to write snapshot to %s\n", path.c_str());
+            return false;
+        }
+        return true;
+    }
+}
+
+SnapshotEncoder::SnapshotEncoder()
+{
+    thread = std::thread([this]()
+                         { run(); });
+}
+
+SnapshotEncoder::~SnapshotEncoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        jobs.clear();
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+void SnapshotEncoder::encode(SnapshotJob job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(std::move(job));
+    condition.notify_one();
+}
+
+void SnapshotEncoder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]()
+                       { return !running || !jobs.empty(); });
+        if (!running)
+        {
+            break;
+        }
+        SnapshotJob job = std::move(jobs.front());
+        jobs.pop_front();
+        lock.unlock();
+        process(job);
+        lock.lock();
+    }
+}
+
+void SnapshotEncoder::process(SnapshotJob &job)
+{
+    std::vector<uint8_t> data;
+    bool ok = encodeImage(job, data);
+    if (ok && !job.path.empty())
+    {
+        ok = writeFile(job.path, data);
+        data.clear();
+    }
+    job.done(ok, data);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+
+#include "include/renderer/decoder_drain.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+// Long enough for a reader that is not held to get through.
+const std::chrono::milliseconds kSettle(50);
+
+// Waits for a frame of decoder on a thread of its own, as its reader would.
+std::future<void> Deliver(DecoderDrain& drain, uint64_t decoder) {
+  return std::async(std::launch::async,
+                    [&drain, decoder]() { drain.wait(decoder); });
+}
+
+bool Held(std::future<void>& frame) {
+  return frame.wait_for(kSettle) == std::future_status::timeout;
+}
+
+}  // namespace
+
+TEST(DecoderDrain, LetsFramesThroughWhenNothingDrains) {
+  DecoderDrain drain;
+  std::future<void> frame = Deliver(drain, 1);
+  EXPECT_FALSE(Held(frame));
+}
+
+TEST(DecoderDrain, HoldsLaterDecodersUntilTheRetiredOneHasDrained) {
+  DecoderDrain drain;
+  drain.begin(1);
+  // The retired decoder's own reader must never wait on its drain.
+  std::future<void> own = Deliver(drain, 1);
+  EXPECT_FALSE(Held(own));
+
+  std::future<void> next = Deliver(drain, 2);
+  EXPECT_TRUE(Held(next));
+  drain.finish(1);
+  EXPECT_FALSE(Held(next));
+}
+
+TEST(DecoderDrain, RetiresTwoDecodersInARow) {
+  DecoderDrain drain;
+  drain.begin(1);
+  std::future<void> second = Deliver(drain, 2);
+  EXPECT_TRUE(Held(second));
+  drain.finish(1);
+  EXPECT_FALSE(Held(second));
+
+  // The decoder that just took over is retired in turn.
+  drain.begin(2);
+  std::future<void> own = Deliver(drain, 2);
+  std::future<void> stale = Deliver(drain, 1);
+  EXPECT_FALSE(Held(own));
+  EXPECT_FALSE(Held(stale));
+
+  std::future<void> third = Deliver(drain, 3);
+  EXPECT_TRUE(Held(third));
+  drain.finish(2);
+  EXPECT_FALSE(Held(third));
+}
+
+TEST(DecoderDrain, IgnoresTheFinishOfAnEarlierDrain) {
+  DecoderDrain drain;
+  drain.begin(1);
+  drain.cancel();
+  drain.begin(2);
+  drain.finish(1);
+  std::future<void> frame = Deliver(drain, 3);
+  EXPECT_TRUE(Held(frame));
+  drain.finish(2);
+  EXPECT_FALSE(Held(frame));
+}
+
+TEST(DecoderDrain, CancelLetsHeldFramesGo) {
+  DecoderDrain drain;
+  drain.begin(1);
+  std::future<void> frame = Deliver(drain, 2);
+  EXPECT_TRUE(Held(frame));
+  drain.cancel();
+  EXPECT_FALSE(Held(frame));
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/renderer/frame_shedder.h"
+#include "include/renderer/hevc_nal.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+const int64_t kStart = 10000000;
+// Longer than the time the shedder waits between two steps up.
+const int64_t kStep = 300000;
+// Longer than the quiet period before it steps down.
+const int64_t kQuiet = 2500000;
+
+// A shedder that has seen three temporal sub-layers, with its decoder
+// queue already past the default limit.
+class OverloadedFrameShedder : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    shedder.setLevelCallback(
+        [this](const SheddingStats& stats) { levels.push_back(stats.level); });
+    for (int temporal_id = 0; temporal_id <= 2; temporal_id++) {
+      shedder.admit(HEVC_NAL_TRAIL_R, temporal_id, now);
+    }
+    ASSERT_EQ(shedder.stats().level, 0);
+    shedder.onPicturesQueued(7, now);
+  }
+
+  // Advances by one step and lets the shedder re-evaluate on an IRAP.
+  void Step() {
+    now += kStep;
+    EXPECT_TRUE(shedder.admit(HEVC_NAL_IDR_W_RADL, 0, now));
+  }
+
+  FrameShedder shedder;
+  std::vector<int> levels;
+  int64_t now = kStart;
+};
+
+}  // namespace
+
+TEST_F(OverloadedFrameShedder, FirstShedsNonReferencePicturesOfTheTopSubLayer) {
+  Step();
+  const SheddingStats stats = shedder.stats();
+  EXPECT_EQ(stats.level, 1);
+  EXPECT_EQ(stats.max_temporal_id, 2);
+  EXPECT_TRUE(stats.drop_non_reference);
+  EXPECT_EQ(levels, (std::vector<int>{1}));
+
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_N, 2, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_R, 2, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_N, 1, now));
+  EXPECT_EQ(shedder.stats().pictures_shed, 1u);
+}
+
+TEST_F(OverloadedFrameShedder, WaitsBetweenStepsUp) {
+  Step();
+  now += kStep / 2;
+  shedder.admit(HEVC_NAL_TRAIL_R, 0, now);
+  EXPECT_EQ(shedder.stats().level, 1);
+  Step();
+  EXPECT_EQ(shedder.stats().level, 2);
+  EXPECT_EQ(levels, (std::vector<int>{1, 2}));
+}
+
+TEST_F(OverloadedFrameShedder, ShedsWholeSubLayersAtHigherLevels) {
+  Step();
+  Step();
+  SheddingStats stats = shedder.stats();
+  EXPECT_EQ(stats.max_temporal_id, 1);
+  EXPECT_FALSE(stats.drop_non_reference);
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_R, 2, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_N, 1, now));
+
+  Step();
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_N, 1, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_R, 1, now));
+}
+
+TEST_F(OverloadedFrameShedder, NeverDropsTheBaseSubLayer) {
+  for (int i = 0; i < 10; i++) {
+    Step();
+  }
+  const SheddingStats stats = shedder.stats();
+  EXPECT_EQ(stats.level, 5);
+  EXPECT_EQ(stats.max_temporal_id, 0);
+  EXPECT_TRUE(stats.drop_non_reference);
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_N, 0, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_R, 0, now));
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_CRA_NUT, 0, now));
+}
+
+TEST_F(OverloadedFrameShedder, StepsDownOnlyAtTheNextIrap) {
+  Step();
+  Step();
+  shedder.onDecoderReset();
+
+  // Quiet for long enough, but pictures that come back may reference
+  // ones already dropped.
+  now += kQuiet;
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_R, 2, now));
+  EXPECT_EQ(shedder.stats().level, 2);
+
+  now += kStep;
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_IDR_W_RADL, 0, now));
+  EXPECT_EQ(shedder.stats().level, 1);
+  EXPECT_EQ(levels, (std::vector<int>{1, 2, 1}));
+}
+
+TEST_F(OverloadedFrameShedder, ShedsNothingWhenDisabled) {
+  shedder.configure(false, 6, 150000);
+  Step();
+  EXPECT_EQ(shedder.stats().level, 0);
+  EXPECT_TRUE(shedder.admit(HEVC_NAL_TRAIL_N, 2, now));
+  EXPECT_TRUE(levels.empty());
+}
+
+TEST(FrameShedder, StepsUpOnSlowDecoding) {
+  FrameShedder shedder;
+  int64_t now = kStart;
+  shedder.admit(HEVC_NAL_TRAIL_R, 1, now);
+  for (int i = 0; i < 20; i++) {
+    shedder.onPicturesQueued(1, now);
+    now += 400000;
+    shedder.onFrameDecoded(now);
+  }
+  EXPECT_GT(shedder.stats().decode_time, 150000);
+  EXPECT_EQ(shedder.stats().queued_pictures, 0u);
+  EXPECT_FALSE(shedder.admit(HEVC_NAL_TRAIL_N, 1, now));
+  EXPECT_EQ(shedder.stats().level, 1);
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/renderer/hevc_nal.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+// Writes an SPS RBSP bit by bit and escapes it into a NAL unit payload,
+// inserting emulation prevention bytes as an encoder would.
+class SpsWriter {
+ public:
+  void Bits(uint32_t value, int count) {
+    for (int i = count - 1; i >= 0; i--) {
+      bits_.push_back((value >> i) & 1);
+    }
+  }
+
+  void Ue(uint32_t value) {
+    const uint64_t coded = uint64_t(value) + 1;
+    int length = 0;
+    while ((coded >> length) > 1) {
+      length++;
+    }
+    Bits(0, length);
+    for (int i = length; i >= 0; i--) {
+      bits_.push_back((coded >> i) & 1);
+    }
+  }
+
+  // The NAL unit, header included, with rbsp_trailing_bits.
+  std::vector<uint8_t> Nal() const {
+    std::vector<bool> bits = bits_;
+    bits.push_back(true);
+    while (bits.size() % 8 != 0) {
+      bits.push_back(false);
+    }
+    std::vector<uint8_t> nal = {HEVC_NAL_SPS << 1, 1};
+    int zeros = 0;
+    for (size_t i = 0; i < bits.size(); i += 8) {
+      uint8_t byte = 0;
+      for (size_t j = 0; j < 8; j++) {
+        byte = (byte << 1) | bits[i + j];
+      }
+      if (zeros >= 2 && byte <= 3) {
+        nal.push_back(3);
+        zeros = 0;
+      }
+      nal.push_back(byte);
+      zeros = byte == 0 ? zeros + 1 : 0;
+    }
+    return nal;
+  }
+
+ private:
+  std::vector<bool> bits_;
+};
+
+// An SPS up to its conformance window, with one sub-layer.
+SpsWriter WriteSps(uint32_t width, uint32_t height, uint32_t crop_bottom) {
+  SpsWriter writer;
+  writer.Bits(0, 4);   // sps_video_parameter_set_id
+  writer.Bits(0, 3);   // sps_max_sub_layers_minus1
+  writer.Bits(1, 1);   // sps_temporal_id_nesting_flag
+  writer.Bits(1, 8);   // general profile space, tier, Main profile
+  writer.Bits(0, 88);  // compatibility and constraint flags, all zero
+  writer.Ue(0);        // sps_seq_parameter_set_id
+  writer.Ue(1);        // chroma_format_idc, 4:2:0
+  writer.Ue(width);
+  writer.Ue(height);
+  writer.Bits(crop_bottom != 0, 1);
+  if (crop_bottom != 0) {
+    writer.Ue(0);
+    writer.Ue(0);
+    writer.Ue(0);
+    writer.Ue(crop_bottom);
+  }
+  return writer;
+}
+
+}  // namespace
+
+TEST(HevcSps, ParsesSizeThroughEmulationPrevention) {
+  // The zero flags force emulation prevention bytes into the payload.
+  const std::vector<uint8_t> nal = WriteSps(1920, 1088, 4).Nal();
+  HevcSps sps;
+  ASSERT_TRUE(hevcParseSps(nal.data(), nal.size(), sps));
+  EXPECT_EQ(sps.pic_width, 1920);
+  EXPECT_EQ(sps.pic_height, 1088);
+  // Offsets are in chroma samples, two luma rows each for 4:2:0.
+  EXPECT_EQ(sps.crop_bottom, 8);
+  EXPECT_EQ(sps.width, 1920);
+  EXPECT_EQ(sps.height, 1080);
+}
+
+TEST(HevcSps, RejectsTruncatedSps) {
+  std::vector<uint8_t> nal = WriteSps(1280, 720, 0).Nal();
+  nal.resize(nal.size() - 3);
+  HevcSps sps;
+  EXPECT_FALSE(hevcParseSps(nal.data(), nal.size(), sps));
+}
+
+TEST(HevcSps, RejectsOverlongExpGolombPrefix) {
+  // 32 leading zeros cannot start any ue(v) the SPS holds.
+  SpsWriter overlong;
+  overlong.Bits(0, 4);
+  overlong.Bits(0, 3);
+  overlong.Bits(1, 1);
+  overlong.Bits(1, 8);
+  overlong.Bits(0, 88);
+  overlong.Ue(0);
+  overlong.Ue(1);
+  overlong.Bits(0, 32);
+  overlong.Bits(0xffffffff, 32);
+  const std::vector<uint8_t> nal = overlong.Nal();
+  HevcSps sps;
+  EXPECT_FALSE(hevcParseSps(nal.data(), nal.size(), sps));
+}
+
+TEST(HevcSps, RejectsOtherNalTypes) {
+  std::vector<uint8_t> nal = WriteSps(1280, 720, 0).Nal();
+  nal[0] = HEVC_NAL_PPS << 1;
+  HevcSps sps;
+  EXPECT_FALSE(hevcParseSps(nal.data(), nal.size(), sps));
+}
+
+TEST(HevcForEachNal, SplitsOnThreeAndFourByteStartCodes) {
+  const uint8_t stream[] = {0, 0, 0, 1, 0x40, 0x01, 0xaa,
+                            0, 0, 1, 0x42, 0x01, 0xbb, 0xcc};
+  std::vector<std::vector<uint8_t>> nals;
+  hevcForEachNal(stream, sizeof(stream), [&](const uint8_t* nal, size_t size) {
+    nals.emplace_back(nal, nal + size);
+  });
+  ASSERT_EQ(nals.size(), 2u);
+  EXPECT_EQ(nals[0], (std::vector<uint8_t>{0x40, 0x01, 0xaa}));
+  EXPECT_EQ(nals[1], (std::vector<uint8_t>{0x42, 0x01, 0xbb, 0xcc}));
+  EXPECT_EQ(hevcNalType(nals[0].data()), HEVC_NAL_VPS);
+  EXPECT_EQ(hevcNalType(nals[1].data()), HEVC_NAL_SPS);
+}
+
+TEST(HevcForEachNal, TreatsDataWithoutStartCodeAsOneNal) {
+  const uint8_t nal[] = {0x26, 0x01, 0xaf};
+  int count = 0;
+  hevcForEachNal(nal, sizeof(nal), [&](const uint8_t* data, size_t size) {
+    count++;
+    EXPECT_EQ(data, nal);
+    EXPECT_EQ(size, sizeof(nal));
+  });
+  EXPECT_EQ(count, 1);
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/renderer/jitter_buffer.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+const int64_t kStart = 1000000;
+// 10 ms between packets, on the wire and in RTP time.
+const int64_t kInterval = 10000;
+const uint32_t kRtpInterval = 900;
+
+// Feeds a jitter buffer packets whose payload is their sequence number.
+class Feeder {
+ public:
+  void Push(uint16_t sequence, int64_t now) {
+    Push(sequence, uint32_t(sequence) * kRtpInterval, now);
+  }
+
+  void Push(uint16_t sequence, uint32_t timestamp, int64_t now) {
+    const uint8_t data[] = {uint8_t(sequence >> 8), uint8_t(sequence)};
+    RtpPacket packet;
+    packet.sequence = sequence;
+    packet.timestamp = timestamp;
+    buffer.push(packet, data, sizeof(data), now);
+  }
+
+  std::vector<int> Pop(int64_t now) {
+    std::vector<int> sequences;
+    buffer.pop(now, [&](const uint8_t* data, size_t size) {
+      EXPECT_EQ(size, 2u);
+      sequences.push_back((data[0] << 8) | data[1]);
+    });
+    return sequences;
+  }
+
+  JitterBuffer buffer;
+};
+
+}  // namespace
+
+TEST(JitterBuffer, ReleasesInOrderPacketsAtOnce) {
+  Feeder feeder;
+  for (int i = 0; i < 3; i++) {
+    feeder.Push(100 + i, kStart + i * kInterval);
+  }
+  EXPECT_EQ(feeder.Pop(kStart + 2 * kInterval),
+            (std::vector<int>{100, 101, 102}));
+  EXPECT_EQ(feeder.buffer.nextDeadline(), -1);
+  const JitterBufferStats stats = feeder.buffer.stats();
+  EXPECT_EQ(stats.packets_lost, 0u);
+  EXPECT_EQ(stats.packets_reordered, 0u);
+  EXPECT_EQ(stats.jitter, 0);
+}
+
+TEST(JitterBuffer, PutsReorderedPacketsBackInSequence) {
+  Feeder feeder;
+  feeder.Push(1, kStart);
+  feeder.Push(3, kStart + kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval), (std::vector<int>{1}));
+  EXPECT_NE(feeder.buffer.nextDeadline(), -1);
+  feeder.Push(2, kStart + kInterval + 500);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval + 500), (std::vector<int>{2, 3}));
+  const JitterBufferStats stats = feeder.buffer.stats();
+  EXPECT_EQ(stats.packets_reordered, 1u);
+  EXPECT_EQ(stats.packets_lost, 0u);
+}
+
+TEST(JitterBuffer, GivesUpOnMissingPacketAfterTargetDelay) {
+  Feeder feeder;
+  feeder.Push(1, kStart);
+  feeder.Push(4, kStart + kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval), (std::vector<int>{1}));
+  const int64_t deadline = feeder.buffer.nextDeadline();
+  EXPECT_EQ(deadline, kStart + kInterval + feeder.buffer.stats().target_delay);
+  EXPECT_TRUE(feeder.Pop(deadline - 1).empty());
+  EXPECT_EQ(feeder.Pop(deadline), (std::vector<int>{4}));
+  EXPECT_EQ(feeder.buffer.stats().packets_lost, 2u);
+  EXPECT_EQ(feeder.buffer.nextDeadline(), -1);
+
+  // The packets given up on are late if they turn up after all.
+  feeder.Push(2, deadline + 1);
+  EXPECT_TRUE(feeder.Pop(deadline + 1).empty());
+  EXPECT_EQ(feeder.buffer.stats().packets_late, 1u);
+}
+
+TEST(JitterBuffer, DropsDuplicates) {
+  Feeder feeder;
+  feeder.Push(1, kStart);
+  feeder.Push(3, kStart + kInterval);
+  feeder.Push(3, kStart + kInterval);
+  feeder.Push(2, kStart + kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval), (std::vector<int>{1, 2, 3}));
+  EXPECT_EQ(feeder.buffer.stats().packets_duplicate, 1u);
+}
+
+TEST(JitterBuffer, ContinuesAcrossSequenceWrap) {
+  Feeder feeder;
+  feeder.Push(65534, kStart);
+  feeder.Push(0, kStart + 2 * kInterval);
+  feeder.Push(65535, kStart + 2 * kInterval);
+  feeder.Push(1, kStart + 3 * kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + 3 * kInterval),
+            (std::vector<int>{65534, 65535, 0, 1}));
+  EXPECT_EQ(feeder.buffer.stats().packets_lost, 0u);
+}
+
+TEST(JitterBuffer, TargetDelayFollowsReorderDelay) {
+  Feeder feeder;
+  const int64_t initial = feeder.buffer.stats().target_delay;
+  feeder.Push(1, kStart);
+  feeder.Push(3, kStart + kInterval);
+  feeder.Pop(kStart + kInterval);
+  // The hole is filled just before the deadline.
+  const int64_t late = initial - 100;
+  feeder.Push(2, kStart + kInterval + late);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval + late), (std::vector<int>{2, 3}));
+  EXPECT_GT(feeder.buffer.stats().target_delay, late);
+}
+
+TEST(JitterBuffer, TargetDelayFollowsJitter) {
+  Feeder feeder;
+  for (int i = 0; i < 50; i++) {
+    // Arrivals alternate between 4 ms early and 4 ms late.
+    const int64_t skew = i % 2 == 0 ? -4000 : 4000;
+    feeder.Push(i, kStart + i * kInterval + skew);
+  }
+  const JitterBufferStats stats = feeder.buffer.stats();
+  EXPECT_GT(stats.jitter, 4000);
+  EXPECT_GE(stats.target_delay, 2 * stats.jitter);
+}
+
+TEST(JitterBuffer, RestartsFarAheadOfTheWindow) {
+  Feeder feeder;
+  feeder.Push(1, kStart);
+  EXPECT_EQ(feeder.Pop(kStart), (std::vector<int>{1}));
+  feeder.Push(5000, kStart + kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + kInterval), (std::vector<int>{5000}));
+  EXPECT_EQ(feeder.buffer.stats().packets_lost, 4998u);
+}
+
+TEST(JitterBuffer, FollowsSenderRestartToLowerSequenceNumbers) {
+  Feeder feeder;
+  for (int i = 0; i < 3; i++) {
+    feeder.Push(5000 + i, kStart + i * kInterval);
+  }
+  EXPECT_EQ(feeder.Pop(kStart + 2 * kInterval),
+            (std::vector<int>{5000, 5001, 5002}));
+
+  // The first packet far behind could be a stray one; the next in
+  // sequence after it confirms the restart.
+  feeder.Push(100, kStart + 3 * kInterval);
+  EXPECT_TRUE(feeder.Pop(kStart + 3 * kInterval).empty());
+  feeder.Push(101, kStart + 4 * kInterval);
+  feeder.Push(102, kStart + 5 * kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + 5 * kInterval), (std::vector<int>{101, 102}));
+  const JitterBufferStats stats = feeder.buffer.stats();
+  EXPECT_EQ(stats.packets_late, 1u);
+  EXPECT_EQ(stats.packets_lost, 0u);
+}
+
+TEST(JitterBuffer, IgnoresAStrayPacketFarBehind) {
+  Feeder feeder;
+  feeder.Push(5000, kStart);
+  feeder.Push(1000, kStart + kInterval);
+  feeder.Push(5001, kStart + kInterval);
+  feeder.Push(5002, kStart + 2 * kInterval);
+  EXPECT_EQ(feeder.Pop(kStart + 2 * kInterval),
+            (std::vector<int>{5000, 5001, 5002}));
+  EXPECT_EQ(feeder.buffer.stats().packets_late, 1u);
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/renderer/reverse_gop_cache.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+// A decoded frame tagged with its decode order in its first byte.
+DecodedFrame Frame(uint8_t index) {
+  DecodedFrame frame;
+  frame.data = {index};
+  return frame;
+}
+
+// Pops every frame ready, as (decode index, pts) pairs.
+std::vector<std::pair<int, int64_t>> PopAll(ReverseGopCache& cache) {
+  std::vector<std::pair<int, int64_t>> frames;
+  DecodedFrame frame;
+  while (cache.pop(frame)) {
+    frames.emplace_back(frame.data[0], frame.pts);
+  }
+  return frames;
+}
+
+}  // namespace
+
+TEST(ReverseGopCache, ReleasesACompleteGroupLastFirst) {
+  ReverseGopCache cache;
+  cache.expectGroup(1, 3, 1, 1000, 300);
+  for (uint8_t i = 0; i < 3; i++) {
+    DecodedFrame frame = Frame(i);
+    EXPECT_TRUE(cache.take(1, frame));
+  }
+  EXPECT_EQ(PopAll(cache), (std::vector<std::pair<int, int64_t>>{
+                               {2, 1000}, {1, 1100}, {0, 1200}}));
+}
+
+TEST(ReverseGopCache, FinishingTheDecoderCompletesAShortGroup) {
+  // The decoder gave two of the three frames announced.
+  ReverseGopCache cache;
+  cache.expectGroup(1, 3, 1, 1000, 300);
+  for (uint8_t i = 0; i < 2; i++) {
+    DecodedFrame frame = Frame(i);
+    EXPECT_TRUE(cache.take(1, frame));
+  }
+  DecodedFrame frame;
+  EXPECT_FALSE(cache.pop(frame));
+  cache.finishDecoder(1);
+  EXPECT_EQ(PopAll(cache), (std::vector<std::pair<int, int64_t>>{
+                               {1, 1000}, {0, 1150}}));
+}
+
+TEST(ReverseGopCache, KeepsGroupsOfSuccessiveDecodersApart) {
+  ReverseGopCache cache;
+  cache.expectGroup(1, 2, 1, 1000, 200);
+  cache.expectGroup(2, 2, 1, 1200, 200);
+  DecodedFrame first = Frame(0);
+  EXPECT_TRUE(cache.take(1, first));
+  // The second decoder delivers before the first has drained.
+  for (uint8_t i = 10; i < 12; i++) {
+    DecodedFrame frame = Frame(i);
+    EXPECT_TRUE(cache.take(2, frame));
+  }
+  DecodedFrame frame;
+  EXPECT_FALSE(cache.pop(frame));
+
+  cache.finishDecoder(1);
+  cache.finishDecoder(2);
+  EXPECT_EQ(PopAll(cache), (std::vector<std::pair<int, int64_t>>{
+                               {0, 1000}, {11, 1200}, {10, 1300}}));
+}
+
+TEST(ReverseGopCache, LeavesSurplusAndStridedFramesToTheCaller) {
+  ReverseGopCache cache;
+  cache.expectGroup(1, 3, 2, 0, 200);
+  std::vector<int> left;
+  for (uint8_t i = 0; i < 4; i++) {
+    DecodedFrame frame = Frame(i);
+    EXPECT_TRUE(cache.take(1, frame));
+    if (!frame.data.empty()) {
+      left.push_back(frame.data[0]);
+    }
+  }
+  EXPECT_EQ(left, (std::vector<int>{1, 3}));
+  EXPECT_EQ(PopAll(cache),
+            (std::vector<std::pair<int, int64_t>>{{2, 0}, {0, 100}}));
+
+  // Frames of a decoder without groups are not the cache's.
+  DecodedFrame frame = Frame(9);
+  EXPECT_FALSE(cache.take(2, frame));
+}
+
+TEST(ReverseGopCache, HandsUnstartedGroupsToTheReplacementDecoder) {
+  ReverseGopCache cache;
+  cache.expectGroup(1, 2, 1, 0, 200);
+  cache.handOver(1, 2);
+  // The replaced decoder draining does not end the group.
+  cache.finishDecoder(1);
+  DecodedFrame frame;
+  EXPECT_FALSE(cache.pop(frame));
+  for (uint8_t i = 0; i < 2; i++) {
+    DecodedFrame decoded = Frame(i);
+    EXPECT_TRUE(cache.take(2, decoded));
+  }
+  EXPECT_EQ(PopAll(cache),
+            (std::vector<std::pair<int, int64_t>>{{1, 0}, {0, 100}}));
+}
+
+}  // namespace test
+}  // namespace renderer
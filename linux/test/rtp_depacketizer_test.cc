@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "include/renderer/hevc_nal.h"
+#include "include/renderer/rtp_depacketizer.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+// Collects the access units a depacketizer emits.
+class Collector {
+ public:
+  Collector()
+      : depacketizer_([this](const uint8_t* data, size_t size,
+                             uint32_t timestamp, bool is_damaged) {
+          units.emplace_back(data, data + size);
+          timestamps.push_back(timestamp);
+          damaged.push_back(is_damaged);
+        }) {}
+
+  void Push(uint16_t sequence, uint32_t timestamp, bool marker,
+            const Bytes& payload) {
+    RtpPacket packet;
+    packet.sequence = sequence;
+    packet.timestamp = timestamp;
+    packet.marker = marker;
+    packet.payload = payload.data();
+    packet.payload_size = payload.size();
+    depacketizer_.push(packet);
+  }
+
+  RtpDepacketizer& depacketizer() { return depacketizer_; }
+
+  std::vector<Bytes> units;
+  std::vector<uint32_t> timestamps;
+  std::vector<bool> damaged;
+
+ private:
+  RtpDepacketizer depacketizer_;
+};
+
+// A TRAIL_R slice NAL unit with the given payload byte.
+Bytes Slice(uint8_t body) { return Bytes{0x02, 0x01, 0x80, body}; }
+
+Bytes AnnexB(const std::vector<Bytes>& nals) {
+  Bytes stream;
+  for (const Bytes& nal : nals) {
+    stream.insert(stream.end(), {0, 0, 0, 1});
+    stream.insert(stream.end(), nal.begin(), nal.end());
+  }
+  return stream;
+}
+
+// A fragmentation unit of an IDR_W_RADL NAL unit.
+Bytes Fragment(bool start, bool end, const Bytes& data) {
+  Bytes fu = {49 << 1, 0x01,
+              uint8_t((start ? 0x80 : 0) | (end ? 0x40 : 0) |
+                      HEVC_NAL_IDR_W_RADL)};
+  fu.insert(fu.end(), data.begin(), data.end());
+  return fu;
+}
+
+}  // namespace
+
+TEST(RtpPacket, SkipsCsrcsExtensionAndPadding) {
+  const Bytes data = {
+      0xb1, 0x80 | 96, 0x12, 0x34,  // V=2, P, X, CC=1, M, PT=96, sequence
+      0, 0, 0x0b, 0xb8,             // timestamp 3000
+      0xde, 0xad, 0xbe, 0xef,       // SSRC
+      1, 2, 3, 4,                   // CSRC
+      0xbe, 0xde, 0, 1,             // extension header, one word
+      9, 9, 9, 9,                   // extension
+      0x02, 0x01, 0xaa,             // payload
+      0, 2,                         // padding
+  };
+  RtpPacket packet;
+  ASSERT_TRUE(parseRtpPacket(data.data(), data.size(), packet));
+  EXPECT_TRUE(packet.marker);
+  EXPECT_EQ(packet.payload_type, 96);
+  EXPECT_EQ(packet.sequence, 0x1234);
+  EXPECT_EQ(packet.timestamp, 3000u);
+  EXPECT_EQ(packet.ssrc, 0xdeadbeefu);
+  EXPECT_EQ(Bytes(packet.payload, packet.payload + packet.payload_size),
+            (Bytes{0x02, 0x01, 0xaa}));
+}
+
+TEST(RtpPacket, RejectsPaddingBeyondPayload) {
+  const Bytes data = {0xa0, 96, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 40};
+  RtpPacket packet;
+  EXPECT_FALSE(parseRtpPacket(data.data(), data.size(), packet));
+}
+
+TEST(RtpDepacketizer, EmitsSingleNalUnitOnMarker) {
+  Collector collector;
+  collector.Push(1, 3000, true, Slice(0xaa));
+  ASSERT_EQ(collector.units.size(), 1u);
+  EXPECT_EQ(collector.units[0], AnnexB({Slice(0xaa)}));
+  EXPECT_EQ(collector.timestamps[0], 3000u);
+}
+
+TEST(RtpDepacketizer, FlushesOnTimestampChange) {
+  Collector collector;
+  collector.Push(1, 3000, false, Slice(0xaa));
+  collector.Push(2, 3000, false, Slice(0xbb));
+  EXPECT_TRUE(collector.units.empty());
+  collector.Push(3, 6000, false, Slice(0xcc));
+  ASSERT_EQ(collector.units.size(), 1u);
+  EXPECT_EQ(collector.units[0], AnnexB({Slice(0xaa), Slice(0xbb)}));
+  EXPECT_EQ(collector.timestamps[0], 3000u);
+}
+
+TEST(RtpDepacketizer, SplitsAggregationPackets) {
+  const Bytes vps = {0x40, 0x01, 0x0c};
+  const Bytes sps = {0x42, 0x01, 0x01, 0x60};
+  Bytes ap = {48 << 1, 0x01};
+  for (const Bytes& nal : {vps, sps}) {
+    ap.push_back(0);
+    ap.push_back(uint8_t(nal.size()));
+    ap.insert(ap.end(), nal.begin(), nal.end());
+  }
+  Collector collector;
+  collector.Push(1, 3000, true, ap);
+  ASSERT_EQ(collector.units.size(), 1u);
+  EXPECT_EQ(collector.units[0], AnnexB({vps, sps}));
+}
+
+TEST(RtpDepacketizer, ReassemblesFragmentationUnits) {
+  Collector collector;
+  collector.Push(1, 3000, false, Fragment(true, false, {0xaf, 1}));
+  collector.Push(2, 3000, false, Fragment(false, false, {2, 3}));
+  collector.Push(3, 3000, true, Fragment(false, true, {4}));
+  ASSERT_EQ(collector.units.size(), 1u);
+  const Bytes idr = {HEVC_NAL_IDR_W_RADL << 1, 0x01, 0xaf, 1, 2, 3, 4};
+  EXPECT_EQ(collector.units[0], AnnexB({idr}));
+  EXPECT_EQ(collector.depacketizer().packetsLost(), 0u);
+}
+
+TEST(RtpDepacketizer, DropsFragmentAfterLoss) {
+  Collector collector;
+  collector.Push(1, 3000, false, Slice(0xaa));
+  collector.Push(2, 3000, false, Fragment(true, false, {0xaf, 1}));
+  collector.Push(4, 3000, true, Fragment(false, true, {4}));
+  ASSERT_EQ(collector.units.size(), 1u);
+  EXPECT_EQ(collector.units[0], AnnexB({Slice(0xaa)}));
+  EXPECT_TRUE(collector.damaged[0]);
+  EXPECT_EQ(collector.depacketizer().packetsLost(), 1u);
+}
+
+TEST(RtpDepacketizer, BlamesLossAfterAMarkerOnTheNextAccessUnit) {
+  Collector collector;
+  collector.Push(1, 3000, true, Slice(0xaa));
+  // 2 and 3, the start of the next access unit, are lost.
+  collector.Push(4, 6000, true, Slice(0xcc));
+  collector.Push(5, 9000, true, Slice(0xdd));
+  EXPECT_EQ(collector.damaged, (std::vector<bool>{false, true, false}));
+}
+
+TEST(RtpDepacketizer, BlamesLossBeforeAMarkerOnBothAccessUnits) {
+  Collector collector;
+  collector.Push(1, 3000, false, Slice(0xaa));
+  // The lost packet may have ended the first access unit or begun the
+  // second.
+  collector.Push(3, 6000, true, Slice(0xcc));
+  collector.Push(4, 9000, true, Slice(0xdd));
+  EXPECT_EQ(collector.damaged, (std::vector<bool>{true, true, false}));
+}
+
+TEST(RtpDepacketizer, BlamesLossWithinAnAccessUnitOnItAlone) {
+  Collector collector;
+  collector.Push(1, 3000, true, Slice(0xaa));
+  collector.Push(2, 6000, false, Slice(0xbb));
+  collector.Push(4, 6000, true, Slice(0xcc));
+  collector.Push(5, 9000, true, Slice(0xdd));
+  EXPECT_EQ(collector.damaged, (std::vector<bool>{false, true, false}));
+}
+
+TEST(RtpDepacketizer, CountsLossAcrossSequenceWrap) {
+  Collector collector;
+  collector.Push(65534, 3000, true, Slice(0xaa));
+  collector.Push(2, 6000, true, Slice(0xbb));
+  EXPECT_EQ(collector.units.size(), 2u);
+  EXPECT_EQ(collector.depacketizer().packetsLost(), 3u);
+}
+
+TEST(RtpDepacketizer, DropsDuplicateAndLatePacketsWithoutCountingLoss) {
+  Collector collector;
+  collector.Push(10, 3000, true, Slice(0xaa));
+  collector.Push(10, 3000, true, Slice(0xaa));
+  collector.Push(12, 6000, true, Slice(0xcc));
+  // 11 arrives after 12: given up on already.
+  collector.Push(11, 3000, true, Slice(0xbb));
+  ASSERT_EQ(collector.units.size(), 2u);
+  EXPECT_EQ(collector.units[1], AnnexB({Slice(0xcc)}));
+  EXPECT_EQ(collector.depacketizer().packetsLost(), 1u);
+}
+
+TEST(RtpDepacketizer, FollowsSenderRestartWithoutCountingLoss) {
+  Collector collector;
+  collector.Push(5000, 3000, true, Slice(0xaa));
+  collector.Push(100, 6000, true, Slice(0xbb));
+  collector.Push(101, 9000, true, Slice(0xcc));
+  EXPECT_EQ(collector.units.size(), 3u);
+  EXPECT_EQ(collector.depacketizer().packetsLost(), 0u);
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <array>
+#include <vector>
+
+#include "include/renderer/timeshift_ring.h"
+
+namespace renderer {
+namespace test {
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+const int64_t kSecond = 1000000;
+// 10 fps, with an IRAP every 5 pictures.
+const int64_t kFrameInterval = 100000;
+const int kGroupSize = 5;
+
+// Appends one picture per unit, each unit filled with its own index.
+class Recorder {
+ public:
+  explicit Recorder(size_t unit_size = 100) : unit_size_(unit_size) {}
+
+  void Append(bool irap, bool has_sps = true) {
+    const Bytes data(unit_size_, uint8_t(appended));
+    ring.append(data.data(), data.size(), appended * kFrameInterval, 1, irap,
+                has_sps, parameter_sets);
+    appended++;
+  }
+
+  void AppendGroups(int groups) {
+    for (int i = 0; i < groups * kGroupSize; i++) {
+      Append(appended % kGroupSize == 0);
+    }
+  }
+
+  // The stream of units first..appended-1.
+  Bytes Units(int first) const {
+    Bytes stream;
+    for (int i = first; i < appended; i++) {
+      stream.insert(stream.end(), unit_size_, uint8_t(i));
+    }
+    return stream;
+  }
+
+  TimeshiftRing ring;
+  std::array<Bytes, 3> parameter_sets;
+  int appended = 0;
+
+ private:
+  size_t unit_size_;
+};
+
+}  // namespace
+
+TEST(TimeshiftRing, IgnoresInputUntilConfigured) {
+  Recorder recorder;
+  EXPECT_FALSE(recorder.ring.enabled());
+  recorder.AppendGroups(1);
+  EXPECT_EQ(recorder.ring.stats().units, 0u);
+  Bytes stream;
+  TimeshiftExport info;
+  EXPECT_FALSE(recorder.ring.copyOut(0, stream, info));
+}
+
+TEST(TimeshiftRing, KeepsWholeGroupsCoveringTheDuration) {
+  Recorder recorder;
+  recorder.ring.configure(kSecond, 1 << 20);
+  ASSERT_TRUE(recorder.ring.enabled());
+  recorder.AppendGroups(10);
+
+  // Each group is half a second; the window starts at the IRAP before
+  // the newest second of input.
+  const TimeshiftStats stats = recorder.ring.stats();
+  EXPECT_EQ(stats.units, 15u);
+  EXPECT_EQ(stats.keyframes, 3u);
+  EXPECT_EQ(stats.duration, 14 * kFrameInterval);
+  EXPECT_EQ(stats.bytes, 15 * 100u);
+
+  Bytes stream;
+  TimeshiftExport info;
+  ASSERT_TRUE(recorder.ring.copyOut(10 * kSecond, stream, info));
+  EXPECT_EQ(stream, recorder.Units(35));
+  EXPECT_EQ(info.pictures, 15u);
+  EXPECT_EQ(info.bytes, stream.size());
+  EXPECT_DOUBLE_EQ(info.fps, 10.0);
+}
+
+TEST(TimeshiftRing, EvictsToFitTheArenaAndStartsAtAnIrap) {
+  // Room for 12 units. Making room for the last unit evicts the IRAP at
+  // unit 10, and with it the rest of its group.
+  Recorder recorder;
+  recorder.ring.configure(60 * kSecond, 1200);
+  recorder.AppendGroups(4);
+  recorder.Append(true);
+  recorder.Append(false);
+  recorder.Append(false);
+
+  const TimeshiftStats stats = recorder.ring.stats();
+  EXPECT_EQ(stats.capacity, 1200u);
+  EXPECT_LE(stats.bytes, 1200u);
+  EXPECT_EQ(stats.units, 8u);
+  EXPECT_EQ(stats.keyframes, 2u);
+
+  // The arena has wrapped, and the stream still comes out in order.
+  Bytes stream;
+  TimeshiftExport info;
+  ASSERT_TRUE(recorder.ring.copyOut(60 * kSecond, stream, info));
+  EXPECT_EQ(stream, recorder.Units(15));
+}
+
+TEST(TimeshiftRing, CopiesOutFromTheIrapAtOrBeforeTheRequestedTime) {
+  Recorder recorder;
+  recorder.ring.configure(60 * kSecond, 1 << 20);
+  recorder.AppendGroups(4);
+
+  // The newest unit arrived at 1.9 s; 0.7 s back is 1.2 s, after the
+  // IRAP at 1.0 s.
+  Bytes stream;
+  TimeshiftExport info;
+  ASSERT_TRUE(recorder.ring.copyOut(7 * kFrameInterval, stream, info));
+  EXPECT_EQ(stream, recorder.Units(10));
+  EXPECT_EQ(info.duration, 9 * kFrameInterval);
+
+  // Further back than anything kept falls back to the first IRAP.
+  ASSERT_TRUE(recorder.ring.copyOut(60 * kSecond, stream, info));
+  EXPECT_EQ(stream, recorder.Units(0));
+}
+
+TEST(TimeshiftRing, StoresParameterSetsInFrontOfIrapsWithoutThem) {
+  Recorder recorder(4);
+  recorder.parameter_sets = {Bytes{0, 0, 1, 0x40}, Bytes{0, 0, 1, 0x42},
+                             Bytes{0, 0, 1, 0x44}};
+  recorder.ring.configure(60 * kSecond, 1 << 20);
+  recorder.Append(true, false);
+  recorder.Append(false);
+  recorder.Append(true, true);
+
+  Bytes stream;
+  TimeshiftExport info;
+  ASSERT_TRUE(recorder.ring.copyOut(60 * kSecond, stream, info));
+  const Bytes expected = {0, 0, 1, 0x40, 0, 0, 1, 0x42, 0, 0, 1, 0x44,
+                          0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2};
+  EXPECT_EQ(stream, expected);
+}
+
+TEST(TimeshiftRing, DropsEverythingForAUnitLargerThanTheArena) {
+  Recorder recorder;
+  recorder.ring.configure(60 * kSecond, 1000);
+  recorder.AppendGroups(1);
+  const Bytes huge(2000, 0xff);
+  recorder.ring.append(huge.data(), huge.size(), kSecond, 1, true, true,
+                       recorder.parameter_sets);
+  EXPECT_EQ(recorder.ring.stats().units, 0u);
+}
+
+TEST(TimeshiftRing, ConfiguringZeroFreesTheRing) {
+  Recorder recorder;
+  recorder.ring.configure(kSecond, 1 << 20);
+  recorder.AppendGroups(1);
+  recorder.ring.configure(0, 1 << 20);
+  EXPECT_FALSE(recorder.ring.enabled());
+  const TimeshiftStats stats = recorder.ring.stats();
+  EXPECT_EQ(stats.capacity, 0u);
+  EXPECT_EQ(stats.units, 0u);
+}
+
+}  // namespace test
+}  // namespace renderer
@@ -0,0 +1,155 @@
+#include "include/renderer/texture_swap_chain.h"
+
+#include "include/renderer/opengl_renderer.h"
+
+static void deleteFence(GLsync &fence)
+{
+    if (fence)
+    {
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void TextureSwapChain::setBuffer(int index, GLuint name, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers[index].name = name;
+    buffers[index].width = width;
+    buffers[index].height = height;
+}
+
+std::vector<GLuint> TextureSwapChain::names()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<GLuint> result;
+    for (auto &buffer : buffers)
+    {
+        if (buffer.name != 0)
+        {
+            result.push_back(buffer.name);
+        }
+    }
+    return result;
+}
+
+std::vector<GLuint> TextureSwapChain::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<GLuint> result;
+    for (auto &buffer : buffers)
+    {
+        if (buffer.name != 0)
+        {
+            result.push_back(buffer.name);
+        }
+        deleteFence(buffer.upload_fence);
+        deleteFence(buffer.release_fence);
+        buffer = SwapChainBuffer();
+    }
+    front = -1;
+    ready = -1;
+    return result;
+}
+
+int TextureSwapChain::acquire()
+{
+    GLsync release_fence = nullptr;
+    int index = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        while (index == front || index == ready)
+        {
+            index++;
+        }
+        // A stale upload fence from a frame that was overtaken before being
+        // shown is no longer needed.
+        deleteFence(buffers[index].upload_fence);
+        release_fence = buffers[index].release_fence;
+        buffers[index].release_fence = nullptr;
+    }
+
+    if (release_fence)
+    {
+        glWaitSync(release_fence, 0, GL_TIMEOUT_IGNORED);
+        glDeleteSync(release_fence);
+    }
+    return index;
+}
+
+SwapChainBuffer TextureSwapChain::buffer(int index)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return buffers[index];
+}
+
+void TextureSwapChain::publish(int index)
+{
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    // The fence is waited on from another context, so it must reach the GPU.
+    glFlush();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers[index].upload_fence = fence;
+    ready = index;
+}
+
+void TextureSwapChain::publishPlaceholder(OpenGLRenderer &renderer)
+{
+    const int index = acquire();
+    GLuint name = buffer(index).name;
+    if (name != 0)
+    {
+        glDeleteTextures(1, &name);
+    }
+    name = renderer.genTexture(1, 1, true);
+    setBuffer(index, name, 1, 1);
+    publish(index);
+}
+
+bool TextureSwapChain::newest(SwapChainBuffer &buffer)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const int index = ready != -1 ? ready : front;
+    if (index == -1)
+    {
+        return false;
+    }
+    buffer = buffers[index];
+    return true;
+}
+
+bool TextureSwapChain::latest(uint32_t *name, uint32_t *width, uint32_t *height)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ready != -1)
+    {
+        if (front != -1)
+        {
+            deleteFence(buffers[front].release_fence);
+            buffers[front].release_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+        }
+        front = ready;
+        ready = -1;
+
+        SwapChainBuffer &buffer = buffers[front];
+        if (buffer.upload_fence)
+        {
+            glWaitSync(buffer.upload_fence, 0, GL_TIMEOUT_IGNORED);
+            deleteFence(buffer.upload_fence);
+        }
+    }
+
+    // Only before the first publish(), which owners do before registering
+    // the texture.
+    if (front == -1)
+    {
+        return false;
+    }
+    const SwapChainBuffer &buffer = buffers[front];
+    *name = buffer.name;
+    *width = buffer.width;
+    *height = buffer.height;
+    return true;
+}
@@ -0,0 +1,411 @@
+#include "include/renderer/thumbnail_service.h"
+
+#include <gtk/gtk.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <map>
+
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "include/renderer/h265_decoder.h"
+#include "include/renderer/hevc_file.h"
+#include "include/renderer/hevc_nal.h"
+
+namespace
+{
+    const char kJpegQuality[] = "85";
+    const uint8_t kEndOfSequence[] = {0, 0, 0, 1, HEVC_NAL_EOS << 1, 1};
+
+    std::string cachePath(const std::string &dir, const HevcFile &file, const char *path,
+                          uint64_t offset, int width, int height, ThumbnailFormat format)
+    {
+        // The path, size and modification time identify the file contents.
+        const size_t key = std::hash<std::string>()(path) ^
+                           std::hash<uint64_t>()(file.fileSize()) * 31 ^
+                           std::hash<int64_t>()(file.modificationTime()) * 131;
+        char name[96];
+        snprintf(name, sizeof(name), "%016zx-%llu-%dx%d.%s", key, (unsigned long long)offset,
+                 width, height, format == THUMBNAIL_FORMAT_JPEG ? "jpg" : "rgba");
+        return dir + "/" + name;
+    }
+
+    bool readFile(const std::string &path, std::vector<uint8_t> &data)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+        fseek(file, 0, SEEK_END);
+        const long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? size : 0);
+        const bool ok = size > 0 && fread(data.data(), size, 1, file) == 1;
+        fclose(file);
+        return ok;
+    }
+
+    void writeFile(const std::string &path, const std::vector<uint8_t> &data)
+    {
+        const std::string temporary_path = path + ".tmp";
+        FILE *file = fopen(temporary_path.c_str(), "wb");
+        if (!file)
+        {
+            return;
+        }
+        bool ok = fwrite(data.data(), data.size(), 1, file) == 1;
+        ok = fclose(file) == 0 && ok;
+        if (!ok || rename(temporary_path.c_str(), path.c_str()) != 0)
+        {
+            unlink(temporary_path.c_str());
+        }
+    }
+
+    bool encodeJpeg(const std::vector<uint8_t> &rgba, int width, int height, std::vector<uint8_t> &jpeg)
+    {
+        GdkPixbuf *pixbuf = gdk_pixbuf_new_from_data(rgba.data(), GDK_COLORSPACE_RGB, TRUE, 8,
+                                                     width, height, width * 4, nullptr, nullptr);
+        gchar *buffer = nullptr;
+        gsize size = 0;
+        GError *error = nullptr;
+        const bool ok = gdk_pixbuf_save_to_buffer(pixbuf, &buffer, &size, "jpeg", &error,
+                                                  "quality", kJpegQuality, nullptr);
+        g_object_unref(pixbuf);
+        if (!ok)
+        {
+            fprintf(stderr, "Failed to encode thumbnail: %s\n", error->message);
+            g_error_free(error);
+            return false;
+        }
+        jpeg.assign(buffer, buffer + size);
+        g_free(buffer);
+        return true;
+    }
+
+    // A keyframe to decode: the parameter sets in effect for it, with start
+    // codes, and its access unit in the file mapping.
+    struct KeyframeInput
+    {
+        std::vector<uint8_t> parameter_sets;
+        const uint8_t *data;
+        size_t size;
+    };
+
+    // Decodes keyframes in one ffmpeg run and returns the frames that come
+    // out, in order. Each keyframe follows an end of sequence, so it decodes
+    // on its own and pushes the previous one out of the decoder.
+    std::deque<std::vector<uint8_t>> decodeKeyframes(const std::vector<const KeyframeInput *> &keyframes,
+                                                     int width, int height,
+                                                     const std::function<bool()> &cancelled)
+    {
+        std::mutex frames_mutex;
+        std::deque<std::vector<uint8_t>> frames;
+        std::atomic<bool> thread_run{false};
+        gchar *command = g_strdup_printf(
+            "exec nice -n 19 ffmpeg -hide_banner -loglevel error -threads 1 -f hevc -i pipe:0 -vf scale=%d:%d -pix_fmt rgba -f rawvideo pipe:1",
+            width, height);
+        FFmpegProcess ffmpeg = launchFFmpegWithCallback(
+            command, size_t(width) * height * 4, thread_run,
+            [&](std::vector<uint8_t> &data)
+            {
+                std::lock_guard<std::mutex> lock(frames_mutex);
+                frames.push_back(data);
+            });
+        g_free(command);
+        if (!ffmpeg.input)
+        {
+            return frames;
+        }
+
+        bool first = true;
+        for (const KeyframeInput *keyframe : keyframes)
+        {
+            if (cancelled())
+            {
+                break;
+            }
+            if (!first)
+            {
+                fwrite(kEndOfSequence, sizeof(kEndOfSequence), 1, ffmpeg.input);
+            }
+            first = false;
+            fwrite(keyframe->parameter_sets.data(), keyframe->parameter_sets.size(), 1, ffmpeg.input);
+            fwrite(keyframe->data, keyframe->size, 1, ffmpeg.input);
+        }
+        fclose(ffmpeg.input);
+        if (cancelled())
+        {
+            kill(ffmpeg.pid, SIGTERM);
+        }
+        ffmpeg.thread.join();
+        waitpid(ffmpeg.pid, nullptr, 0);
+        return frames;
+    }
+
+    // Replaces the parameter sets in sets, indexed from the VPS, with those
+    // in data.
+    void updateParameterSets(const uint8_t *data, size_t size, std::array<std::vector<uint8_t>, 3> &sets)
+    {
+        hevcForEachNal(data, size, [&](const uint8_t *nal, size_t nal_size)
+                       {
+            const int type = hevcNalType(nal);
+            if (type >= HEVC_NAL_VPS && type <= HEVC_NAL_PPS)
+            {
+                static const uint8_t start_code[] = {0, 0, 0, 1};
+                std::vector<uint8_t> &set = sets[type - HEVC_NAL_VPS];
+                set.assign(start_code, start_code + sizeof(start_code));
+                set.insert(set.end(), nal, nal + nal_size);
+            } });
+    }
+}
+
+ThumbnailService::ThumbnailService(const std::string &cache_dir, ThumbnailCallback callback, DoneCallback done)
+    : cache_dir(cache_dir), callback(std::move(callback)), done(std::move(done))
+{
+    thread = std::thread([this]()
+                         {
+        // Thumbnails must never take CPU time from playback.
+        setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+        run(); });
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+        for (const ThumbnailRequest &request : requests)
+        {
+            cancelled_ids.insert(request.id);
+        }
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+int ThumbnailService::request(ThumbnailRequest request)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    request.id = next_id++;
+    const int id = request.id;
+    requests.push_back(std::move(request));
+    condition.notify_one();
+    return id;
+}
+
+void ThumbnailService::cancel(int request_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled_ids.insert(request_id);
+}
+
+bool ThumbnailService::cancelled(int request_id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return cancelled_ids.count(request_id) != 0;
+}
+
+void ThumbnailService::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]()
+                       { return !running || !requests.empty(); });
+        if (requests.empty())
+        {
+            break;
+        }
+        ThumbnailRequest request = std::move(requests.front());
+        requests.pop_front();
+        lock.unlock();
+        if (!cancelled(request.id))
+        {
+            process(request);
+        }
+        done(request.id);
+        lock.lock();
+        cancelled_ids.erase(request.id);
+    }
+}
+
+void ThumbnailService::process(const ThumbnailRequest &request)
+{
+    HevcFile file;
+    const int64_t frame_duration = request.fps > 0 ? int64_t(1000000 / request.fps) : 0;
+    if (frame_duration <= 0 || request.width <= 0 || !file.open(request.path.c_str(), cache_dir))
+    {
+        return;
+    }
+    const std::vector<HevcAccessUnit> &units = file.accessUnits();
+
+    // Parameter sets up to the first keyframe; the first SPS gives the
+    // aspect ratio.
+    std::array<std::vector<uint8_t>, 3> parameter_sets;
+    HevcSps sps;
+    bool has_sps = false;
+    size_t scanned = 0;
+    for (; scanned < units.size(); scanned++)
+    {
+        const HevcAccessUnit &unit = units[scanned];
+        hevcForEachNal(file.data() + unit.offset, unit.size, [&](const uint8_t *nal, size_t size)
+                       {
+            if (hevcNalType(nal) == HEVC_NAL_SPS && !has_sps)
+            {
+                has_sps = hevcParseSps(nal, size, sps);
+            } });
+        if (unit.irap != HevcFile::kNoIrap)
+        {
+            break;
+        }
+        updateParameterSets(file.data() + unit.offset, unit.size, parameter_sets);
+    }
+    if (!has_sps)
+    {
+        return;
+    }
+    const int width = request.width & ~1;
+    int height = request.height;
+    if (height <= 0)
+    {
+        height = int(int64_t(width) * sps.height / sps.width);
+    }
+    height &= ~1;
+    if (width <= 0 || height <= 0)
+    {
+        return;
+    }
+
+    // Serve what the cache has and collect the keyframes left to decode.
+    const std::string thumbnail_dir = cache_dir + "/thumbnails";
+    g_mkdir_with_parents(thumbnail_dir.c_str(), 0755);
+    std::map<uint32_t, std::vector<int64_t>> missing;
+    for (int64_t position : request.positions)
+    {
+        const size_t index = std::min<int64_t>(std::max<int64_t>(position / frame_duration, 0), units.size() - 1);
+        const uint32_t keyframe = units[index].irap;
+        if (keyframe == HevcFile::kNoIrap)
+        {
+            continue;
+        }
+        Thumbnail thumbnail;
+        thumbnail.request_id = request.id;
+        thumbnail.position = position;
+        thumbnail.keyframe_position = keyframe * frame_duration;
+        thumbnail.width = width;
+        thumbnail.height = height;
+        thumbnail.format = request.format;
+        const std::string path = cachePath(thumbnail_dir, file, request.path.c_str(),
+                                           units[keyframe].offset, width, height, request.format);
+        if (readFile(path, thumbnail.data))
+        {
+            callback(thumbnail);
+        }
+        else
+        {
+            missing[keyframe].push_back(position);
+        }
+    }
+    if (missing.empty() || cancelled(request.id))
+    {
+        return;
+    }
+
+    // Each keyframe goes in with the parameter sets in effect at it, which
+    // come with the IRAP access units up to it.
+    std::vector<KeyframeInput> inputs;
+    for (const auto &entry : missing)
+    {
+        for (; scanned <= entry.first; scanned++)
+        {
+            if (units[scanned].irap == scanned)
+            {
+                updateParameterSets(file.data() + units[scanned].offset, units[scanned].size, parameter_sets);
+            }
+        }
+        KeyframeInput input;
+        for (const std::vector<uint8_t> &set : parameter_sets)
+        {
+            input.parameter_sets.insert(input.parameter_sets.end(), set.begin(), set.end());
+        }
+        input.data = file.data() + units[entry.first].offset;
+        input.size = units[entry.first].size;
+        inputs.push_back(std::move(input));
+    }
+
+    // ffmpeg skips a keyframe it cannot decode, after which the frames of a
+    // batch no longer line up with the keyframes. Then each keyframe is
+    // decoded on its own instead, and one that gives no frame is left out.
+    auto is_cancelled = [this, &request]()
+    { return cancelled(request.id); };
+    std::vector<const KeyframeInput *> batch;
+    for (const KeyframeInput &input : inputs)
+    {
+        batch.push_back(&input);
+    }
+    std::deque<std::vector<uint8_t>> batch_frames = decodeKeyframes(batch, width, height, is_cancelled);
+    std::vector<std::vector<uint8_t>> frames(inputs.size());
+    if (batch_frames.size() == inputs.size())
+    {
+        std::move(batch_frames.begin(), batch_frames.end(), frames.begin());
+    }
+    else
+    {
+        batch_frames.clear();
+        for (size_t i = 0; i < inputs.size() && !is_cancelled(); i++)
+        {
+            std::deque<std::vector<uint8_t>> single = decodeKeyframes({&inputs[i]}, width, height, is_cancelled);
+            if (single.size() == 1)
+            {
+                frames[i] = std::move(single.front());
+            }
+        }
+    }
+
+    size_t i = 0;
+    for (const auto &entry : missing)
+    {
+        std::vector<uint8_t> &frame = frames[i++];
+        if (cancelled(request.id))
+        {
+            break;
+        }
+        if (frame.empty())
+        {
+            continue;
+        }
+        Thumbnail thumbnail;
+        thumbnail.request_id = request.id;
+        thumbnail.keyframe_position = entry.first * frame_duration;
+        thumbnail.width = width;
+        thumbnail.height = height;
+        thumbnail.format = request.format;
+        if (request.format == THUMBNAIL_FORMAT_JPEG)
+        {
+            if (!encodeJpeg(frame, width, height, thumbnail.data))
+            {
+                continue;
+            }
+        }
+        else
+        {
+            thumbnail.data = std::move(frame);
+        }
+
+        writeFile(cachePath(thumbnail_dir, file, request.path.c_str(), units[entry.first].offset,
+                            width, height, request.format),
+                  thumbnail.data);
+        for (int64_t position : entry.second)
+        {
+            thumbnail.position = position;
+            callback(thumbnail);
+        }
+    }
+}
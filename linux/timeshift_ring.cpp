@@ -0,0 +1,190 @@
+#include "include/renderer/timeshift_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Index entries per second of duration: enough for every NAL unit of a
+    // 60 fps stream to arrive on its own, with parameter sets and slices.
+    const int64_t kUnitsPerSecond = 300;
+    const size_t kMinUnits = 1024;
+    const double kDefaultFps = 30.0;
+}
+
+void TimeshiftRing::configure(int64_t duration, size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    first = 0;
+    count = 0;
+    write_offset = 0;
+    if (duration <= 0 || capacity == 0)
+    {
+        this->duration = 0;
+        std::vector<uint8_t>().swap(arena);
+        std::vector<Unit>().swap(units);
+        return;
+    }
+    this->duration = duration;
+    std::vector<uint8_t>(capacity).swap(arena);
+    const size_t max_units = std::max<size_t>(kMinUnits, size_t(duration / 1000000 + 1) * kUnitsPerSecond);
+    std::vector<Unit>(max_units).swap(units);
+}
+
+bool TimeshiftRing::enabled()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return !arena.empty();
+}
+
+void TimeshiftRing::append(const uint8_t *data, size_t size, int64_t arrival, int pictures, bool irap, bool has_sps,
+                           const std::array<std::vector<uint8_t>, 3> &parameter_sets)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (arena.empty())
+    {
+        return;
+    }
+    const bool prefix = irap && !has_sps;
+    size_t total = size;
+    if (prefix)
+    {
+        for (const std::vector<uint8_t> &parameter_set : parameter_sets)
+        {
+            total += parameter_set.size();
+        }
+    }
+    if (total > arena.size())
+    {
+        // Nothing before it can be played past it.
+        first = 0;
+        count = 0;
+        return;
+    }
+    evict(total, arrival);
+
+    Unit &added = units[(first + count) % units.size()];
+    added.offset = write_offset;
+    added.size = uint32_t(total);
+    added.pictures = pictures;
+    added.arrival = arrival;
+    added.irap = irap;
+    if (prefix)
+    {
+        for (const std::vector<uint8_t> &parameter_set : parameter_sets)
+        {
+            write(parameter_set.data(), parameter_set.size());
+        }
+    }
+    write(data, size);
+    count++;
+}
+
+void TimeshiftRing::dropFirst()
+{
+    first = (first + 1) % units.size();
+    count--;
+}
+
+void TimeshiftRing::evict(size_t size, int64_t arrival)
+{
+    // Make room in the index and the arena.
+    while (count > 0 && (count == units.size() || write_offset + size - unit(0).offset > arena.size()))
+    {
+        dropFirst();
+    }
+    // Units before the first IRAP left cannot be decoded any more.
+    while (count > 0 && !unit(0).irap)
+    {
+        dropFirst();
+    }
+    // A group goes once the next one alone covers the duration.
+    while (count > 0)
+    {
+        size_t next = 1;
+        while (next < count && !unit(next).irap)
+        {
+            next++;
+        }
+        if (next == count || arrival - unit(next).arrival < duration)
+        {
+            break;
+        }
+        for (size_t i = 0; i < next; i++)
+        {
+            dropFirst();
+        }
+    }
+}
+
+void TimeshiftRing::write(const uint8_t *data, size_t size)
+{
+    const size_t position = write_offset % arena.size();
+    const size_t head = std::min(size, arena.size() - position);
+    memcpy(arena.data() + position, data, head);
+    memcpy(arena.data(), data + head, size - head);
+    write_offset += size;
+}
+
+void TimeshiftRing::read(uint64_t offset, size_t size, uint8_t *out) const
+{
+    const size_t position = offset % arena.size();
+    const size_t head = std::min(size, arena.size() - position);
+    memcpy(out, arena.data() + position, head);
+    memcpy(out + head, arena.data(), size - head);
+}
+
+bool TimeshiftRing::copyOut(int64_t back, std::vector<uint8_t> &stream, TimeshiftExport &info)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0)
+    {
+        return false;
+    }
+    const int64_t newest = unit(count - 1).arrival;
+    size_t start = count;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (unit(i).irap && (start == count || unit(i).arrival <= newest - back))
+        {
+            start = i;
+        }
+    }
+    if (start == count)
+    {
+        return false;
+    }
+
+    // Units follow each other in the stream, so the span is one read.
+    const Unit &start_unit = unit(start);
+    stream.resize(write_offset - start_unit.offset);
+    read(start_unit.offset, stream.size(), stream.data());
+    info = TimeshiftExport();
+    for (size_t i = start; i < count; i++)
+    {
+        info.pictures += unit(i).pictures;
+    }
+    info.bytes = stream.size();
+    info.duration = newest - start_unit.arrival;
+    info.fps = info.pictures > 1 && info.duration > 0 ? (info.pictures - 1) * 1e6 / info.duration : kDefaultFps;
+    return true;
+}
+
+TimeshiftStats TimeshiftRing::stats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    TimeshiftStats result;
+    result.capacity = arena.size();
+    result.units = count;
+    if (count == 0)
+    {
+        return result;
+    }
+    result.duration = unit(count - 1).arrival - unit(0).arrival;
+    result.bytes = write_offset - unit(0).offset;
+    for (size_t i = 0; i < count; i++)
+    {
+        result.keyframes += unit(i).irap;
+    }
+    return result;
+}
@@ -0,0 +1,95 @@
+#include <GL/glew.h>
+#include "include/renderer/upload_thread.h"
+
+#include <iostream>
+
+UploadThread::UploadThread(GdkWindow *window)
+{
+    // GDK objects are created on the main thread; only making the context
+    // current and issuing GL calls happens on the upload thread.
+    GError *error = NULL;
+    context = gdk_window_create_gl_context(window, &error);
+    if (context == nullptr || !gdk_gl_context_realize(context, &error))
+    {
+        std::cerr << "Failed to create upload GL context: "
+                  << (error ? error->message : "unknown error") << std::endl;
+        g_clear_error(&error);
+    }
+    thread = std::thread([this]()
+                         { run(); });
+
+    // GLEW resolves entry points for the current context, so it is
+    // initialised on the upload thread once its context is current.
+    invoke([this]()
+           {
+        glewExperimental = GL_TRUE; // Optional, enables more extensions
+        ready = context != nullptr && glewInit() == GLEW_OK; });
+}
+
+UploadThread::~UploadThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    condition.notify_one();
+    thread.join();
+    if (context)
+    {
+        g_object_unref(context);
+    }
+}
+
+void UploadThread::post(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    condition.notify_one();
+}
+
+void UploadThread::invoke(std::function<void()> task)
+{
+    std::mutex done_mutex;
+    std::condition_variable done_condition;
+    bool done = false;
+    post([&]()
+         {
+        task();
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done = true;
+        done_condition.notify_one(); });
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_condition.wait(lock, [&]()
+                        { return done; });
+}
+
+void UploadThread::run()
+{
+    if (context)
+    {
+        gdk_gl_context_make_current(context);
+    }
+
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]()
+                           { return !running || !tasks.empty(); });
+            // Drain what is queued before stopping so pending deletions run.
+            if (tasks.empty())
+            {
+                break;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+
+    gdk_gl_context_clear_current();
+}